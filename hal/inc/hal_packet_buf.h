@@ -0,0 +1,108 @@
+#ifndef HAL_PACKET_BUF_H
+#define HAL_PACKET_BUF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define PACKET_BUF_HEADROOM         32      // 数据前预留的帧头空间
+#define PACKET_BUF_DATA_SIZE        513     // 小缓冲区最大数据长度（一个完整的数据帧）
+#define PACKET_BUF_POOL_SIZE        24      // 小缓冲区数量，发送队列中的数据包也占用缓冲区
+#define PACKET_BUF_LARGE_DATA_SIZE  4096    // 大缓冲区最大数据长度（路由包等长帧）
+#define PACKET_BUF_LARGE_POOL_SIZE  2       // 大缓冲区数量
+#define PACKET_BUF_REF_POOL_SIZE    8       // 引用外部内存的描述符数量，限制同时占用的协议栈缓冲区
+
+/** 内存池类型，按数据长度自动选择 */
+typedef enum {
+    PACKET_BUF_POOL_SMALL = 0,      // 数据帧
+    PACKET_BUF_POOL_LARGE,          // 路由包等长帧
+    PACKET_BUF_POOL_REF,            // 只有描述符，数据在外部内存中（如lwIP的pbuf）
+    PACKET_BUF_POOL_MAX
+} PacketBufPoolType;
+
+/** 外部内存的释放函数，引用计数为0时调用 */
+typedef void (*PacketBufRelease)(void *arg);
+
+/** 数据包缓冲区，从固定内存池中分配，通过引用计数在多个使用者之间共享 */
+typedef struct PacketBuf {
+    char *payload;              // 有效数据的起始位置
+    uint16_t len;               // 有效数据长度
+    uint16_t size;              // 缓冲区总大小（含预留空间）
+    uint8_t ref;                // 引用计数，为0时归还内存池
+    uint8_t pool;               // 所属内存池，PacketBufPoolType
+    struct PacketBuf *next;     // 空闲链表指针
+    char *mem;                  // 缓冲区起始位置，末尾额外1字节保证数据以'\0'结尾
+    PacketBufRelease release;   // 外部内存的释放函数，只用于PACKET_BUF_POOL_REF
+    void *release_arg;          // 释放函数的参数
+} PacketBuf;
+
+/** 内存池统计信息 */
+typedef struct {
+    uint32_t total;             // 缓冲区总数
+    uint32_t used;              // 当前已使用的缓冲区数量
+    uint32_t high_water;        // 历史最大同时使用数量
+    uint32_t alloc_failed;      // 分配失败次数
+} PacketBufStats;
+
+/**
+ * @brief 初始化数据包缓冲区内存池
+ * @return 0 表示成功，非 0 表示失败
+ * @note 可重复调用，只有第一次调用会初始化
+ */
+int HAL_PacketBuf_Init(void);
+
+/**
+ * @brief 从内存池中分配一个数据包缓冲区
+ * @param len 需要的数据长度，不超过PACKET_BUF_LARGE_DATA_SIZE
+ * @return 缓冲区指针，引用计数为1；内存池耗尽时返回NULL
+ * @note 不超过PACKET_BUF_DATA_SIZE时从小缓冲区分配，否则从大缓冲区分配
+ * @note payload前保留PACKET_BUF_HEADROOM字节的帧头空间，payload[len]为'\0'
+ */
+PacketBuf *HAL_PacketBuf_Alloc(uint16_t len);
+
+/**
+ * @brief 用一个描述符包装外部内存中的数据，不拷贝数据
+ * @param data 数据起始位置
+ * @param len 数据长度
+ * @param release 最后一个引用释放时调用，归还外部内存
+ * @param arg 释放函数的参数
+ * @return 缓冲区指针，引用计数为1；描述符用完时返回NULL，此时不会调用release
+ * @note 没有预留帧头空间，数据也不以'\0'结尾，使用方需要按len访问数据
+ */
+PacketBuf *HAL_PacketBuf_Wrap(char *data, uint16_t len, PacketBufRelease release, void *arg);
+
+/**
+ * @brief 增加缓冲区的引用计数
+ * @param buf 数据包缓冲区
+ * @note 每次调用都需要对应一次HAL_PacketBuf_Free
+ */
+void HAL_PacketBuf_Ref(PacketBuf *buf);
+
+/**
+ * @brief 释放一次缓冲区的引用，引用计数为0时归还内存池
+ * @param buf 数据包缓冲区
+ */
+void HAL_PacketBuf_Free(PacketBuf *buf);
+
+/**
+ * @brief 调整有效数据的起始位置
+ * @param buf 数据包缓冲区
+ * @param header_size 正数表示向前扩展帧头（使用预留空间），负数表示去掉帧头
+ * @return 0 表示成功，非 0 表示预留空间不足或数据长度不足
+ */
+int HAL_PacketBuf_Header(PacketBuf *buf, int16_t header_size);
+
+/**
+ * @brief 获取内存池统计信息
+ * @param pool 内存池类型
+ * @param[out] stats 存储统计信息
+ */
+void HAL_PacketBuf_GetStats(PacketBufPoolType pool, PacketBufStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HAL_PACKET_BUF_H
@@ -0,0 +1,59 @@
+#ifndef HAL_RAW_LINK_H
+#define HAL_RAW_LINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+ * 链路层直连传输的帧格式，不经过IP和TCP：
+ * [0-5] 目标以太网地址 [6-11] 源以太网地址 [12-13] EtherType
+ * [14-19] 发送方节点MAC（6个字符，与路由层的节点MAC相同） [20-21] 数据帧长度（大端序）
+ * [22..] 数据帧
+ * 以太网帧不足最小长度时会被填充，接收方按长度字段取出数据帧。
+ * 该文件只负责编解码，不依赖操作系统和协议栈，固件和主机测试共用。
+ */
+
+#define RAW_LINK_ETHERTYPE          0x88B5  // IEEE 802 本地实验用EtherType
+#define RAW_LINK_ETH_ADDR_SIZE      6       // 以太网地址长度
+#define RAW_LINK_ETH_HEADER_SIZE    14      // 以太网帧头长度
+#define RAW_LINK_NODE_MAC_SIZE      6       // 节点MAC长度
+#define RAW_LINK_HEADER_SIZE        (RAW_LINK_ETH_HEADER_SIZE + RAW_LINK_NODE_MAC_SIZE + 2)
+#define RAW_LINK_MTU                1500    // 以太网载荷最大长度
+#define RAW_LINK_MAX_FRAME_LEN      (RAW_LINK_MTU - RAW_LINK_NODE_MAC_SIZE - 2)  // 单个数据帧最大长度
+
+/** 解析出的链路层帧信息 */
+typedef struct {
+    uint8_t src_eth[RAW_LINK_ETH_ADDR_SIZE];    // 上一跳的以太网地址
+    char node_mac[RAW_LINK_NODE_MAC_SIZE + 1];  // 上一跳的节点MAC，以'\0'结尾
+    uint16_t len;                               // 数据帧长度，数据帧从RAW_LINK_HEADER_SIZE开始
+} RawLinkInfo;
+
+/**
+ * @brief 填写链路层帧头
+ * @param[out] header 帧头，至少RAW_LINK_HEADER_SIZE字节
+ * @param dst_eth 下一跳的以太网地址
+ * @param src_eth 本节点发送接口的以太网地址
+ * @param node_mac 本节点的节点MAC，6个字符
+ * @param len 数据帧长度，不超过RAW_LINK_MAX_FRAME_LEN
+ * @return 0 表示成功，-1 表示参数错误
+ */
+int raw_link_encode_header(uint8_t *header, const uint8_t *dst_eth, const uint8_t *src_eth,
+                           const char *node_mac, uint16_t len);
+
+/**
+ * @brief 解析链路层帧头
+ * @param frame 收到的以太网帧，从目标以太网地址开始
+ * @param frame_len 以太网帧长度（可能包含填充）
+ * @param[out] info 解析结果
+ * @return 0 表示是本协议的帧且长度有效，-1 表示不是本协议的帧或长度错误
+ */
+int raw_link_decode_header(const uint8_t *frame, uint16_t frame_len, RawLinkInfo *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HAL_RAW_LINK_H
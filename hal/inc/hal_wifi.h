@@ -6,6 +6,8 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "hal_packet_buf.h"
 
 #define WIFI_SSID_MAX_LEN 32
 #define WIFI_PASSWORD_MAX_LEN 64
@@ -74,6 +76,8 @@ typedef struct {
 typedef struct {
     char mac[7];  // MAC地址
     char ip[16];   // IP地址
+    uint8_t eth[6];  // 子节点的以太网地址，链路层直连传输使用
+    bool has_eth;    // eth是否有效
 } MAC_IP_Binding;
 
 // 链表节点
@@ -83,6 +87,38 @@ typedef struct MAC_IP_Node {
     int count;                   // 未更新次数
 } MAC_IP_Node;
 
+#define FRAME_LEN_PREFIX_SIZE 2                         // 帧长度前缀字节数（大端序）
+#define FRAME_MAX_LEN PACKET_BUF_LARGE_DATA_SIZE         // 单帧最大长度
+
+// 数据报后端：1 表示使用lwIP的netconn接口，收到的pbuf直接交给路由层，发送时引用数据包缓冲区，不拷贝数据；
+// 0 表示使用BSD套接字，收发各拷贝一次
+#define ENABLE_NETCONN_DATAGRAM 0
+
+// 链路层直连传输：1 表示数据帧可以直接以自定义EtherType的以太网帧发送给邻居，不经过IP和TCP，
+// 需要在SDK的lwipopts.h中定义 LWIP_HOOK_UNKNOWN_ETH_PROTOCOL(p, netif) 为 HAL_WiFi_RawLink_Input(p, netif)
+#define ENABLE_RAW_LINK 0
+
+/** 数据报收发统计，用于比较两种数据报后端的拷贝开销 */
+typedef struct {
+    uint32_t rx_frames;             // 收到的数据报数量
+    uint32_t rx_zero_copy;          // 直接交给路由层、没有拷贝的数据报数量
+    uint32_t rx_copied_bytes;       // 接收时拷贝的字节数
+    uint32_t tx_frames;             // 发送的数据报数量
+    uint32_t tx_zero_copy;          // 数据部分没有拷贝的数据报数量
+    uint32_t tx_copied_bytes;       // 发送时拷贝的字节数（含单独分配的帧头）
+} WiFiDatagramStats;
+
+#define FRAME_READ_NO_BUFFER 2     // HAL_WiFi_FrameReader_Feed：内存池暂时耗尽，数据帧留在socket中
+
+/** 流式接收的分帧状态，一帧可以跨多次recv累积 */
+typedef struct {
+    uint8_t prefix[FRAME_LEN_PREFIX_SIZE];  // 已收到的长度前缀
+    uint16_t prefix_received;               // 已收到的长度前缀字节数
+    uint16_t frame_len;                     // 当前帧的长度
+    uint16_t received;                      // 当前帧已收到的字节数
+    PacketBuf *buf;                         // 存放当前帧的缓冲区
+} FrameReader;
+
 /**
  * @brief 初始化Wi-Fi硬件及相关资源
  * @return 0 表示成功，非 0 表示失败
@@ -192,11 +228,6 @@ int HAL_WiFi_Receive_data(const char *ip, uint16_t port, char *buffer, int buffe
  */
 int HAL_WiFi_GetAPConfig(WiFiAPConfig *config);
 
-/**
- * @brief 创建TCP服务端用于绑定MAC和IP地址
- */
-void HAL_WiFi_CreateIPMACBindingServer(void);
-
 /**
  * @brief 创建TCP客户端用于给绑定服务器定期发送MAC地址心跳包
  */
@@ -225,6 +256,55 @@ int HAL_WiFi_Send_data_by_MAC(const char *MAC, const char *data);
  */
 int HAL_WiFi_Send_data_to_parent(const char *data, int tree_level);
 
+/**
+ * @brief 向指定的MAC地址发送指定长度的数据帧，数据可以包含'\0'
+ * @param MAC 目标设备的MAC地址
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_Send_frame_by_MAC(const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 通过Wi-Fi发送指定长度的数据帧给父节点，数据可以包含'\0'
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @param tree_level 父节点所在树的层数
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_Send_frame_to_parent(const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 与HAL_WiFi_Send_frame_by_MAC相同，但不等待连接建立
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_WiFi_Try_send_frame_by_MAC(const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 与HAL_WiFi_Send_frame_to_parent相同，但不等待连接建立
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_WiFi_Try_send_frame_to_parent(const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 通过控制面连接向父节点发送数据帧（路由包、广播重发请求）
+ * @note 控制面使用单独的端口和连接，接收端优先处理，不会排在数据包后面
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_Send_control_to_parent(const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 与HAL_WiFi_Send_control_to_parent相同，但不等待连接建立
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_WiFi_Try_send_control_to_parent(const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 通过控制面连接向子节点发送数据帧，不等待连接建立
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_WiFi_Try_send_control_by_MAC(const char *MAC, const char *data, uint16_t len);
+
 /**
  * @brief 创建socket TCP服务端
  * @param port 服务端端口
@@ -251,6 +331,188 @@ int HAL_WiFi_Close_Server(int server_fd);
  */
 int HAL_WiFi_Server_Receive(int server_fd, char *mac, char *buffer, int buffer_len);
 
+/**
+ * @brief 接收TCP客户端的连接，并读取一个完整的数据帧
+ * @param server_fd 服务端socket描述符
+ * @param[out] mac 存储MAC地址的缓冲区，至少需要7字节
+ * @param[out] frame 存储接收到的数据帧，使用完需调用HAL_PacketBuf_Free释放
+ * @return 数据帧的长度，或 < 0 表示没有收到数据帧（超时或只处理了其他事件）
+ * @note 数据帧以2字节长度前缀分帧，按长度从合适大小的内存池中分配缓冲区
+ * @note 客户端连接在收完数据帧后保持打开，同一连接上可以连续接收多个数据帧
+ * @note 数据服务器、数据报、MAC-IP绑定服务器、邻居长连接和唤醒事件在同一个select中等待，
+ *       绑定心跳和对端关闭在这里顺带处理，最长等待SERVER_POLL_TIMEOUT_MS
+ */
+int HAL_WiFi_Server_ReceiveFrame(int server_fd, char *mac, PacketBuf **frame);
+
+/**
+ * @brief 唤醒正在HAL_WiFi_Server_ReceiveFrame中等待的接收线程
+ * @note 其他线程设置事件标志后调用，接收线程立即返回并处理事件，而不是等到超时
+ */
+void HAL_WiFi_Server_Wakeup(void);
+
+/**
+ * @brief 发送一个带长度前缀的数据帧
+ * @note 与每个邻居保持一条长连接（TCP_NODELAY），连接断开时自动重连
+ * @param ip 目标IP地址
+ * @param port 目标端口
+ * @param data 数据帧
+ * @param len 数据帧长度，不超过FRAME_MAX_LEN
+ * @return 0表示成功，其他表示失败
+ */
+int HAL_WiFi_Send_frame(const char *ip, uint16_t port, const char *data, uint16_t len);
+
+/**
+ * @brief 发送一个带长度前缀的数据帧，不阻塞
+ * @note 连接以非阻塞方式建立，超过CONN_CONNECT_TIMEOUT_MS仍未建立则视为失败；写入同样是非阻塞的，
+ *       只写入一部分时剩余部分由连接保存并在可写时写完，发送缓冲区超过CONN_SEND_TIMEOUT_S一直已满则关闭连接。
+ *       发送线程不会因为某个邻居不可达或不再接收而阻塞在connect或send上
+ * @param ip 目标IP地址
+ * @param port 目标端口
+ * @param data 数据帧
+ * @param len 数据帧长度，不超过FRAME_MAX_LEN
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，-1 表示失败
+ */
+int HAL_WiFi_Try_send_frame(const char *ip, uint16_t port, const char *data, uint16_t len);
+
+/**
+ * @brief 关闭连接池中到指定IP的长连接
+ * @param ip 邻居节点的IP地址，NULL表示关闭全部连接
+ * @note 下次向该邻居发送数据时会自动重新连接
+ */
+void HAL_WiFi_Close_Connections(const char *ip);
+
+/**
+ * @brief 开启数据报模式，创建绑定在指定端口上的UDP套接字
+ * @param port 数据报端口
+ * @return 0 表示成功，非 0 表示失败
+ * @note AP侧和STA侧共用同一个套接字，HAL_WiFi_Server_ReceiveFrame会同时接收数据报
+ */
+int HAL_WiFi_Datagram_Open(uint16_t port);
+
+/**
+ * @brief 关闭数据报模式的UDP套接字
+ */
+void HAL_WiFi_Datagram_Close(void);
+
+/**
+ * @brief 发送一个数据报，不建立连接，不保证送达
+ * @param ip 目标IP地址
+ * @param port 目标端口
+ * @param data 数据
+ * @param len 数据长度，不超过FRAME_MAX_LEN
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_Send_datagram(const char *ip, uint16_t port, const char *data, uint16_t len);
+
+/**
+ * @brief 向SoftAP所在子网发送一个广播数据报，所有子节点都能收到
+ * @param header 数据报帧头，可以为NULL
+ * @param header_len 帧头长度
+ * @param data 数据
+ * @param len 数据长度
+ * @param ap_level 本节点的树层级，SoftAP的子网为 192.168.<ap_level>.0/24
+ * @return 0 表示成功，非 0 表示失败
+ * @note 需要先调用HAL_WiFi_Datagram_Open，不保证送达
+ */
+int HAL_WiFi_Send_subnet_broadcast(const char *header, uint16_t header_len, const char *data, uint16_t len, int ap_level);
+
+/**
+ * @brief 开启链路层直连传输，收到的链路层帧由HAL_WiFi_Server_ReceiveFrame返回
+ * @return 0 表示成功，非 0 表示失败（ENABLE_RAW_LINK为0时总是失败）
+ */
+int HAL_WiFi_RawLink_Open(void);
+
+/**
+ * @brief 关闭链路层直连传输，丢弃尚未取出的帧
+ */
+void HAL_WiFi_RawLink_Close(void);
+
+/**
+ * @brief 以链路层帧向子节点发送数据帧，以太网地址从MAC-IP绑定表中查找
+ * @param MAC 子节点的MAC地址
+ * @param data 数据帧
+ * @param len 数据帧长度，不超过RAW_LINK_MAX_FRAME_LEN
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_RawLink_Send_by_MAC(const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 以链路层帧向父节点发送数据帧，目标地址为关联的AP的BSSID
+ * @param data 数据帧
+ * @param len 数据帧长度，不超过RAW_LINK_MAX_FRAME_LEN
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_RawLink_Send_to_parent(const char *data, uint16_t len);
+
+struct pbuf;
+struct netif;
+/**
+ * @brief lwIP收到未知EtherType的以太网帧时调用，在tcpip线程中执行
+ * @param p 以太网帧，从以太网帧头开始
+ * @param netif 收到帧的网络接口
+ * @return 0 表示已处理并释放p，非 0 表示不是本协议的帧，由lwIP释放
+ */
+int HAL_WiFi_RawLink_Input(struct pbuf *p, struct netif *netif);
+
+/**
+ * @brief 获取数据报收发统计
+ * @param[out] stats 存储统计信息
+ */
+void HAL_WiFi_GetDatagramStats(WiFiDatagramStats *stats);
+
+/**
+ * @brief 清空数据报收发统计
+ */
+void HAL_WiFi_ResetDatagramStats(void);
+
+/**
+ * @brief 向指定MAC地址的子节点发送数据报，IP地址从MAC-IP绑定表中查找
+ * @param MAC 目标设备的MAC地址
+ * @param data 数据
+ * @param len 数据长度
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_Send_datagram_by_MAC(const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 向父节点发送数据报
+ * @param data 数据
+ * @param len 数据长度
+ * @param tree_level 父节点所在树的层数
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_WiFi_Send_datagram_to_parent(const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 初始化分帧状态
+ * @param reader 分帧状态
+ */
+void HAL_WiFi_FrameReader_Init(FrameReader *reader);
+
+/**
+ * @brief 清空分帧状态，释放未接收完整的数据帧
+ * @param reader 分帧状态
+ */
+void HAL_WiFi_FrameReader_Reset(FrameReader *reader);
+
+/**
+ * @brief 从socket读取数据，累积到一个完整的数据帧
+ * @param reader 分帧状态
+ * @param sock 已连接的socket描述符，可以是非阻塞的
+ * @param[out] frame 收到完整数据帧时返回该帧，所有权交给调用方
+ * @return 1 表示收到完整的数据帧，0 表示还需要更多数据（包括暂时没有数据），
+ *         FRAME_READ_NO_BUFFER 表示内存池耗尽、没有读取数据帧，< 0 表示连接关闭、出错或长度前缀无效
+ * @note 每次调用只执行一次recv，可在多次调用之间保留未完成的帧；
+ *       返回FRAME_READ_NO_BUFFER时分帧状态保留，缓冲区释放后再次调用即可继续
+ */
+int HAL_WiFi_FrameReader_Feed(FrameReader *reader, int sock, PacketBuf **frame);
+
+/**
+ * @brief 获取接收数据帧时因内存池耗尽而暂停读取连接的次数
+ * @return 暂停次数，连接保持不断开，缓冲区释放后继续读取
+ */
+uint32_t HAL_WiFi_GetFrameNoBufferCount(void);
+
 /**
  * @brief 获取当前路由表的所有设备的MAC地址
  * @param[out] mac_list 存储MAC地址的指针数组
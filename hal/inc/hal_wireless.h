@@ -6,6 +6,7 @@ extern "C" {
 #endif
 
 #include <stdint.h>
+#include "hal_packet_buf.h"
 
 /** 支持的无线通信类型 */
 typedef enum {
@@ -177,6 +178,135 @@ int HAL_Wireless_SendData_to_child(WirelessType type, const char *MAC, const cha
  */
 int HAL_Wireless_SendData_to_parent(WirelessType type, const char *data, int tree_level);
 
+/**
+ * @brief 通过无线通信模块发送指定长度的数据帧给子节点
+ * @param type 指定无线通信类型。
+ * @param MAC 目标设备的MAC地址
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_Wireless_SendFrame_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 通过无线通信模块发送指定长度的数据帧给父节点
+ * @param type 指定无线通信类型。
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @param tree_level 父节点所在树的层数
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_Wireless_SendFrame_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 发送数据帧给子节点，连接尚未建立时不等待
+ * @param type 指定无线通信类型。
+ * @param MAC 目标设备的MAC地址
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_Wireless_TrySendFrame_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 发送数据帧给父节点，连接尚未建立时不等待
+ * @param type 指定无线通信类型。
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @param tree_level 父节点所在树的层数
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_Wireless_TrySendFrame_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 通过控制面发送数据帧给父节点，路由包和广播重发请求使用
+ * @param type 指定无线通信类型。
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @param tree_level 父节点所在树的层数
+ * @return 0 表示成功，非 0 表示失败
+ * @note 控制面与数据面使用不同的连接，接收端优先处理控制面
+ */
+int HAL_Wireless_SendControl_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 通过控制面发送数据帧给子节点，连接尚未建立时不等待
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_Wireless_TrySendControl_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 通过控制面发送数据帧给父节点，连接尚未建立时不等待
+ * @return 0 表示成功，1 表示连接正在建立或发送缓冲区已满、稍后重试，负数表示失败
+ */
+int HAL_Wireless_TrySendControl_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 开启数据报传输，数据报与数据帧由同一个接收服务器接收
+ * @param type 指定无线通信类型。
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_Wireless_OpenDatagram(WirelessType type);
+
+/**
+ * @brief 通过无线通信模块发送数据报给子节点，不保证送达
+ * @param type 指定无线通信类型。
+ * @param MAC 目标设备的MAC地址
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_Wireless_SendDatagram_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 通过无线通信模块发送数据报给父节点，不保证送达
+ * @param type 指定无线通信类型。
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @param tree_level 父节点所在树的层数
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_Wireless_SendDatagram_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level);
+
+/**
+ * @brief 开启链路层直连传输，数据帧直接封装在以太网帧中，不经过IP和TCP
+ * @param type 指定无线通信类型。
+ * @return 0 表示成功，非 0 表示失败（未开启或协议栈不支持）
+ */
+int HAL_Wireless_OpenRawLink(WirelessType type);
+
+/**
+ * @brief 以链路层帧发送给直连的子节点，目标地址来自MAC-IP绑定表，不保证送达
+ * @param type 指定无线通信类型。
+ * @param MAC 目标设备的MAC地址
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_Wireless_SendRaw_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len);
+
+/**
+ * @brief 以链路层帧发送给父节点，目标地址为父节点热点的BSSID，不保证送达
+ * @param type 指定无线通信类型。
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度
+ * @return 0 表示成功，非 0 表示失败
+ */
+int HAL_Wireless_SendRaw_to_parent(WirelessType type, const char *data, uint16_t len);
+
+/**
+ * @brief 向本节点热点所在的子网发送一次广播，所有子节点都能收到
+ * @param type 指定无线通信类型。
+ * @param header 帧头，可以为NULL
+ * @param header_len 帧头长度
+ * @param data 数据
+ * @param len 数据长度
+ * @param ap_level 本节点的树层级
+ * @return 0 表示成功，非 0 表示失败
+ * @note 不保证送达，可靠性由上层负责
+ */
+int HAL_Wireless_SendSubnetBroadcast(WirelessType type, const char *header, uint16_t header_len, const char *data, uint16_t len, int ap_level);
+
 /**
  * @brief 通过无线通信模块接收数据
  * @param type 指定无线通信类型。
@@ -214,6 +344,24 @@ int HAL_Wireless_CloseServer(WirelessType type, int server_fd);
  */
 int HAL_Wireless_ReceiveDataFromClient(WirelessType type, int server_fd, char *mac, char *buffer, int buffer_len);
 
+/**
+ * @brief 通过无线通信模块接收一个完整的数据帧
+ * @param type 指定无线通信类型。
+ * @param server_fd 服务器资源描述符
+ * @param[out] mac 存储发送数据的设备的MAC地址
+ * @param[out] frame 存储接收到的数据帧，使用完需调用HAL_PacketBuf_Free释放
+ * @return 数据帧的长度，或 < 0 表示失败
+ * @note 数据帧长度不受固定接收缓冲区限制，最大为FRAME_MAX_LEN
+ */
+int HAL_Wireless_ReceiveFrameFromClient(WirelessType type, int server_fd, char *mac, PacketBuf **frame);
+
+/**
+ * @brief 唤醒正在等待接收数据帧的线程
+ * @param type 指定无线通信类型。
+ * @note 设置路由传输的事件标志后调用，接收线程立即处理事件
+ */
+void HAL_Wireless_WakeupServer(WirelessType type);
+
 /** 
  * @brief 获取所有子节点的MAC地址
  * @param[out] mac_list 存储MAC地址的指针数组
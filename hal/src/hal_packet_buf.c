@@ -0,0 +1,183 @@
+#include "hal_packet_buf.h"
+#include <stdio.h>
+#include <string.h>
+#include "cmsis_os2.h"
+#include "std_def.h"
+
+// 定义宏开关，打开或关闭日志输出
+#define ENABLE_LOG 0  // 1 表示开启日志，0 表示关闭日志
+
+// 定义 LOG 宏，如果 ENABLE_LOG 为 1，则打印日志，并输出文件名、行号、日志内容
+#if ENABLE_LOG
+    #define LOG(fmt, ...) printf("LOG [%s:%d]: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+    #define LOG(fmt, ...) do { UNUSED(fmt); } while (0)
+#endif
+
+// 每个内存池的描述信息
+typedef struct {
+    PacketBuf *free_list;       // 空闲缓冲区链表
+    PacketBufStats stats;       // 统计信息
+} PacketBufPool;
+
+static PacketBuf g_small_bufs[PACKET_BUF_POOL_SIZE];
+static PacketBuf g_large_bufs[PACKET_BUF_LARGE_POOL_SIZE];
+static PacketBuf g_ref_bufs[PACKET_BUF_REF_POOL_SIZE];
+static char g_small_mem[PACKET_BUF_POOL_SIZE][PACKET_BUF_HEADROOM + PACKET_BUF_DATA_SIZE + 1];
+static char g_large_mem[PACKET_BUF_LARGE_POOL_SIZE][PACKET_BUF_HEADROOM + PACKET_BUF_LARGE_DATA_SIZE + 1];
+static PacketBufPool g_pools[PACKET_BUF_POOL_MAX];
+static osMutexId_t g_pbuf_mutex = NULL;              // 保护内存池和引用计数
+
+// 把一组缓冲区挂到内存池的空闲链表上
+static void init_pool(PacketBufPoolType type, PacketBuf *bufs, char *mem, uint16_t mem_size, int count) {
+    PacketBufPool *pool = &g_pools[type];
+    pool->free_list = NULL;
+    memset(&pool->stats, 0, sizeof(PacketBufStats));
+    pool->stats.total = count;
+    for (int i = count - 1; i >= 0; i--) {
+        bufs[i].ref = 0;
+        bufs[i].pool = type;
+        bufs[i].mem = (mem == NULL) ? NULL : mem + i * mem_size;
+        bufs[i].release = NULL;
+        bufs[i].release_arg = NULL;
+        bufs[i].size = mem_size;
+        bufs[i].next = pool->free_list;
+        pool->free_list = &bufs[i];
+    }
+}
+
+int HAL_PacketBuf_Init(void) {
+    if (g_pbuf_mutex != NULL) {
+        return 0;  // 已经初始化
+    }
+    g_pbuf_mutex = osMutexNew(NULL);
+    if (g_pbuf_mutex == NULL) {
+        LOG("Failed to create packet buffer mutex.\n");
+        return -1;
+    }
+    init_pool(PACKET_BUF_POOL_SMALL, g_small_bufs, &g_small_mem[0][0], sizeof(g_small_mem[0]), PACKET_BUF_POOL_SIZE);
+    init_pool(PACKET_BUF_POOL_LARGE, g_large_bufs, &g_large_mem[0][0], sizeof(g_large_mem[0]), PACKET_BUF_LARGE_POOL_SIZE);
+    init_pool(PACKET_BUF_POOL_REF, g_ref_bufs, NULL, 0, PACKET_BUF_REF_POOL_SIZE);
+    return 0;
+}
+
+// 从指定内存池取出一个缓冲区，引用计数为1
+static PacketBuf *take_from_pool(PacketBufPoolType type) {
+    PacketBufPool *pool = &g_pools[type];
+    osMutexAcquire(g_pbuf_mutex, osWaitForever);
+    PacketBuf *buf = pool->free_list;
+    if (buf == NULL) {
+        pool->stats.alloc_failed++;
+        osMutexRelease(g_pbuf_mutex);
+        LOG("Packet buffer pool exhausted.\n");
+        return NULL;
+    }
+    pool->free_list = buf->next;
+    pool->stats.used++;
+    if (pool->stats.used > pool->stats.high_water) {
+        pool->stats.high_water = pool->stats.used;
+    }
+    osMutexRelease(g_pbuf_mutex);
+    buf->next = NULL;
+    buf->ref = 1;
+    return buf;
+}
+
+PacketBuf *HAL_PacketBuf_Alloc(uint16_t len) {
+    if (g_pbuf_mutex == NULL || len > PACKET_BUF_LARGE_DATA_SIZE) {
+        LOG("Invalid packet buffer length: %d\n", len);
+        return NULL;
+    }
+    PacketBuf *buf = take_from_pool(len > PACKET_BUF_DATA_SIZE ? PACKET_BUF_POOL_LARGE : PACKET_BUF_POOL_SMALL);
+    if (buf == NULL) {
+        return NULL;
+    }
+    buf->payload = buf->mem + PACKET_BUF_HEADROOM;
+    buf->len = len;
+    buf->payload[len] = '\0';
+    return buf;
+}
+
+PacketBuf *HAL_PacketBuf_Wrap(char *data, uint16_t len, PacketBufRelease release, void *arg) {
+    if (g_pbuf_mutex == NULL || data == NULL) {
+        return NULL;
+    }
+    PacketBuf *buf = take_from_pool(PACKET_BUF_POOL_REF);
+    if (buf == NULL) {
+        return NULL;
+    }
+    // 没有预留空间，mem与payload相同，不能再向前扩展帧头
+    buf->mem = data;
+    buf->payload = data;
+    buf->len = len;
+    buf->size = len;
+    buf->release = release;
+    buf->release_arg = arg;
+    return buf;
+}
+
+void HAL_PacketBuf_Ref(PacketBuf *buf) {
+    if (buf == NULL) {
+        return;
+    }
+    osMutexAcquire(g_pbuf_mutex, osWaitForever);
+    buf->ref++;
+    osMutexRelease(g_pbuf_mutex);
+}
+
+void HAL_PacketBuf_Free(PacketBuf *buf) {
+    if (buf == NULL) {
+        return;
+    }
+    osMutexAcquire(g_pbuf_mutex, osWaitForever);
+    if (buf->ref == 0) {
+        osMutexRelease(g_pbuf_mutex);
+        LOG("Packet buffer double free.\n");
+        return;
+    }
+    buf->ref--;
+    PacketBufRelease release = NULL;
+    void *release_arg = NULL;
+    if (buf->ref == 0) {
+        // 引用计数为0，归还所属的内存池，外部内存在释放锁之后归还
+        release = buf->release;
+        release_arg = buf->release_arg;
+        buf->release = NULL;
+        buf->release_arg = NULL;
+        PacketBufPool *pool = &g_pools[buf->pool];
+        buf->next = pool->free_list;
+        pool->free_list = buf;
+        pool->stats.used--;
+    }
+    osMutexRelease(g_pbuf_mutex);
+    if (release != NULL) {
+        release(release_arg);
+    }
+}
+
+int HAL_PacketBuf_Header(PacketBuf *buf, int16_t header_size) {
+    if (buf == NULL) {
+        return -1;
+    }
+    if (header_size >= 0) {
+        if (buf->payload - header_size < buf->mem) {
+            LOG("Not enough headroom for %d bytes.\n", header_size);
+            return -1;
+        }
+    } else if (-header_size > buf->len) {
+        LOG("Packet buffer shorter than %d bytes.\n", -header_size);
+        return -1;
+    }
+    buf->payload -= header_size;
+    buf->len += header_size;
+    return 0;
+}
+
+void HAL_PacketBuf_GetStats(PacketBufPoolType pool, PacketBufStats *stats) {
+    if (stats == NULL || g_pbuf_mutex == NULL || pool >= PACKET_BUF_POOL_MAX) {
+        return;
+    }
+    osMutexAcquire(g_pbuf_mutex, osWaitForever);
+    memcpy(stats, &g_pools[pool].stats, sizeof(PacketBufStats));
+    osMutexRelease(g_pbuf_mutex);
+}
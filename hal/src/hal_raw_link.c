@@ -0,0 +1,36 @@
+#include "hal_raw_link.h"
+#include <string.h>
+
+int raw_link_encode_header(uint8_t *header, const uint8_t *dst_eth, const uint8_t *src_eth,
+                           const char *node_mac, uint16_t len) {
+    if (header == NULL || dst_eth == NULL || src_eth == NULL || node_mac == NULL || len > RAW_LINK_MAX_FRAME_LEN) {
+        return -1;
+    }
+    memcpy(header, dst_eth, RAW_LINK_ETH_ADDR_SIZE);
+    memcpy(header + RAW_LINK_ETH_ADDR_SIZE, src_eth, RAW_LINK_ETH_ADDR_SIZE);
+    header[12] = (uint8_t)(RAW_LINK_ETHERTYPE >> 8);
+    header[13] = (uint8_t)(RAW_LINK_ETHERTYPE & 0xFF);
+    memcpy(header + RAW_LINK_ETH_HEADER_SIZE, node_mac, RAW_LINK_NODE_MAC_SIZE);
+    header[RAW_LINK_HEADER_SIZE - 2] = (uint8_t)(len >> 8);
+    header[RAW_LINK_HEADER_SIZE - 1] = (uint8_t)(len & 0xFF);
+    return 0;
+}
+
+int raw_link_decode_header(const uint8_t *frame, uint16_t frame_len, RawLinkInfo *info) {
+    if (frame == NULL || info == NULL || frame_len < RAW_LINK_HEADER_SIZE) {
+        return -1;
+    }
+    if (((frame[12] << 8) | frame[13]) != RAW_LINK_ETHERTYPE) {
+        return -1;
+    }
+    uint16_t len = (uint16_t)((frame[RAW_LINK_HEADER_SIZE - 2] << 8) | frame[RAW_LINK_HEADER_SIZE - 1]);
+    // 长度字段不能超过实际收到的数据，超出的部分是以太网填充
+    if (len == 0 || len > RAW_LINK_MAX_FRAME_LEN || len > frame_len - RAW_LINK_HEADER_SIZE) {
+        return -1;
+    }
+    memcpy(info->src_eth, frame + RAW_LINK_ETH_ADDR_SIZE, RAW_LINK_ETH_ADDR_SIZE);
+    memcpy(info->node_mac, frame + RAW_LINK_ETH_HEADER_SIZE, RAW_LINK_NODE_MAC_SIZE);
+    info->node_mac[RAW_LINK_NODE_MAC_SIZE] = '\0';
+    info->len = len;
+    return 0;
+}
@@ -17,7 +17,17 @@
 #include "lwip/etharp.h"
 //socket相关库文件
 #include "lwip/sockets.h"
+#if ENABLE_NETCONN_DATAGRAM || ENABLE_RAW_LINK
+#include "lwip/api.h"
+#include "lwip/udp.h"
+#endif
+#if ENABLE_RAW_LINK
+#include "lwip/pbuf.h"
+#include "lwip/tcpip.h"
+#include "hal_raw_link.h"
+#endif
 #include <sys/time.h>
+#include <errno.h>
 
 
 // 定义宏开关，打开或关闭日志输出
@@ -46,8 +56,10 @@ static td_void wifi_connection_changed(td_s32 state, const wifi_linked_info_stru
 
 void remove_mac_ip_binding(const char *mac);
 void delete_mac_ip_list(void);
+void delete_leave_sta_mac_ip_list(WiFiSTAInfo *sta_info, uint32_t sta_num);
 
 static char g_sta_ip[16] = {0};  // 保存 STA 模式的 IP 地址
+static char g_ap_ip[16] = {0};   // 保存 SoftAP 的 IP 地址
 
 wifi_event_stru wifi_event_cb = {
     .wifi_event_connection_changed      = wifi_connection_changed,
@@ -71,17 +83,120 @@ void CreateWirelessEventFlags(void) {
 static td_u8 g_wifi_state = WIFI_STA_SAMPLE_INIT;
 
 // 链表的头节点（全局变量，初始化为空）
+// 接收线程的事件循环增删节点，发送线程按MAC查找子节点的IP，所有访问都要持有g_binding_mutex；
+// 持有g_binding_mutex时可以再获取g_conn_mutex（关闭离开子节点的连接），反之不行
 MAC_IP_Node *head = NULL;
 uint32_t len_mac_ip_list = 0;
+static osMutexId_t g_binding_mutex = NULL;
+
+static void binding_lock(void) {
+    if (g_binding_mutex != NULL) {
+        osMutexAcquire(g_binding_mutex, osWaitForever);
+    }
+}
+
+static void binding_unlock(void) {
+    if (g_binding_mutex != NULL) {
+        osMutexRelease(g_binding_mutex);
+    }
+}
 
-// 用于控制服务器是否继续运行的全局标志
-volatile bool server_running = true;
+// 用于控制绑定服务器是否运行的全局标志，SoftAP开启时置位
+volatile bool server_running = false;
 volatile bool client_running = false;
 
-osThreadId_t IP_MAC_thread_id;
 osThreadId_t heart_beat_thread_id;
 int tree_level = 0;
 
+// 邻居连接池：与父节点和每个子节点各保持一条长连接，避免每发送一帧都要三次握手
+#define AP_MAX_STA_NUM 8            // AP最多接入的子节点数量，与监听队列长度一致
+#define CONN_POOL_SIZE ((AP_MAX_STA_NUM + 1) * 2)  // 父节点和每个子节点各有控制面、数据面两条连接
+#define CONN_SEND_TIMEOUT_S 1       // 发送缓冲区持续已满、没有任何进展的最长时间（秒），超过视为对端失联
+#define CONN_CONNECT_TIMEOUT_MS 500 // 建立连接的超时时间（毫秒）
+#define CONN_WAIT_SLICE_MS 50       // 阻塞发送每次等待连接可写或被释放的最长时间
+#define CONN_EVENT_RELEASED 0x01    // 有连接被使用者释放
+
+typedef struct {
+    char ip[16];
+    uint16_t port;
+    int sock;                       // -1 表示空位
+    bool connecting;                // 非阻塞连接尚未完成
+    bool busy;                      // 有线程正在不持锁地使用该连接检查连接或写入
+    bool close_pending;             // 使用期间被要求关闭，使用者释放时关闭
+    bool stalled;                   // 发送缓冲区已满，从stall_start起没有写入任何数据
+    uint32_t connect_start;         // 开始建立连接的时间
+    uint32_t stall_start;           // 发送缓冲区开始持续已满的时间
+    PacketBuf *pending;             // 非阻塞写入没有写完的帧尾（可能含长度前缀），写完之前不写入新的数据帧
+    uint16_t pending_sent;          // pending中已经写入的字节数
+    uint32_t last_used;             // 最近一次使用的时间，连接池满时替换最久未使用的连接
+} NeighborConn;
+
+static NeighborConn g_conn_pool[CONN_POOL_SIZE];
+static osMutexId_t g_conn_mutex = NULL;
+static osEventFlagsId_t g_conn_events = NULL;   // 阻塞发送等待正被使用的连接释放
+static volatile bool g_conn_pool_stale = false;  // STA重新关联后，原有连接全部作废
+
+// 控制面（路由包、广播重发请求）使用单独的端口和连接，不会排在数据包后面
+#define CONTROL_PORT 9003
+
+// 数据服务器保持的客户端长连接，每个连接有自己的分帧状态
+#define SERVER_MAX_CLIENTS CONN_POOL_SIZE
+
+typedef struct {
+    int sock;                       // -1 表示空位
+    bool control;                   // 是否为控制面连接
+    char ip[16];
+    FrameReader reader;
+    bool rx_stalled;                // 内存池耗尽，数据留在socket中，不再select而是每次循环重试
+} ServerClient;
+
+static ServerClient g_server_clients[SERVER_MAX_CLIENTS];
+static int g_server_next_client[2] = {0, 0};  // 每个平面轮流从各个连接读取，避免某个子节点独占
+static int g_control_server_fd = -1;          // 控制面监听套接字
+static uint32_t g_frame_no_buffer = 0;        // 因内存池耗尽而暂停读取连接的次数
+
+#if ENABLE_NETCONN_DATAGRAM
+// 数据报模式使用的UDP连接，绑定在任意地址上，AP侧和STA侧共用，NULL 表示未开启
+static struct netconn *g_udp_conn = NULL;
+static volatile bool g_udp_conn_ready = false;  // 连接中可能还有未取出的数据报
+#else
+// 数据报模式使用的UDP套接字，绑定在INADDR_ANY上，AP侧和STA侧共用，-1 表示未开启
+static int g_udp_sock = -1;
+#endif
+static WiFiDatagramStats g_datagram_stats;
+#if ENABLE_NETCONN_DATAGRAM || ENABLE_RAW_LINK
+static struct udp_pcb *g_wake_pcb = NULL;       // 只在tcpip线程中使用，用于唤醒事件循环
+#endif
+
+#if ENABLE_RAW_LINK
+// 链路层直连传输：tcpip线程收到的帧放入队列，由事件循环取出
+#define RAW_LINK_RX_QUEUE_SIZE 8
+
+typedef struct {
+    PacketBuf *buf;
+    RawLinkInfo info;
+} RawLinkRxItem;
+
+static osMessageQueueId_t g_raw_rx_queue = NULL;
+static volatile bool g_raw_link_open = false;
+static uint8_t g_parent_bssid[WIFI_BSSID_LEN];      // 父节点AP的以太网地址，关联成功时记录
+static volatile bool g_parent_bssid_valid = false;
+static char g_raw_node_mac[7] = {0};                // 本节点的节点MAC，开启时读取一次
+#define RAW_LINK_AP_IFNAME  "ap0"                   // 发给子节点的帧从SoftAP接口发出
+#define RAW_LINK_STA_IFNAME "wlan0"                 // 发给父节点的帧从STA接口发出
+#endif
+
+// 接收事件循环：数据服务器、绑定服务器、邻居长连接和事件套接字在同一个select中等待
+#define SERVER_EVENT_PORT 9002              // 事件套接字端口，只绑定在回环地址上
+#define SERVER_POLL_TIMEOUT_MS 1000         // 没有任何事件时的最长等待时间
+#define SERVER_NO_BUFFER_RETRY_MS 10        // 有连接因内存池耗尽暂停读取时，重新分配缓冲区的间隔
+#define BINDING_CHECK_INTERVAL_MS 1000      // 绑定表老化和子节点离开检查的周期
+#define BINDING_RECV_TIMEOUT_MS 100         // 接收子节点MAC心跳的超时时间
+
+static int g_event_sock = -1;               // 其他线程通过它唤醒事件循环
+static int g_binding_sock = -1;             // 绑定服务器监听套接字，由事件循环根据server_running打开和关闭
+static uint32_t g_binding_check_tick = 0;   // 上次检查绑定表的时间
+
 /*****************************************************************************
   STA 扫描事件回调函数
 *****************************************************************************/
@@ -100,7 +215,17 @@ static td_void wifi_connection_changed(td_s32 state, const wifi_linked_info_stru
 {
     UNUSED(info);
     UNUSED(reason_code);
+#if ENABLE_RAW_LINK
+    // 父节点AP的BSSID就是发给父节点的链路层帧的目标地址
+    g_parent_bssid_valid = false;
+    if (state != WIFI_NOT_AVALLIABLE && info != NULL) {
+        memcpy(g_parent_bssid, info->bssid, WIFI_BSSID_LEN);
+        g_parent_bssid_valid = true;
+    }
+#endif
 
+    // 关联状态变化后父节点可能已经改变，连接池中的连接在下次发送时重建
+    g_conn_pool_stale = true;
     if (state == WIFI_NOT_AVALLIABLE) {
         LOG("Connect fail!. try agin !\r\n");
         g_wifi_state = WIFI_STA_SAMPLE_INIT;
@@ -118,6 +243,32 @@ int HAL_WiFi_Init(void)
 {
     CreateWirelessEventFlags();
 
+    // 初始化邻居连接池
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        g_conn_pool[i].sock = -1;
+    }
+    if (g_conn_mutex == NULL) {
+        g_conn_mutex = osMutexNew(NULL);
+        if (g_conn_mutex == NULL) {
+            LOG("Failed to create connection pool mutex.\r\n");
+            return -1;
+        }
+    }
+    if (g_binding_mutex == NULL) {
+        g_binding_mutex = osMutexNew(NULL);
+        if (g_binding_mutex == NULL) {
+            LOG("Failed to create binding table mutex.\r\n");
+            return -1;
+        }
+    }
+    if (g_conn_events == NULL) {
+        g_conn_events = osEventFlagsNew(NULL);
+        if (g_conn_events == NULL) {
+            LOG("Failed to create connection pool event flags.\r\n");
+            return -1;
+        }
+    }
+
     /* 注册事件回调 */
     if (wifi_register_event_cb(&wifi_event_cb) != 0) {
         LOG("wifi_event_cb register fail.\r\n");
@@ -368,7 +519,7 @@ int HAL_WiFi_Connect(const WiFiSTAConfig *wifi_config)
     // 等待获取 IP 地址
     td_u32 wait_count = 0;
     while (1) {
-        osDelay(1);  // 10ms 延迟
+        osDelay(1);  // 等待一个系统tick
         if (example_check_dhcp_status(netif_p, &wait_count) == 0) {
             break;
         }
@@ -450,6 +601,7 @@ int HAL_WiFi_AP_Enable(WiFiAPConfig *config, int tree_level) {
     IP4_ADDR(&st_ipaddr, 192, 168, tree_level, 1);  // IP地址：192.168.X.1
     IP4_ADDR(&st_netmask, 255, 255, 255, 0); // 子网掩码：255.255.255.0
     IP4_ADDR(&st_gw, 192, 168, tree_level, 255);      // 网关：192.168.X.255
+    snprintf(g_ap_ip, sizeof(g_ap_ip), "192.168.%d.1", tree_level);
 
     // 基本SoftAp配置
     strncpy((char *)hapd_conf.ssid, (const char *)config->ssid, sizeof(hapd_conf.ssid) - 1);
@@ -501,13 +653,9 @@ int HAL_WiFi_AP_Enable(WiFiAPConfig *config, int tree_level) {
         return -1;
     }
 
-    // 创建线程启动MAC地址绑定表
+    // 绑定服务器由接收事件循环打开，唤醒事件循环让它立即开始监听
     server_running = true;
-    IP_MAC_thread_id = osThreadNew((osThreadFunc_t)HAL_WiFi_CreateIPMACBindingServer, NULL, NULL);
-    if (IP_MAC_thread_id == NULL) {
-        LOG("Failed to create MAC-IP binding table thread.\n");
-        return -1;
-    }
+    HAL_WiFi_Server_Wakeup();
 
     LOG("SoftAP started successfully with SSID: %s\n", config->ssid);
     return 0;
@@ -520,9 +668,8 @@ int HAL_WiFi_AP_Disable(void) {
         return -1;
     }
     server_running = false;
+    HAL_WiFi_Server_Wakeup();
     delete_mac_ip_list();
-    osDelay(200); // 等待2s，确保函数执行完成，释放掉socket资源
-    osThreadTerminate(IP_MAC_thread_id);
 
     LOG("SoftAP mode disabled.\n");
     return 0;
@@ -728,6 +875,7 @@ int HAL_WiFi_GetAPConfig(WiFiAPConfig *config) {
 }
 
 void add_mac_ip_binding(const char *mac, const char *ip) {
+    binding_lock();
     MAC_IP_Node *current = head;
 
     // 遍历链表寻找MAC是否已经存在
@@ -736,6 +884,7 @@ void add_mac_ip_binding(const char *mac, const char *ip) {
             // 找到匹配的 MAC 地址，更新 IP 地址
             strcpy(current->binding.ip, ip);
             current->count = 0;
+            binding_unlock();
             return;
         }
         // 继续遍历链表
@@ -745,6 +894,7 @@ void add_mac_ip_binding(const char *mac, const char *ip) {
     // 创建新的节点
     MAC_IP_Node *new_node = (MAC_IP_Node *)malloc(sizeof(MAC_IP_Node));
     if (new_node == NULL) {
+        binding_unlock();
         LOG("Memory allocation failed!\n");
         return;
     }
@@ -752,6 +902,7 @@ void add_mac_ip_binding(const char *mac, const char *ip) {
     // 初始化节点数据
     strcpy(new_node->binding.mac, mac);
     strcpy(new_node->binding.ip, ip);
+    new_node->binding.has_eth = false;
     new_node->count = 0;
     new_node->next = NULL;
 
@@ -761,9 +912,11 @@ void add_mac_ip_binding(const char *mac, const char *ip) {
 
     LOG("Added MAC: %s, IP: %s\n", new_node->binding.mac, new_node->binding.ip);
     len_mac_ip_list++;
+    binding_unlock();
 }
 
-void remove_mac_ip_binding(const char *mac) {
+// 删除一个绑定，需要持有g_binding_mutex
+static void remove_binding_locked(const char *mac) {
     MAC_IP_Node *current = head;
     MAC_IP_Node *previous = NULL;
 
@@ -779,8 +932,10 @@ void remove_mac_ip_binding(const char *mac) {
                 previous->next = current->next;
             }
 
-            // 释放节点的内存
+            // 关闭到该子节点的连接，释放节点的内存
+            HAL_WiFi_Close_Connections(current->binding.ip);
             free(current);
+            len_mac_ip_list--;
             LOG("Removed MAC: %s\n", mac);
             return;
         }
@@ -791,10 +946,17 @@ void remove_mac_ip_binding(const char *mac) {
     }
 
     LOG("MAC: %s not found.\n", mac);
-    len_mac_ip_list--;
+}
+
+void remove_mac_ip_binding(const char *mac) {
+    binding_lock();
+    remove_binding_locked(mac);
+    binding_unlock();
 }
 
 int find_mac_from_ip(const char *ip, char *mac) {
+    int ret = -1;
+    binding_lock();
     MAC_IP_Node *current = head;
 
     // 遍历链表寻找匹配的 IP 地址
@@ -802,31 +964,35 @@ int find_mac_from_ip(const char *ip, char *mac) {
         if (strncmp(current->binding.ip, ip, sizeof(current->binding.ip)) == 0) {
             // 找到匹配的 IP 地址
             strncpy(mac, current->binding.mac, sizeof(current->binding.mac) - 1);
-            return 0;
+            ret = 0;
+            break;
         }
 
         // 继续遍历链表
         current = current->next;
     }
-
-    // 没有找到匹配的 IP 地址
-    return -1;
+    binding_unlock();
+    return ret;
 }
 
 void add_mac_ip_bindings_counts(void) {
+    binding_lock();
     MAC_IP_Node *current = head;
 
     // 遍历链表，为每个节点的计数器加 1
     while (current != NULL) {
+        MAC_IP_Node *next_node = current->next;  // 删除节点后不能再访问current
         current->count++;
         if (current -> count > 30) {
-            remove_mac_ip_binding(current->binding.mac);
+            remove_binding_locked(current->binding.mac);
         }
-        current = current->next;
+        current = next_node;
     }
+    binding_unlock();
 }
 
 void print_mac_ip_bindings(void) {
+    binding_lock();
     MAC_IP_Node *current = head;
 
     LOG("Current MAC-IP Bindings:\n");
@@ -834,9 +1000,11 @@ void print_mac_ip_bindings(void) {
         LOG("MAC: %s, IP: %s, count: %d\n", current->binding.mac, current->binding.ip, current->count);
         current = current->next;
     }
+    binding_unlock();
 }
 
 void delete_mac_ip_list(void) {
+    binding_lock();
     MAC_IP_Node *current = head;
     MAC_IP_Node *next_node;
 
@@ -849,6 +1017,8 @@ void delete_mac_ip_list(void) {
     head = NULL;  // 头指针置空，链表删除完成
     LOG("All MAC-IP bindings have been deleted.\n");
     len_mac_ip_list = 0;
+    binding_unlock();
+    HAL_WiFi_Close_Connections(NULL);
 }
 
 void get_last_three_mac(char *mac, const uint8_t *full_mac) {
@@ -861,12 +1031,14 @@ void get_last_three_mac(char *mac, const uint8_t *full_mac) {
 }
 
 void delete_leave_sta_mac_ip_list(WiFiSTAInfo *sta_info, uint32_t sta_num) {
+    binding_lock();
     MAC_IP_Node *current = head;
     MAC_IP_Node *previous = NULL;
     WiFiSTAInfo *sta = sta_info;
     bool found = false;
 
     while (current != NULL) {
+        MAC_IP_Node *next_node = current->next;
         found = false;
         for (uint32_t i = 0; i < sta_num; i++) {
             char sta_mac[7];
@@ -888,14 +1060,17 @@ void delete_leave_sta_mac_ip_list(WiFiSTAInfo *sta_info, uint32_t sta_num) {
                 previous->next = current->next;
             }
 
-            // 释放节点的内存
+            // 子节点已经离开，关闭到该子节点的连接，释放节点的内存
+            LOG("STA %s left, closing connection.\n", current->binding.mac);
+            HAL_WiFi_Close_Connections(current->binding.ip);
             free(current);
             len_mac_ip_list--;
         } else {
             previous = current;
         }
-        current = current->next;
+        current = next_node;
     }
+    binding_unlock();
 }
 
 int HAL_WiFi_GetAllMAC(char ***mac_list) {
@@ -904,16 +1079,19 @@ int HAL_WiFi_GetAllMAC(char ***mac_list) {
         return -1;
     }
 
+    binding_lock();
     MAC_IP_Node *current = head;
     uint32_t count = 0;
 
     if (len_mac_ip_list == 0) {
+        binding_unlock();
         return 0;
     }
 
     // 分配指针数组，大小为 len_mac_ip_list
     *mac_list = (char **)malloc(len_mac_ip_list * sizeof(char *));
     if (*mac_list == NULL) {
+        binding_unlock();
         LOG("Memory allocation failed.\n");
         return -1;
     }
@@ -922,6 +1100,7 @@ int HAL_WiFi_GetAllMAC(char ***mac_list) {
     while (current != NULL) {
         (*mac_list)[count] = (char *)malloc(7 * sizeof(char));  // 分配空间给每个MAC地址
         if ((*mac_list)[count] == NULL) {
+            binding_unlock();
             LOG("Memory allocation failed.\n");
             return -1;
         }
@@ -929,6 +1108,7 @@ int HAL_WiFi_GetAllMAC(char ***mac_list) {
         count++;
         current = current->next;
     }
+    binding_unlock();
 
     // 返回实际拷贝的 MAC 地址数量
     return count;
@@ -936,12 +1116,13 @@ int HAL_WiFi_GetAllMAC(char ***mac_list) {
 
 
 
-void HAL_WiFi_CreateIPMACBindingServer(void) {
+// 创建一个监听指定端口的TCP套接字，失败返回-1
+static int open_listen_socket(uint16_t port) {
     // 创建一个 TCP 套接字
     int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
     if (listen_sock < 0) {
         LOG("Failed to create socket.\n");
-        return;
+        return -1;
     }
 
     // 设置 SO_REUSEADDR 套接字选项，允许端口复用
@@ -949,69 +1130,122 @@ void HAL_WiFi_CreateIPMACBindingServer(void) {
     if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
         LOG("Failed to set socket options.\n");
         closesocket(listen_sock);
-        return;
+        return -1;
     }
 
     // 设置服务器地址
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(9000);
+    server_addr.sin_port = htons(port);
     server_addr.sin_addr.s_addr = INADDR_ANY;
 
     // 绑定地址和端口
     if (bind(listen_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
         LOG("Failed to bind socket.\n");
         closesocket(listen_sock);
-        return;
+        return -1;
     }
 
-    // 开始监听连接请求
+    // 开始监听连接请求，只在select报告可读后才accept，不需要设置超时
     if (listen(listen_sock, 8) < 0) {
         LOG("Failed to listen on socket.\n");
         closesocket(listen_sock);
+        return -1;
+    }
+    return listen_sock;
+}
+
+// 根据server_running打开或关闭绑定服务器，只在事件循环中调用
+static void update_binding_server(void) {
+    if (server_running && g_binding_sock < 0) {
+        g_binding_sock = open_listen_socket(9000);
+        g_binding_check_tick = osKernelGetTickCount();
+        LOG("Binding server is listening on port 9000...\n");
+    } else if (!server_running && g_binding_sock >= 0) {
+        closesocket(g_binding_sock);
+        g_binding_sock = -1;
+        LOG("Binding server stopped.\n");
+    }
+}
+
+#if ENABLE_RAW_LINK
+// 按MAC查找绑定，需要持有g_binding_mutex，返回的节点只能在持锁期间使用
+static MAC_IP_Node *find_binding(const char *mac) {
+    MAC_IP_Node *current = head;
+    while (current != NULL && strncmp(current->binding.mac, mac, sizeof(current->binding.mac) - 1) != 0) {
+        current = current->next;
+    }
+    return current;
+}
+
+// 子节点的心跳连接刚刚建立，ARP表中已有它的以太网地址，记录到绑定表中供链路层直连传输使用
+static void resolve_binding_eth(const char *mac, const char *ip) {
+    struct netif *netif = netif_find(RAW_LINK_AP_IFNAME);
+    ip4_addr_t addr;
+    if (netif == NULL || !ip4addr_aton(ip, &addr)) {
+        return;
+    }
+    struct eth_addr *eth = NULL;
+    const ip4_addr_t *ip_ret = NULL;
+    uint8_t eth_addr[WIFI_BSSID_LEN];
+    bool found = false;
+    LOCK_TCPIP_CORE();
+    if (etharp_find_addr(netif, &addr, &eth, &ip_ret) >= 0 && eth != NULL) {
+        memcpy(eth_addr, eth->addr, WIFI_BSSID_LEN);
+        found = true;
+    }
+    UNLOCK_TCPIP_CORE();
+    if (!found) {
         return;
     }
+    binding_lock();
+    MAC_IP_Node *node = find_binding(mac);
+    if (node != NULL) {
+        memcpy(node->binding.eth, eth_addr, WIFI_BSSID_LEN);
+        node->binding.has_eth = true;
+    }
+    binding_unlock();
+}
+#endif
 
-    // 设置 accept 的超时时间为1秒
+// 接收子节点发来的MAC心跳并更新绑定表
+static void accept_binding_client(void) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    int client_sock = accept(g_binding_sock, (struct sockaddr *)&client_addr, &client_addr_len);
+    if (client_sock < 0) {
+        return;
+    }
+    // 子节点连接后立即发送MAC地址，只等待很短的时间，不阻塞事件循环
     struct timeval timeout;
-    timeout.tv_sec = 1;  // 1秒超时
-    timeout.tv_usec = 0;
-    setsockopt(listen_sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
-
-    LOG("Server is listening on port 9000...\n");
-    char mac[7];
-    char ip[16];
-    while (server_running) {  // 使用全局标志控制循环
-        add_mac_ip_bindings_counts();
-        print_mac_ip_bindings();
-        // 接受连接请求
-        struct sockaddr_in client_addr;
-        socklen_t client_addr_len = sizeof(client_addr);
-        int client_sock = accept(listen_sock, (struct sockaddr *)&client_addr, &client_addr_len);
-        if (client_sock < 0) {
-            continue;
-        }else{
-            // 接收数据
-            char buffer[10];
-            int ret = recv(client_sock, buffer, sizeof(buffer) - 1, 0);  // 需要改成非阻塞接受
-            if (ret < 0 || ret > 7) {
-                // 超时或数据长度不符合要求
-                closesocket(client_sock);
-                continue;
-            }
-            buffer[ret] = '\0';  // 确保字符串以 NULL 结尾
-            strcpy(mac, buffer);
-            inet_ntop(AF_INET, &client_addr.sin_addr, ip, INET_ADDRSTRLEN);
-            add_mac_ip_binding(mac, ip);
-            LOG("Received data: %s\n", buffer);
-        }
-        closesocket(client_sock);
+    timeout.tv_sec = 0;
+    timeout.tv_usec = BINDING_RECV_TIMEOUT_MS * 1000;
+    setsockopt(client_sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+    char buffer[10];
+    int ret = recv(client_sock, buffer, sizeof(buffer) - 1, 0);
+    if (ret > 0 && ret <= 7) {
+        buffer[ret] = '\0';  // 确保字符串以 NULL 结尾
+        char ip[16];
+        inet_ntop(AF_INET, &client_addr.sin_addr, ip, INET_ADDRSTRLEN);
+        add_mac_ip_binding(buffer, ip);
+#if ENABLE_RAW_LINK
+        resolve_binding_eth(buffer, ip);
+#endif
+        LOG("Received data: %s\n", buffer);
     }
+    closesocket(client_sock);
+}
 
-    // 关闭监听套接字
-    closesocket(listen_sock);
-    LOG("Server stopped.\n");
+// 周期性老化绑定表，删除已经断开关联的子节点，并关闭到它们的连接
+static void check_binding_table(void) {
+    add_mac_ip_bindings_counts();
+    WiFiSTAInfo sta_info[AP_MAX_STA_NUM];
+    uint32_t sta_num = AP_MAX_STA_NUM;
+    if (HAL_WiFi_GetConnectedSTAInfo(sta_info, &sta_num) == 0) {
+        delete_leave_sta_mac_ip_list(sta_info, sta_num);
+    }
+    print_mac_ip_bindings();
 }
 
 void HAL_WiFi_CreateIPMACBindingClient(void) {
@@ -1030,140 +1264,1491 @@ void HAL_WiFi_CreateIPMACBindingClient(void) {
     }
 }
 
-int HAL_WiFi_Send_data_by_MAC(const char *MAC, const char *data) {
-    if (MAC == NULL || data == NULL) {
-        LOG("Invalid input: MAC or data is NULL.\n");
-        return -1;
-    }
-
-    // 查找 MAC 对应的 IP 地址
-    MAC_IP_Node *current = head;
-    char ip[16];
-    while (current != NULL) {
-        if (strncmp(current->binding.mac, MAC, 7) == 0) {
-            strncpy(ip, current->binding.ip, sizeof(ip) - 1);
-            break;
-        }
-        current = current->next;
-    }
-
-    if (current == NULL) {
-        LOG("MAC: %s not found.\n", MAC);
-        return -1;
-    }
-    if(HAL_WiFi_Send_data(ip, 9001, data) != 0){
-    
-        LOG("send data fail.\r\n");
-        return -2;
-    }
-    
-    return 0;
+static void set_nonblocking(int sockfd, int on) {
+    int mode = on;
+    ioctlsocket(sockfd, FIONBIO, &mode);
 }
 
-int HAL_WiFi_Send_data_to_parent(const char *data, int tree_level) {
-    if (data == NULL) {
-        LOG("Invalid input: data is NULL.\n");
-        return -1;
+// 等待socket可写（非阻塞连接完成或发送缓冲区有空位），返回1表示可写，0表示wait_ms内仍不可写，-1表示连接出错
+static int wait_writable(int sockfd, uint32_t wait_ms) {
+    fd_set write_fds;
+    FD_ZERO(&write_fds);
+    FD_SET(sockfd, &write_fds);
+    struct timeval timeout;
+    timeout.tv_sec = wait_ms / 1000;
+    timeout.tv_usec = (wait_ms % 1000) * 1000;
+    int ret = select(sockfd + 1, NULL, &write_fds, NULL, &timeout);
+    if (ret == 0) {
+        return 0;
     }
-
-    char ip[16];
-    snprintf(ip, sizeof(ip), "192.168.%d.1", tree_level);
-
-    if(HAL_WiFi_Send_data(ip, 9001, data) != 0){
-        LOG("send data fail.\r\n");
+    int err = 0;
+    socklen_t err_len = sizeof(err);
+    if (ret < 0 || getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &err, &err_len) < 0 || err != 0) {
         return -1;
     }
-    return 0;
+    return 1;
 }
 
-int HAL_WiFi_Create_Server(uint16_t port) {
+// 发起一条到邻居节点的非阻塞TCP连接，返回socket描述符，失败返回-1
+// 连接立即完成时*in_progress为0，否则为1，需要调用check_neighbor_connect检查是否完成
+// socket始终是非阻塞的，发送线程不会阻塞在connect或send上
+static int connect_neighbor(const char *ip, uint16_t port, bool *in_progress) {
     // 创建一个 TCP 套接字
-    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_sock < 0) {
+    int sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sockfd < 0) {
         LOG("Failed to create socket.\n");
         return -1;
     }
-
-    // 设置 SO_REUSEADDR 套接字选项，允许端口复用
+    // 长度前缀和数据分两次写入，关闭Nagle算法避免数据帧被延迟
     int optval = 1;
-    if (setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)) < 0) {
-        LOG("Failed to set socket options.\n");
-        closesocket(listen_sock);
-        return -1;
-    }
+    setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval));
 
     // 设置服务器地址
     struct sockaddr_in server_addr;
     memset(&server_addr, 0, sizeof(server_addr));
     server_addr.sin_family = AF_INET;
     server_addr.sin_port = htons(port);
-    server_addr.sin_addr.s_addr = INADDR_ANY;
-
-    // 绑定地址和端口
-    if (bind(listen_sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
-        LOG("Failed to bind socket.\n");
-        closesocket(listen_sock);
+    if (inet_pton(AF_INET, ip, &server_addr.sin_addr) <= 0) {
+        LOG("IP address conversion failed.\n");
+        closesocket(sockfd);
         return -1;
     }
 
-    // 开始监听连接请求
-    if (listen(listen_sock, 8) < 0) {
-        LOG("Failed to listen on socket.\n");
-        closesocket(listen_sock);
-        return -1;
+    // 连接到服务器，对端不可达时不能让发送线程阻塞在connect上
+    set_nonblocking(sockfd, 1);
+    *in_progress = false;
+    if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0) {
+        if (errno != EINPROGRESS) {
+            LOG("Failed to connect to server.\n");
+            closesocket(sockfd);
+            return -1;
+        }
+        *in_progress = true;
     }
+    return sockfd;
+}
 
-    // 设置 accept 的超时时间为1秒
-    struct timeval timeout;
-    timeout.tv_sec = 1;  // 1秒超时
-    timeout.tv_usec = 0;
-    setsockopt(listen_sock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+static void close_neighbor_conn(NeighborConn *conn) {
+    if (conn->sock >= 0) {
+        closesocket(conn->sock);
+    }
+    conn->sock = -1;
+    conn->connecting = false;
+    conn->close_pending = false;
+    conn->stalled = false;
+    if (conn->pending != NULL) {
+        HAL_PacketBuf_Free(conn->pending);
+        conn->pending = NULL;
+    }
+    conn->pending_sent = 0;
+    conn->ip[0] = '\0';
+}
 
-    return listen_sock;
+// 关闭连接，需要持有g_conn_mutex；正在使用的连接先shutdown，由使用者释放时关闭
+static void drop_neighbor_conn(NeighborConn *conn) {
+    if (conn->busy) {
+        shutdown(conn->sock, SHUT_RDWR);
+        conn->close_pending = true;
+        return;
+    }
+    close_neighbor_conn(conn);
 }
 
-int HAL_WiFi_Server_Receive(int server_fd, char *mac, char *buffer, int buffer_len) {
-    if (server_fd < 0 || buffer == NULL || buffer_len <= 0) {
-        LOG("Invalid input: server_fd, buffer or buffer_len is invalid.\n");
-        return -1;
+// 对端只接收不发送，连接上有可读事件说明对端已经关闭或连接出错
+static bool neighbor_conn_alive(int sock) {
+    char c;
+    int ret = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    return ret < 0 && (errno == EWOULDBLOCK || errno == EAGAIN);
+}
+
+// 关闭到指定IP的所有连接，ip为NULL时关闭全部连接，需要持有g_conn_mutex
+static void close_neighbor_conns(const char *ip) {
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        if (g_conn_pool[i].sock >= 0 && (ip == NULL || strcmp(g_conn_pool[i].ip, ip) == 0)) {
+            drop_neighbor_conn(&g_conn_pool[i]);
+        }
     }
+}
 
-    // 接受连接请求
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
-    int client_sock = accept(server_fd, (struct sockaddr *)&client_addr, &client_addr_len);
-    if (client_sock < 0) {
-        return -1;
+// 不等待地检查正在建立的连接，返回1表示已连接，0表示仍在连接，-1表示连接失败或超时
+static int check_neighbor_connect(NeighborConn *conn) {
+    uint32_t timeout = CONN_CONNECT_TIMEOUT_MS * osKernelGetTickFreq() / 1000;
+    uint32_t elapsed = osKernelGetTickCount() - conn->connect_start;
+    int ret = wait_writable(conn->sock, 0);
+    if (ret == 1) {
+        conn->connecting = false;
+        return 1;
+    }
+    if (ret == 0 && elapsed < timeout) {
+        return 0;
     }
+    LOG("Failed to connect to %s.\n", conn->ip);
+    return -1;
+}
 
-    // 接收数据
-    int ret = recv(client_sock, buffer, buffer_len - 1, 0);
-    if (ret < 0) {
-        LOG("Failed to receive data.\n");
-        closesocket(client_sock);
-        return -1;
+// 从连接池中取出到指定邻居的连接，没有则新建，需要持有g_conn_mutex
+// 不等待连接完成，返回的连接可能仍处于connecting状态，也可能正被其他线程使用
+static NeighborConn *get_neighbor_conn(const char *ip, uint16_t port) {
+    NeighborConn *slot = NULL;
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        NeighborConn *conn = &g_conn_pool[i];
+        if (conn->sock >= 0 && conn->port == port && strcmp(conn->ip, ip) == 0) {
+            if (conn->busy || conn->connecting) {
+                conn->last_used = osKernelGetTickCount();
+                return conn;
+            }
+            if (neighbor_conn_alive(conn->sock)) {
+                conn->last_used = osKernelGetTickCount();
+                return conn;
+            }
+            LOG("Connection to %s closed by peer, reconnecting.\n", ip);
+            close_neighbor_conn(conn);
+            slot = conn;
+            break;
+        }
+        // 优先使用空位，否则替换最久未使用的连接，正在使用的连接不能替换
+        if (conn->busy) {
+            continue;
+        }
+        if (slot == NULL || (slot->sock >= 0 && (conn->sock < 0 || conn->last_used < slot->last_used))) {
+            slot = conn;
+        }
     }
-    buffer[ret] = '\0';  // 确保字符串以 NULL 结尾
+    if (slot == NULL) {
+        LOG("All connections are busy.\n");
+        return NULL;
+    }
+    close_neighbor_conn(slot);
+    bool in_progress = false;
+    int sock = connect_neighbor(ip, port, &in_progress);
+    if (sock < 0) {
+        return NULL;
+    }
+    strncpy(slot->ip, ip, sizeof(slot->ip) - 1);
+    slot->ip[sizeof(slot->ip) - 1] = '\0';
+    slot->port = port;
+    slot->sock = sock;
+    slot->connecting = in_progress;
+    slot->connect_start = osKernelGetTickCount();
+    slot->last_used = slot->connect_start;
+    return slot;
+}
 
-    // 获取客户端 ip 地址
-    char ip[16];
-    inet_ntop(AF_INET, &client_addr.sin_addr, ip, INET_ADDRSTRLEN);
+// 取出到指定邻居的连接并标记为正在使用，需要持有g_conn_mutex
+// 连接正被其他线程使用时返回NULL并把*busy置为true，不等待；返回后调用方不持锁使用该连接，用完调用release_neighbor_conn
+static NeighborConn *acquire_neighbor_conn(const char *ip, uint16_t port, bool *busy) {
+    NeighborConn *conn = get_neighbor_conn(ip, port);
+    *busy = (conn != NULL && conn->busy);
+    if (conn == NULL || conn->busy) {
+        return NULL;
+    }
+    conn->busy = true;
+    return conn;
+}
 
-    // 查找 MAC 对应的 IP 地址
-    find_mac_from_ip(ip, mac);
+// 用完连接后调用，需要持有g_conn_mutex；failed为true或使用期间被要求关闭时关闭连接
+static void release_neighbor_conn(NeighborConn *conn, bool failed) {
+    conn->busy = false;
+    if (failed || conn->close_pending) {
+        close_neighbor_conn(conn);
+    }
+    osEventFlagsSet(g_conn_events, CONN_EVENT_RELEASED);
+}
 
-    // 关闭客户端套接字
-    closesocket(client_sock);
-    return ret;
+// 非阻塞写入，返回写入的字节数，发送缓冲区已满返回0，出错返回-1
+static int send_nonblocking(int sock, const char *data, int len) {
+    int ret = send(sock, data, len, MSG_DONTWAIT);
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+        return 0;
+    }
+    return -1;
 }
 
-int HAL_WiFi_Close_Server(int server_fd) {
-    if (server_fd < 0) {
-        LOG("Invalid input: server_fd is invalid.\n");
+// 发送缓冲区已满时调用：返回1表示稍后重试，-1表示超过CONN_SEND_TIMEOUT_S没有写入任何数据，
+// 对端已接受连接但不再接收（离开覆盖范围且没有RST），连接需要关闭
+static int neighbor_conn_blocked(NeighborConn *conn) {
+    uint32_t now = osKernelGetTickCount();
+    if (!conn->stalled) {
+        conn->stalled = true;
+        conn->stall_start = now;
+        return 1;
+    }
+    return (now - conn->stall_start < CONN_SEND_TIMEOUT_S * osKernelGetTickFreq()) ? 1 : -1;
+}
+
+// 写完上次没有写完的帧尾，返回0表示已写完，1表示发送缓冲区已满、稍后重试，-1表示出错或对端失联
+static int flush_neighbor_conn(NeighborConn *conn) {
+    PacketBuf *pending = conn->pending;
+    while (conn->pending_sent < pending->len) {
+        int ret = send_nonblocking(conn->sock, pending->payload + conn->pending_sent, pending->len - conn->pending_sent);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret == 0) {
+            return neighbor_conn_blocked(conn);
+        }
+        conn->pending_sent += ret;
+        conn->stalled = false;
+    }
+    HAL_PacketBuf_Free(pending);
+    conn->pending = NULL;
+    conn->pending_sent = 0;
+    return 0;
+}
+
+// 非阻塞地写入长度前缀和数据帧：返回0表示已写入，或者写入一部分、剩余部分拷贝到conn->pending中；
+// 返回1表示一个字节都没有写入、稍后重试，-1表示出错、对端失联或没有缓冲区保存剩余部分
+static int write_neighbor_frame(NeighborConn *conn, const char *prefix, const char *data, uint16_t len) {
+    int total = FRAME_LEN_PREFIX_SIZE + len;
+    int sent = 0;
+    while (sent < total) {
+        int ret = (sent < FRAME_LEN_PREFIX_SIZE)
+                      ? send_nonblocking(conn->sock, prefix + sent, FRAME_LEN_PREFIX_SIZE - sent)
+                      : send_nonblocking(conn->sock, data + (sent - FRAME_LEN_PREFIX_SIZE), total - sent);
+        if (ret < 0) {
+            return -1;
+        }
+        if (ret == 0) {
+            break;
+        }
+        sent += ret;
+        conn->stalled = false;
+    }
+    if (sent == total) {
+        return 0;
+    }
+    if (sent == 0) {
+        return neighbor_conn_blocked(conn);
+    }
+    // 数据帧已经写了一部分，后面的数据帧不能插在中间：剩余部分由连接保存，下次发送时先写完
+    PacketBuf *tail = HAL_PacketBuf_Alloc((uint16_t)(total - sent));
+    if (tail == NULL) {
+        LOG("No packet buffer for unsent frame tail, closing connection.\n");
         return -1;
     }
+    int offset = 0;
+    if (sent < FRAME_LEN_PREFIX_SIZE) {
+        offset = FRAME_LEN_PREFIX_SIZE - sent;
+        memcpy(tail->payload, prefix + sent, offset);
+        sent = FRAME_LEN_PREFIX_SIZE;
+    }
+    memcpy(tail->payload + offset, data + (sent - FRAME_LEN_PREFIX_SIZE), total - sent);
+    conn->pending = tail;
+    conn->pending_sent = 0;
+    return 0;
+}
+
+// 写完各连接上没有写完的帧尾，在接收线程的事件循环中调用，对端失联的连接关闭
+// 写入是非阻塞的，持锁进行；正被发送线程使用的连接由发送线程自己先写完帧尾
+static void flush_neighbor_conns(void) {
+    if (g_conn_mutex == NULL) {
+        return;
+    }
+    osMutexAcquire(g_conn_mutex, osWaitForever);
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        NeighborConn *conn = &g_conn_pool[i];
+        if (conn->sock < 0 || conn->pending == NULL || conn->busy || conn->connecting) {
+            continue;
+        }
+        if (flush_neighbor_conn(conn) < 0) {
+            LOG("Failed to flush frame to %s, closing connection.\n", conn->ip);
+            close_neighbor_conn(conn);
+        }
+    }
+    osMutexRelease(g_conn_mutex);
+}
+
+// 不阻塞地发送一个数据帧，返回0表示成功，1表示连接正在建立、发送缓冲区已满或连接正被使用，-1表示失败
+// 返回1时*wait_sock为可以等待可写的socket，连接正被使用时为-1
+static int try_send_frame(const char *ip, uint16_t port, const char *prefix, const char *data, uint16_t len,
+                          int *wait_sock) {
+    // 连接池的锁只保护取出和归还连接；同一条连接上的数据帧不能交错，由busy标记保证
+    int ret = -1;
+    bool tail_left = false;
+    *wait_sock = -1;
+    osMutexAcquire(g_conn_mutex, osWaitForever);
+    if (g_conn_pool_stale) {
+        close_neighbor_conns(NULL);
+        g_conn_pool_stale = false;
+    }
+    // 长连接可能在两次发送之间失效，写入失败后重新连接再试一次
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool busy = false;
+        NeighborConn *conn = acquire_neighbor_conn(ip, port, &busy);
+        if (conn == NULL) {
+            ret = busy ? 1 : -1;
+            break;
+        }
+        osMutexRelease(g_conn_mutex);
+        int state = conn->connecting ? check_neighbor_connect(conn) : 1;
+        if (state == 1) {
+            ret = (conn->pending != NULL) ? flush_neighbor_conn(conn) : 0;
+            if (ret == 0) {
+                ret = write_neighbor_frame(conn, prefix, data, len);
+            }
+            if (ret < 0) {
+                LOG("Failed to send frame to %s, reconnecting.\n", ip);
+            }
+        } else {
+            ret = (state == 0) ? 1 : -1;
+        }
+        if (ret == 1) {
+            *wait_sock = conn->sock;
+        }
+        tail_left = (ret == 0 && conn->pending != NULL);
+        osMutexAcquire(g_conn_mutex, osWaitForever);
+        release_neighbor_conn(conn, ret < 0);
+        if (ret >= 0 || state < 0) {
+            break;
+        }
+    }
+    osMutexRelease(g_conn_mutex);
+    if (tail_left) {
+        // 帧尾由接收线程的事件循环在连接可写时写完，不依赖下一个发往该邻居的数据帧
+        HAL_WiFi_Server_Wakeup();
+    }
+    return ret;
+}
 
-    // 关闭监听套接字
+// 发送一个数据帧，wait为false时不阻塞，连接尚未建立或发送缓冲区已满时直接返回1
+static int send_frame(const char *ip, uint16_t port, const char *data, uint16_t len, bool wait) {
+    if (ip == NULL || data == NULL || len == 0 || len > FRAME_MAX_LEN) {
+        LOG("Invalid input: ip, data or len is invalid.\n");
+        return -1;
+    }
+    if (g_conn_mutex == NULL) {
+        LOG("Connection pool not initialized.\n");
+        return -1;
+    }
+
+    char prefix[FRAME_LEN_PREFIX_SIZE];
+    prefix[0] = (char)(len >> 8);
+    prefix[1] = (char)(len & 0xFF);
+
+    // 连接超时和对端失联由try_send_frame判断，这里的期限只是兜底
+    uint32_t start = osKernelGetTickCount();
+    uint32_t limit = (CONN_CONNECT_TIMEOUT_MS + CONN_SEND_TIMEOUT_S * 1000 + CONN_WAIT_SLICE_MS) * osKernelGetTickFreq() / 1000;
+    while (1) {
+        int wait_sock = -1;
+        int ret = try_send_frame(ip, port, prefix, data, len, &wait_sock);
+        if (ret != 1 || !wait) {
+            return ret;
+        }
+        uint32_t elapsed = osKernelGetTickCount() - start;
+        if (elapsed >= limit) {
+            LOG("Timed out sending frame to %s.\n", ip);
+            return -1;
+        }
+        // 阻塞发送在调用线程中等待连接可写或被释放，不占用连接
+        uint32_t wait_ms = (limit - elapsed) * 1000 / osKernelGetTickFreq();
+        if (wait_ms > CONN_WAIT_SLICE_MS) {
+            wait_ms = CONN_WAIT_SLICE_MS;
+        }
+        if (wait_sock >= 0) {
+            wait_writable(wait_sock, wait_ms);
+        } else {
+            osEventFlagsWait(g_conn_events, CONN_EVENT_RELEASED, osFlagsWaitAny, wait_ms * osKernelGetTickFreq() / 1000 + 1);
+        }
+    }
+}
+
+int HAL_WiFi_Send_frame(const char *ip, uint16_t port, const char *data, uint16_t len) {
+    return send_frame(ip, port, data, len, true);
+}
+
+int HAL_WiFi_Try_send_frame(const char *ip, uint16_t port, const char *data, uint16_t len) {
+    return send_frame(ip, port, data, len, false);
+}
+
+void HAL_WiFi_Close_Connections(const char *ip) {
+    if (g_conn_mutex == NULL) {
+        return;
+    }
+    osMutexAcquire(g_conn_mutex, osWaitForever);
+    close_neighbor_conns(ip);
+    osMutexRelease(g_conn_mutex);
+}
+
+void HAL_WiFi_FrameReader_Init(FrameReader *reader) {
+    memset(reader, 0, sizeof(FrameReader));
+}
+
+void HAL_WiFi_FrameReader_Reset(FrameReader *reader) {
+    if (reader->buf != NULL) {
+        HAL_PacketBuf_Free(reader->buf);
+    }
+    memset(reader, 0, sizeof(FrameReader));
+}
+
+// recv的返回值：0表示对端关闭，非阻塞socket上暂时没有数据不算出错
+static int recv_result(int ret) {
+    if (ret > 0) {
+        return ret;
+    }
+    if (ret < 0 && (errno == EWOULDBLOCK || errno == EAGAIN)) {
+        return 0;
+    }
+    return -1;
+}
+
+int HAL_WiFi_FrameReader_Feed(FrameReader *reader, int sock, PacketBuf **frame) {
+    // 先接收长度前缀
+    if (reader->prefix_received < FRAME_LEN_PREFIX_SIZE) {
+        int ret = recv_result(recv(sock, (char *)reader->prefix + reader->prefix_received,
+                                   FRAME_LEN_PREFIX_SIZE - reader->prefix_received, 0));
+        if (ret <= 0) {
+            return ret;
+        }
+        reader->prefix_received += ret;
+        if (reader->prefix_received < FRAME_LEN_PREFIX_SIZE) {
+            return 0;
+        }
+        reader->frame_len = ((uint16_t)reader->prefix[0] << 8) | reader->prefix[1];
+        if (reader->frame_len == 0 || reader->frame_len > FRAME_MAX_LEN) {
+            LOG("Invalid frame length: %d\n", reader->frame_len);
+            return -1;
+        }
+        // 按帧长度从合适大小的内存池中分配缓冲区
+        reader->received = 0;
+        reader->buf = HAL_PacketBuf_Alloc(reader->frame_len);
+        return (reader->buf != NULL) ? 0 : FRAME_READ_NO_BUFFER;
+    }
+    // 内存池耗尽是暂时的：长度前缀已经收下，数据帧留在socket中，分配到缓冲区后再接收
+    if (reader->buf == NULL) {
+        reader->buf = HAL_PacketBuf_Alloc(reader->frame_len);
+        if (reader->buf == NULL) {
+            return FRAME_READ_NO_BUFFER;
+        }
+    }
+
+    // 再接收数据帧，可能需要多次recv才能收完
+    int ret = recv_result(recv(sock, reader->buf->payload + reader->received, reader->frame_len - reader->received, 0));
+    if (ret <= 0) {
+        return ret;
+    }
+    reader->received += ret;
+    if (reader->received < reader->frame_len) {
+        return 0;
+    }
+    *frame = reader->buf;
+    reader->buf = NULL;
+    reader->prefix_received = 0;
+    reader->frame_len = 0;
+    reader->received = 0;
+    return 1;
+}
+
+int HAL_WiFi_Send_data_by_MAC(const char *MAC, const char *data) {
+    if (MAC == NULL || data == NULL) {
+        LOG("Invalid input: MAC or data is NULL.\n");
+        return -1;
+    }
+    return HAL_WiFi_Send_frame_by_MAC(MAC, data, strlen(data));
+}
+
+// 从MAC-IP绑定表中查找子节点的IP地址
+static int find_ip_from_mac(const char *mac, char *ip, int ip_len) {
+    int ret = -1;
+    binding_lock();
+    MAC_IP_Node *current = head;
+    while (current != NULL) {
+        if (strncmp(current->binding.mac, mac, 7) == 0) {
+            strncpy(ip, current->binding.ip, ip_len - 1);
+            ip[ip_len - 1] = '\0';
+            ret = 0;
+            break;
+        }
+        current = current->next;
+    }
+    binding_unlock();
+    return ret;
+}
+
+int HAL_WiFi_Send_frame_by_MAC(const char *MAC, const char *data, uint16_t len) {
+    if (MAC == NULL || data == NULL) {
+        LOG("Invalid input: MAC or data is NULL.\n");
+        return -1;
+    }
+
+    // 查找 MAC 对应的 IP 地址
+    char ip[16];
+    if (find_ip_from_mac(MAC, ip, sizeof(ip)) != 0) {
+        LOG("MAC: %s not found.\n", MAC);
+        return -1;
+    }
+    if(HAL_WiFi_Send_frame(ip, 9001, data, len) != 0){
+    
+        LOG("send data fail.\r\n");
+        return -2;
+    }
+    
+    return 0;
+}
+
+static int try_send_frame_by_MAC(const char *MAC, uint16_t port, const char *data, uint16_t len) {
+    if (MAC == NULL || data == NULL) {
+        LOG("Invalid input: MAC or data is NULL.\n");
+        return -1;
+    }
+    char ip[16];
+    if (find_ip_from_mac(MAC, ip, sizeof(ip)) != 0) {
+        LOG("MAC: %s not found.\n", MAC);
+        return -1;
+    }
+    int ret = HAL_WiFi_Try_send_frame(ip, port, data, len);
+    if (ret < 0) {
+        LOG("send data fail.\r\n");
+        return -2;
+    }
+    return ret;
+}
+
+int HAL_WiFi_Try_send_frame_by_MAC(const char *MAC, const char *data, uint16_t len) {
+    return try_send_frame_by_MAC(MAC, 9001, data, len);
+}
+
+int HAL_WiFi_Try_send_control_by_MAC(const char *MAC, const char *data, uint16_t len) {
+    return try_send_frame_by_MAC(MAC, CONTROL_PORT, data, len);
+}
+
+int HAL_WiFi_Send_data_to_parent(const char *data, int tree_level) {
+    if (data == NULL) {
+        LOG("Invalid input: data is NULL.\n");
+        return -1;
+    }
+    return HAL_WiFi_Send_frame_to_parent(data, strlen(data), tree_level);
+}
+
+int HAL_WiFi_Send_frame_to_parent(const char *data, uint16_t len, int tree_level) {
+    if (data == NULL) {
+        LOG("Invalid input: data is NULL.\n");
+        return -1;
+    }
+
+    char ip[16];
+    snprintf(ip, sizeof(ip), "192.168.%d.1", tree_level);
+
+    if(HAL_WiFi_Send_frame(ip, 9001, data, len) != 0){
+        LOG("send data fail.\r\n");
+        return -1;
+    }
+    return 0;
+}
+
+int HAL_WiFi_Try_send_frame_to_parent(const char *data, uint16_t len, int tree_level) {
+    if (data == NULL) {
+        LOG("Invalid input: data is NULL.\n");
+        return -1;
+    }
+    char ip[16];
+    snprintf(ip, sizeof(ip), "192.168.%d.1", tree_level);
+    return HAL_WiFi_Try_send_frame(ip, 9001, data, len);
+}
+
+int HAL_WiFi_Send_control_to_parent(const char *data, uint16_t len, int tree_level) {
+    if (data == NULL) {
+        LOG("Invalid input: data is NULL.\n");
+        return -1;
+    }
+    char ip[16];
+    snprintf(ip, sizeof(ip), "192.168.%d.1", tree_level);
+    return HAL_WiFi_Send_frame(ip, CONTROL_PORT, data, len);
+}
+
+int HAL_WiFi_Try_send_control_to_parent(const char *data, uint16_t len, int tree_level) {
+    if (data == NULL) {
+        LOG("Invalid input: data is NULL.\n");
+        return -1;
+    }
+    char ip[16];
+    snprintf(ip, sizeof(ip), "192.168.%d.1", tree_level);
+    return HAL_WiFi_Try_send_frame(ip, CONTROL_PORT, data, len);
+}
+
+#if ENABLE_NETCONN_DATAGRAM || ENABLE_RAW_LINK
+// netconn和链路层的接收回调在tcpip线程中执行，不能调用套接字接口，通过原始UDP控制块向事件套接字发送唤醒包
+static void wake_event_loop_from_tcpip(void) {
+    if (g_wake_pcb == NULL) {
+        g_wake_pcb = udp_new();
+        if (g_wake_pcb == NULL) {
+            return;
+        }
+    }
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, 1, PBUF_RAM);
+    if (p == NULL) {
+        return;
+    }
+    *(char *)p->payload = 1;
+    ip_addr_t addr;
+    IP_ADDR4(&addr, 127, 0, 0, 1);
+    udp_sendto(g_wake_pcb, p, &addr, SERVER_EVENT_PORT);
+    pbuf_free(p);
+}
+#endif
+
+// 本节点发出的子网广播可能被回送给自己
+static bool is_own_ip(const char *ip) {
+    return strcmp(ip, g_ap_ip) == 0 || strcmp(ip, g_sta_ip) == 0;
+}
+
+#if ENABLE_NETCONN_DATAGRAM
+// netconn后端：数据报不经过套接字层，收到的pbuf包装成数据包缓冲区直接交给路由层
+
+static void datagram_netconn_event(struct netconn *conn, enum netconn_evt evt, u16_t len) {
+    UNUSED(conn);
+    if (evt == NETCONN_EVT_RCVPLUS && len > 0) {
+        g_udp_conn_ready = true;
+        wake_event_loop_from_tcpip();
+    }
+}
+
+static int datagram_open(uint16_t port) {
+    if (g_udp_conn != NULL) {
+        return 0;  // 已经开启
+    }
+    struct netconn *conn = netconn_new_with_callback(NETCONN_UDP, datagram_netconn_event);
+    if (conn == NULL) {
+        LOG("Failed to create UDP netconn.\n");
+        return -1;
+    }
+    ip_set_option(conn->pcb.udp, SOF_REUSEADDR | SOF_BROADCAST);  // 允许发送子网广播
+    // 绑定到任意地址，同时接收AP侧（子节点）和STA侧（父节点）发来的数据报
+    if (netconn_bind(conn, IP_ADDR_ANY, port) != ERR_OK) {
+        LOG("Failed to bind UDP netconn.\n");
+        netconn_delete(conn);
+        return -1;
+    }
+    netconn_set_nonblocking(conn, 1);
+    g_udp_conn = conn;
+    return 0;
+}
+
+static void datagram_close(void) {
+    if (g_udp_conn != NULL) {
+        netconn_delete(g_udp_conn);
+        g_udp_conn = NULL;
+        g_udp_conn_ready = false;
+    }
+}
+
+static bool datagram_opened(void) {
+    return g_udp_conn != NULL;
+}
+
+// 数据部分以PBUF_REF引用调用方的缓冲区，帧头单独分配一个小pbuf链在前面，UDP/IP头由lwIP再向前链接
+// netconn_sendto返回时数据已交给网卡驱动；ARP尚未解析需要排队时lwIP会自行拷贝PBUF_REF
+static int datagram_sendto(const char *ip, uint16_t port, const char *header, uint16_t header_len,
+                           const char *data, uint16_t len) {
+    ip_addr_t addr;
+    if (!ipaddr_aton(ip, &addr)) {
+        LOG("IP address conversion failed.\n");
+        return -1;
+    }
+    struct netbuf *nb = netbuf_new();
+    if (nb == NULL) {
+        return -1;
+    }
+    if (netbuf_ref(nb, data, len) != ERR_OK) {
+        netbuf_delete(nb);
+        return -1;
+    }
+    if (header_len > 0) {
+        struct pbuf *hdr = pbuf_alloc(PBUF_TRANSPORT, header_len, PBUF_RAM);
+        if (hdr == NULL) {
+            netbuf_delete(nb);
+            return -1;
+        }
+        memcpy(hdr->payload, header, header_len);
+        pbuf_cat(hdr, nb->p);
+        nb->p = hdr;
+        nb->ptr = hdr;
+    }
+    err_t err = netconn_sendto(g_udp_conn, nb, &addr, port);
+    netbuf_delete(nb);
+    if (err != ERR_OK) {
+        LOG("Failed to send datagram to %s.\n", ip);
+        return -1;
+    }
+    g_datagram_stats.tx_frames++;
+    g_datagram_stats.tx_zero_copy++;
+    g_datagram_stats.tx_copied_bytes += header_len;
+    return 0;
+}
+
+static bool datagram_readable(const fd_set *read_fds) {
+    UNUSED(read_fds);
+    return g_udp_conn != NULL && g_udp_conn_ready;
+}
+
+static void release_netbuf(void *arg) {
+    netbuf_delete((struct netbuf *)arg);
+}
+
+// 接收一个数据报：整个数据报在同一个pbuf中时直接包装，最后一个引用释放时归还lwIP；
+// 数据报跨多个pbuf或包装描述符用完时拷贝到内存池缓冲区，避免长时间占用网卡的接收缓冲区
+static int receive_datagram(char *mac, PacketBuf **frame) {
+    struct netbuf *nb = NULL;
+    if (netconn_recv(g_udp_conn, &nb) != ERR_OK) {
+        g_udp_conn_ready = false;  // 已经取空，下次收到数据报时回调会重新设置
+        return -1;
+    }
+    char ip[16];
+    ipaddr_ntoa_r(netbuf_fromaddr(nb), ip, sizeof(ip));
+    struct pbuf *p = nb->p;
+    if (is_own_ip(ip) || p->tot_len == 0 || p->tot_len > FRAME_MAX_LEN) {
+        netbuf_delete(nb);
+        return -1;
+    }
+    PacketBuf *buf = NULL;
+    if (p->next == NULL) {
+        buf = HAL_PacketBuf_Wrap((char *)p->payload, p->len, release_netbuf, nb);
+        if (buf != NULL) {
+            g_datagram_stats.rx_zero_copy++;
+        }
+    }
+    if (buf == NULL) {
+        buf = HAL_PacketBuf_Alloc(p->tot_len);
+        if (buf == NULL) {
+            LOG("No packet buffer for datagram of %d bytes.\n", p->tot_len);
+            netbuf_delete(nb);
+            return -1;
+        }
+        netbuf_copy(nb, buf->payload, buf->len);
+        g_datagram_stats.rx_copied_bytes += buf->len;
+        netbuf_delete(nb);
+    }
+    g_datagram_stats.rx_frames++;
+
+    // 源地址通过MAC-IP绑定表转换为MAC地址，与TCP连接相同
+    if (mac != NULL) {
+        find_mac_from_ip(ip, mac);
+    }
+    *frame = buf;
+    return buf->len;
+}
+
+#else
+// 套接字后端：接收时从pbuf拷贝到数据包缓冲区，发送时从数据包缓冲区拷贝到pbuf
+
+static int datagram_open(uint16_t port) {
+    if (g_udp_sock >= 0) {
+        return 0;  // 已经开启
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        LOG("Failed to create UDP socket.\n");
+        return -1;
+    }
+    int optval = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    setsockopt(sock, SOL_SOCKET, SO_BROADCAST, &optval, sizeof(optval));  // 允许发送子网广播
+
+    // 绑定到INADDR_ANY，同时接收AP侧（子节点）和STA侧（父节点）发来的数据报
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        LOG("Failed to bind UDP socket.\n");
+        closesocket(sock);
+        return -1;
+    }
+    g_udp_sock = sock;
+    return 0;
+}
+
+static void datagram_close(void) {
+    if (g_udp_sock >= 0) {
+        closesocket(g_udp_sock);
+        g_udp_sock = -1;
+    }
+}
+
+static bool datagram_opened(void) {
+    return g_udp_sock >= 0;
+}
+
+// 帧头和数据分开传入，避免为了加帧头而拷贝共享的数据包缓冲区
+static int datagram_sendto(const char *ip, uint16_t port, const char *header, uint16_t header_len,
+                           const char *data, uint16_t len) {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip, &addr.sin_addr) <= 0) {
+        LOG("IP address conversion failed.\n");
+        return -1;
+    }
+    struct iovec iov[2];
+    iov[0].iov_base = (void *)header;
+    iov[0].iov_len = header_len;
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = len;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    if (sendmsg(g_udp_sock, &msg, 0) != header_len + len) {
+        LOG("Failed to send datagram to %s.\n", ip);
+        return -1;
+    }
+    g_datagram_stats.tx_frames++;
+    g_datagram_stats.tx_copied_bytes += header_len + len;
+    return 0;
+}
+
+static bool datagram_readable(const fd_set *read_fds) {
+    return g_udp_sock >= 0 && FD_ISSET(g_udp_sock, read_fds);
+}
+
+// 窥探下一个数据报，读入buf并取得源地址，数据报留在套接字中
+// 返回读入的长度，-1表示出错；数据报比buf长时*truncated置1
+static int peek_datagram(PacketBuf *buf, struct sockaddr_in *src_addr, bool *truncated) {
+    struct iovec iov;
+    iov.iov_base = buf->payload;
+    iov.iov_len = buf->len;
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = src_addr;
+    msg.msg_namelen = sizeof(*src_addr);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    int ret = recvmsg(g_udp_sock, &msg, MSG_PEEK);
+    *truncated = (ret >= 0 && (msg.msg_flags & MSG_TRUNC) != 0);
+    return ret;
+}
+
+// 接收一个数据报：先按一个完整数据帧的长度从小缓冲区窥探，大多数数据报直接放得下，
+// 只丢弃套接字中的副本；更长的数据报（带广播头的满长数据帧等）再从大缓冲区接收。
+// 不用FIONREAD取长度，lwIP返回的是所有排队数据的总长度，会让普通数据报也占用大缓冲区
+static int receive_datagram(char *mac, PacketBuf **frame) {
+    struct sockaddr_in src_addr;
+    bool truncated = false;
+    int ret = -1;
+    PacketBuf *buf = HAL_PacketBuf_Alloc(PACKET_BUF_DATA_SIZE);
+    if (buf != NULL) {
+        ret = peek_datagram(buf, &src_addr, &truncated);
+        if (ret < 0) {
+            HAL_PacketBuf_Free(buf);
+            return -1;
+        }
+        if (truncated) {
+            HAL_PacketBuf_Free(buf);
+            buf = HAL_PacketBuf_Alloc(FRAME_MAX_LEN);
+        } else {
+            char drop;
+            recv(g_udp_sock, &drop, 1, 0);  // 数据报已经在buf中，读出1字节即丢弃整个数据报
+        }
+    }
+    if (buf == NULL) {
+        // 没有缓冲区时也要把数据报读出来丢弃，避免一直可读
+        char drop;
+        recv(g_udp_sock, &drop, 1, 0);
+        LOG("No packet buffer for datagram.\n");
+        return -1;
+    }
+    if (truncated) {
+        socklen_t src_addr_len = sizeof(src_addr);
+        ret = recvfrom(g_udp_sock, buf->payload, buf->len, 0, (struct sockaddr *)&src_addr, &src_addr_len);
+    }
+    if (ret <= 0) {
+        HAL_PacketBuf_Free(buf);
+        return -1;
+    }
+    buf->len = ret;
+    buf->payload[ret] = '\0';
+
+    char ip[16];
+    inet_ntop(AF_INET, &src_addr.sin_addr, ip, INET_ADDRSTRLEN);
+    if (is_own_ip(ip)) {
+        HAL_PacketBuf_Free(buf);
+        return -1;
+    }
+    g_datagram_stats.rx_frames++;
+    g_datagram_stats.rx_copied_bytes += ret;
+
+    // 源地址通过MAC-IP绑定表转换为MAC地址，与TCP连接相同
+    if (mac != NULL) {
+        find_mac_from_ip(ip, mac);
+    }
+    *frame = buf;
+    return ret;
+}
+#endif
+
+int HAL_WiFi_Datagram_Open(uint16_t port) {
+    return datagram_open(port);
+}
+
+void HAL_WiFi_Datagram_Close(void) {
+    datagram_close();
+}
+
+int HAL_WiFi_Send_datagram(const char *ip, uint16_t port, const char *data, uint16_t len) {
+    if (ip == NULL || data == NULL || len == 0 || len > FRAME_MAX_LEN) {
+        LOG("Invalid input: ip, data or len is invalid.\n");
+        return -1;
+    }
+    if (!datagram_opened()) {
+        LOG("Datagram socket not opened.\n");
+        return -1;
+    }
+    // 数据报自带边界，不需要长度前缀
+    return datagram_sendto(ip, port, NULL, 0, data, len);
+}
+
+int HAL_WiFi_Send_subnet_broadcast(const char *header, uint16_t header_len, const char *data, uint16_t len, int ap_level) {
+    if (data == NULL || (header == NULL && header_len != 0) || header_len + len > FRAME_MAX_LEN) {
+        LOG("Invalid input: header, data or len is invalid.\n");
+        return -1;
+    }
+    if (!datagram_opened()) {
+        LOG("Datagram socket not opened.\n");
+        return -1;
+    }
+    // 子节点都在 192.168.<ap_level>.0/24 子网中，发送一次即可到达所有子节点
+    char ip[16];
+    snprintf(ip, sizeof(ip), "192.168.%d.255", ap_level);
+    return datagram_sendto(ip, 9001, header, header_len, data, len);
+}
+
+uint32_t HAL_WiFi_GetFrameNoBufferCount(void) {
+    return g_frame_no_buffer;
+}
+
+void HAL_WiFi_GetDatagramStats(WiFiDatagramStats *stats) {
+    if (stats != NULL) {
+        memcpy(stats, &g_datagram_stats, sizeof(WiFiDatagramStats));
+    }
+}
+
+void HAL_WiFi_ResetDatagramStats(void) {
+    memset(&g_datagram_stats, 0, sizeof(WiFiDatagramStats));
+}
+
+int HAL_WiFi_Send_datagram_by_MAC(const char *MAC, const char *data, uint16_t len) {
+    if (MAC == NULL || data == NULL) {
+        LOG("Invalid input: MAC or data is NULL.\n");
+        return -1;
+    }
+    char ip[16];
+    if (find_ip_from_mac(MAC, ip, sizeof(ip)) != 0) {
+        LOG("MAC: %s not found.\n", MAC);
+        return -1;
+    }
+    return HAL_WiFi_Send_datagram(ip, 9001, data, len);
+}
+
+int HAL_WiFi_Send_datagram_to_parent(const char *data, uint16_t len, int tree_level) {
+    char ip[16];
+    snprintf(ip, sizeof(ip), "192.168.%d.1", tree_level);
+    return HAL_WiFi_Send_datagram(ip, 9001, data, len);
+}
+
+#if ENABLE_RAW_LINK
+static void release_pbuf(void *arg) {
+    pbuf_free((struct pbuf *)arg);
+}
+
+// 帧头和数据帧拷贝到同一个PBUF_RAM中，持有tcpip内核锁交给网卡驱动；
+// 驱动可能对pbuf加引用排队发送，而调用方的缓冲区在返回后即被释放，所以不能以PBUF_REF引用
+static int raw_link_output(const char *ifname, const uint8_t *dst_eth, const char *data, uint16_t len) {
+    if (!g_raw_link_open || data == NULL || len == 0 || len > RAW_LINK_MAX_FRAME_LEN) {
+        return -1;
+    }
+    struct netif *netif = netif_find(ifname);
+    if (netif == NULL) {
+        LOG("Interface %s not found.\n", ifname);
+        return -1;
+    }
+    struct pbuf *hdr = pbuf_alloc(PBUF_RAW, RAW_LINK_HEADER_SIZE + len, PBUF_RAM);
+    if (hdr == NULL) {
+        return -1;
+    }
+    raw_link_encode_header((uint8_t *)hdr->payload, dst_eth, netif->hwaddr, g_raw_node_mac, len);
+    memcpy((uint8_t *)hdr->payload + RAW_LINK_HEADER_SIZE, data, len);
+    LOCK_TCPIP_CORE();
+    int err = netif->linkoutput(netif, hdr);
+    UNLOCK_TCPIP_CORE();
+    pbuf_free(hdr);
+    if (err != ERR_OK) {
+        LOG("Failed to send raw link frame on %s.\n", ifname);
+        return -1;
+    }
+    return 0;
+}
+
+static bool raw_link_pending(void) {
+    return g_raw_rx_queue != NULL && osMessageQueueGetCount(g_raw_rx_queue) > 0;
+}
+
+// 取出一个链路层帧，上一跳的节点MAC直接来自帧头，不需要查绑定表
+static int receive_raw_link(char *mac, PacketBuf **frame) {
+    RawLinkRxItem item;
+    if (osMessageQueueGet(g_raw_rx_queue, &item, NULL, 0) != osOK) {
+        return -1;
+    }
+    // 子节点的以太网地址可能变化（重新关联后），以收到的帧为准
+    binding_lock();
+    MAC_IP_Node *node = find_binding(item.info.node_mac);
+    if (node != NULL) {
+        memcpy(node->binding.eth, item.info.src_eth, WIFI_BSSID_LEN);
+        node->binding.has_eth = true;
+    }
+    binding_unlock();
+    if (mac != NULL) {
+        strncpy(mac, item.info.node_mac, RAW_LINK_NODE_MAC_SIZE);
+        mac[RAW_LINK_NODE_MAC_SIZE] = '\0';
+    }
+    *frame = item.buf;
+    return item.buf->len;
+}
+
+int HAL_WiFi_RawLink_Open(void) {
+    if (g_raw_link_open) {
+        return 0;
+    }
+    if (g_raw_rx_queue == NULL) {
+        g_raw_rx_queue = osMessageQueueNew(RAW_LINK_RX_QUEUE_SIZE, sizeof(RawLinkRxItem), NULL);
+        if (g_raw_rx_queue == NULL) {
+            LOG("Failed to create raw link queue.\n");
+            return -1;
+        }
+    }
+    if (HAL_WiFi_GetNodeMAC(g_raw_node_mac) != 0) {
+        return -1;
+    }
+    g_raw_link_open = true;
+    return 0;
+}
+
+void HAL_WiFi_RawLink_Close(void) {
+    g_raw_link_open = false;
+    RawLinkRxItem item;
+    while (g_raw_rx_queue != NULL && osMessageQueueGet(g_raw_rx_queue, &item, NULL, 0) == osOK) {
+        HAL_PacketBuf_Free(item.buf);
+    }
+}
+
+int HAL_WiFi_RawLink_Send_by_MAC(const char *MAC, const char *data, uint16_t len) {
+    if (MAC == NULL) {
+        return -1;
+    }
+    uint8_t eth[WIFI_BSSID_LEN];
+    binding_lock();
+    MAC_IP_Node *node = find_binding(MAC);
+    bool has_eth = (node != NULL && node->binding.has_eth);
+    if (has_eth) {
+        memcpy(eth, node->binding.eth, WIFI_BSSID_LEN);
+    }
+    binding_unlock();
+    if (!has_eth) {
+        LOG("Ethernet address of %s unknown.\n", MAC);
+        return -1;
+    }
+    return raw_link_output(RAW_LINK_AP_IFNAME, eth, data, len);
+}
+
+int HAL_WiFi_RawLink_Send_to_parent(const char *data, uint16_t len) {
+    if (!g_parent_bssid_valid) {
+        return -1;
+    }
+    return raw_link_output(RAW_LINK_STA_IFNAME, g_parent_bssid, data, len);
+}
+
+int HAL_WiFi_RawLink_Input(struct pbuf *p, struct netif *netif) {
+    UNUSED(netif);
+    RawLinkInfo info;
+    if (p == NULL || p->len < RAW_LINK_HEADER_SIZE ||
+        raw_link_decode_header((const uint8_t *)p->payload, p->tot_len, &info) != 0) {
+        return -1;  // 不是本协议的帧，交还lwIP
+    }
+    if (!g_raw_link_open || g_raw_rx_queue == NULL) {
+        pbuf_free(p);
+        return 0;
+    }
+    // 数据帧在同一个pbuf中时直接包装，不拷贝；否则拷贝到内存池缓冲区
+    PacketBuf *buf = NULL;
+    if (p->next == NULL) {
+        buf = HAL_PacketBuf_Wrap((char *)p->payload + RAW_LINK_HEADER_SIZE, info.len, release_pbuf, p);
+    }
+    if (buf == NULL) {
+        buf = HAL_PacketBuf_Alloc(info.len);
+        if (buf != NULL) {
+            pbuf_copy_partial(p, buf->payload, info.len, RAW_LINK_HEADER_SIZE);
+        }
+        pbuf_free(p);
+        if (buf == NULL) {
+            return 0;
+        }
+    }
+    RawLinkRxItem item;
+    item.buf = buf;
+    memcpy(&item.info, &info, sizeof(RawLinkInfo));
+    if (osMessageQueuePut(g_raw_rx_queue, &item, 0, 0) != osOK) {
+        LOG("Raw link queue full, dropping.\n");
+        HAL_PacketBuf_Free(buf);
+        return 0;
+    }
+    wake_event_loop_from_tcpip();
+    return 0;
+}
+
+#else
+static bool raw_link_pending(void) {
+    return false;
+}
+
+static int receive_raw_link(char *mac, PacketBuf **frame) {
+    UNUSED(mac);
+    UNUSED(frame);
+    return -1;
+}
+
+int HAL_WiFi_RawLink_Open(void) {
+    LOG("Raw link transport not enabled.\n");
+    return -1;
+}
+
+void HAL_WiFi_RawLink_Close(void) {
+}
+
+int HAL_WiFi_RawLink_Send_by_MAC(const char *MAC, const char *data, uint16_t len) {
+    UNUSED(MAC);
+    UNUSED(data);
+    UNUSED(len);
+    return -1;
+}
+
+int HAL_WiFi_RawLink_Send_to_parent(const char *data, uint16_t len) {
+    UNUSED(data);
+    UNUSED(len);
+    return -1;
+}
+
+int HAL_WiFi_RawLink_Input(struct pbuf *p, struct netif *netif) {
+    UNUSED(p);
+    UNUSED(netif);
+    return -1;
+}
+#endif
+
+// 创建事件套接字，其他线程向它发送一个字节即可唤醒事件循环
+static void open_event_socket(void) {
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        LOG("Failed to create event socket.\n");
+        return;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_EVENT_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        LOG("Failed to bind event socket.\n");
+        closesocket(sock);
+        return;
+    }
+    g_event_sock = sock;
+}
+
+int HAL_WiFi_Create_Server(uint16_t port) {
+    int listen_sock = open_listen_socket(port);
+    if (listen_sock < 0) {
+        return -1;
+    }
+    g_control_server_fd = open_listen_socket(CONTROL_PORT);
+    if (g_control_server_fd < 0) {
+        closesocket(listen_sock);
+        return -1;
+    }
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        g_server_clients[i].sock = -1;
+        HAL_WiFi_FrameReader_Init(&g_server_clients[i].reader);
+    }
+    if (g_event_sock < 0) {
+        open_event_socket();
+    }
+    return listen_sock;
+}
+
+void HAL_WiFi_Server_Wakeup(void) {
+    if (g_event_sock < 0) {
+        return;
+    }
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        return;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_EVENT_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    char event = 1;
+    sendto(sock, &event, 1, 0, (struct sockaddr *)&addr, sizeof(addr));
+    closesocket(sock);
+}
+
+static void close_server_client(ServerClient *client) {
+    if (client->sock >= 0) {
+        closesocket(client->sock);
+    }
+    client->sock = -1;
+    client->rx_stalled = false;
+    HAL_WiFi_FrameReader_Reset(&client->reader);
+}
+
+// 接受新的连接，连接数已满时关闭新连接
+static void accept_server_client(int server_fd, bool control) {
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len = sizeof(client_addr);
+    int client_sock = accept(server_fd, (struct sockaddr *)&client_addr, &client_addr_len);
+    if (client_sock < 0) {
+        return;
+    }
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        ServerClient *client = &g_server_clients[i];
+        if (client->sock < 0) {
+            // 非阻塞接收，对端只发送了部分数据帧时保留在分帧状态中，不阻塞其他连接
+            set_nonblocking(client_sock, 1);
+            client->sock = client_sock;
+            client->control = control;
+            client->rx_stalled = false;
+            inet_ntop(AF_INET, &client_addr.sin_addr, client->ip, INET_ADDRSTRLEN);
+            HAL_WiFi_FrameReader_Init(&client->reader);
+            LOG("Accepted connection from %s\n", client->ip);
+            return;
+        }
+    }
+    LOG("Too many connections, closing new connection.\n");
+    closesocket(client_sock);
+}
+
+static void watch_fd(fd_set *fds, int fd, int *max_fd) {
+    if (fd < 0) {
+        return;
+    }
+    FD_SET(fd, fds);
+    if (fd > *max_fd) {
+        *max_fd = fd;
+    }
+}
+
+// 邻居长连接可读时确认对端是否已经关闭，关闭后下次发送会重新连接
+static void close_dead_neighbor_conn(int sock) {
+    if (g_conn_mutex == NULL) {
+        return;
+    }
+    osMutexAcquire(g_conn_mutex, osWaitForever);
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        NeighborConn *conn = &g_conn_pool[i];
+        if (conn->sock == sock && !conn->connecting && !neighbor_conn_alive(sock)) {
+            LOG("Connection to %s closed by peer.\n", conn->ip);
+            drop_neighbor_conn(conn);
+        }
+    }
+    osMutexRelease(g_conn_mutex);
+}
+
+// 轮流读取一个平面中可读的连接，最多返回一个完整的数据帧，其余连接在下次调用时处理
+static int read_ready_client(fd_set *read_fds, bool control, char *mac, PacketBuf **frame) {
+    int *next_client = &g_server_next_client[control ? 1 : 0];
+    for (int n = 0; n < SERVER_MAX_CLIENTS; n++) {
+        int i = (*next_client + n) % SERVER_MAX_CLIENTS;
+        ServerClient *client = &g_server_clients[i];
+        if (client->sock < 0 || client->control != control ||
+            (!client->rx_stalled && !FD_ISSET(client->sock, read_fds))) {
+            continue;
+        }
+        // 每次可读只接收一次，数据帧没有收完时留在分帧状态中，下次可读时继续
+        int ret = HAL_WiFi_FrameReader_Feed(&client->reader, client->sock, frame);
+        if (ret == FRAME_READ_NO_BUFFER) {
+            // 不断开连接，对端已经写入的数据帧（包括路由包）留在socket中，缓冲区释放后继续读取
+            if (!client->rx_stalled) {
+                LOG("No packet buffer for frame from %s, pausing.\n", client->ip);
+                g_frame_no_buffer++;
+                client->rx_stalled = true;
+            }
+            continue;
+        }
+        client->rx_stalled = false;
+        if (ret < 0) {
+            LOG("Connection from %s closed.\n", client->ip);
+            close_server_client(client);
+            continue;
+        }
+        if (ret == 0) {
+            continue;
+        }
+        *next_client = (i + 1) % SERVER_MAX_CLIENTS;
+        // 查找 IP 对应的 MAC 地址
+        if (mac != NULL) {
+            find_mac_from_ip(client->ip, mac);
+        }
+        return (*frame)->len;
+    }
+    return -1;
+}
+
+int HAL_WiFi_Server_ReceiveFrame(int server_fd, char *mac, PacketBuf **frame) {
+    if (server_fd < 0 || frame == NULL) {
+        LOG("Invalid input: server_fd or frame is invalid.\n");
+        return -1;
+    }
+
+    // 同时等待新连接、已有长连接上的数据、数据报、绑定心跳和其他线程的唤醒事件
+    update_binding_server();
+    fd_set read_fds;
+    FD_ZERO(&read_fds);
+    int max_fd = -1;
+    watch_fd(&read_fds, server_fd, &max_fd);
+    watch_fd(&read_fds, g_control_server_fd, &max_fd);
+#if !ENABLE_NETCONN_DATAGRAM
+    watch_fd(&read_fds, g_udp_sock, &max_fd);
+#endif
+    watch_fd(&read_fds, g_event_sock, &max_fd);
+    watch_fd(&read_fds, g_binding_sock, &max_fd);
+    // 因内存池耗尽暂停的连接不放入select，否则一直可读；改为每隔SERVER_NO_BUFFER_RETRY_MS重试
+    bool rx_stalled = false;
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        if (g_server_clients[i].rx_stalled) {
+            rx_stalled = true;
+        } else {
+            watch_fd(&read_fds, g_server_clients[i].sock, &max_fd);
+        }
+    }
+    // 发往邻居的长连接只发送不接收，可读说明对端已经关闭，及时关闭而不是等到下次发送才发现
+    // 这里只读取套接字编号，处理时再持锁确认
+    // 有帧尾没有写完的连接同时等待可写
+    int neighbor_socks[CONN_POOL_SIZE];
+    fd_set write_fds;
+    FD_ZERO(&write_fds);
+    bool tail_pending = false;
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        neighbor_socks[i] = g_conn_pool[i].connecting ? -1 : g_conn_pool[i].sock;
+        watch_fd(&read_fds, neighbor_socks[i], &max_fd);
+        if (neighbor_socks[i] >= 0 && g_conn_pool[i].pending != NULL) {
+            FD_SET(neighbor_socks[i], &write_fds);
+            tail_pending = true;
+        }
+    }
+
+    // 最多等到下一次检查绑定表的时间，收到数据或事件时立即返回
+    uint32_t wait_ms = SERVER_POLL_TIMEOUT_MS;
+    if (g_binding_sock >= 0) {
+        uint32_t elapsed_ms = (osKernelGetTickCount() - g_binding_check_tick) * 1000 / osKernelGetTickFreq();
+        wait_ms = elapsed_ms >= BINDING_CHECK_INTERVAL_MS ? 0 : BINDING_CHECK_INTERVAL_MS - elapsed_ms;
+    }
+#if ENABLE_NETCONN_DATAGRAM
+    // netconn后端的数据报不在select中，还有未取出的数据报时不等待
+    if (g_udp_conn_ready) {
+        wait_ms = 0;
+    }
+#endif
+    if (raw_link_pending()) {
+        wait_ms = 0;
+    }
+    if (rx_stalled && wait_ms > SERVER_NO_BUFFER_RETRY_MS) {
+        wait_ms = SERVER_NO_BUFFER_RETRY_MS;
+    }
+    // 帧尾一直写不出去时也要按时醒来判断对端是否失联
+    if (tail_pending && wait_ms > CONN_WAIT_SLICE_MS) {
+        wait_ms = CONN_WAIT_SLICE_MS;
+    }
+    struct timeval timeout;
+    timeout.tv_sec = wait_ms / 1000;
+    timeout.tv_usec = (wait_ms % 1000) * 1000;
+    int ready = select(max_fd + 1, &read_fds, tail_pending ? &write_fds : NULL, NULL, &timeout);
+    if (tail_pending) {
+        flush_neighbor_conns();
+    }
+    if (g_binding_sock >= 0 &&
+        (osKernelGetTickCount() - g_binding_check_tick) * 1000 / osKernelGetTickFreq() >= BINDING_CHECK_INTERVAL_MS) {
+        g_binding_check_tick = osKernelGetTickCount();
+        check_binding_table();
+    }
+    if (ready < 0 || (ready == 0 && !datagram_readable(&read_fds) && !raw_link_pending() && !rx_stalled)) {
+        return -1;
+    }
+    if (g_event_sock >= 0 && FD_ISSET(g_event_sock, &read_fds)) {
+        // 唤醒事件只用来打断select，读出丢弃即可
+        char events[8];
+        while (recv(g_event_sock, events, sizeof(events), MSG_DONTWAIT) > 0) {
+        }
+    }
+    if (g_binding_sock >= 0 && FD_ISSET(g_binding_sock, &read_fds)) {
+        accept_binding_client();
+    }
+    for (int i = 0; i < CONN_POOL_SIZE; i++) {
+        if (neighbor_socks[i] >= 0 && FD_ISSET(neighbor_socks[i], &read_fds)) {
+            close_dead_neighbor_conn(neighbor_socks[i]);
+        }
+    }
+    if (g_control_server_fd >= 0 && FD_ISSET(g_control_server_fd, &read_fds)) {
+        accept_server_client(g_control_server_fd, true);
+    }
+    if (FD_ISSET(server_fd, &read_fds)) {
+        accept_server_client(server_fd, false);
+    }
+    // 控制面严格优先：有路由包等待时先返回路由包，数据面的连接和数据报留到下次调用
+    if (read_ready_client(&read_fds, true, mac, frame) > 0) {
+        return (*frame)->len;
+    }
+    if (datagram_readable(&read_fds) && receive_datagram(mac, frame) > 0) {
+        return (*frame)->len;
+    }
+    if (raw_link_pending() && receive_raw_link(mac, frame) > 0) {
+        return (*frame)->len;
+    }
+    if (read_ready_client(&read_fds, false, mac, frame) > 0) {
+        return (*frame)->len;
+    }
+    return -1;
+}
+
+int HAL_WiFi_Server_Receive(int server_fd, char *mac, char *buffer, int buffer_len) {
+    if (server_fd < 0 || buffer == NULL || buffer_len <= 0) {
+        LOG("Invalid input: server_fd, buffer or buffer_len is invalid.\n");
+        return -1;
+    }
+
+    PacketBuf *frame = NULL;
+    int ret = HAL_WiFi_Server_ReceiveFrame(server_fd, mac, &frame);
+    if (ret < 0) {
+        return -1;
+    }
+    if (ret > buffer_len - 1) {
+        LOG("Buffer too small for frame of %d bytes.\n", ret);
+        ret = buffer_len - 1;
+    }
+    memcpy(buffer, frame->payload, ret);
+    buffer[ret] = '\0';  // 确保字符串以 NULL 结尾
+    HAL_PacketBuf_Free(frame);
+    return ret;
+}
+
+int HAL_WiFi_Close_Server(int server_fd) {
+    if (server_fd < 0) {
+        LOG("Invalid input: server_fd is invalid.\n");
+        return -1;
+    }
+
+    // 关闭所有客户端长连接和监听套接字
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) {
+        close_server_client(&g_server_clients[i]);
+    }
+    if (g_control_server_fd >= 0) {
+        closesocket(g_control_server_fd);
+        g_control_server_fd = -1;
+    }
     closesocket(server_fd);
     return 0;
 }
\ No newline at end of file
@@ -477,6 +477,342 @@ int HAL_Wireless_SendData_to_parent(WirelessType type, const char *data, int tre
     return ret;
 }
 
+int HAL_Wireless_SendFrame_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Send_frame_by_MAC(MAC, data, len);
+            if(ret != 0) {
+                LOG("Failed to send frame to %s.\n", MAC);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendFrame(MAC, data, len);
+            LOG("Bluetooth frame send not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendFrame(MAC, data, len);
+            LOG("nearlink frame send not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_SendFrame_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Send_frame_to_parent(data, len, tree_level);
+            if(ret != 0) {
+                LOG("Failed to send frame to parent node at level %d.\n", tree_level);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendFrame_to_parent(data, len, tree_level);
+            LOG("Bluetooth frame send to parent not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendFrame_to_parent(data, len, tree_level);
+            LOG("nearlink frame send to parent not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_TrySendFrame_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Try_send_frame_by_MAC(MAC, data, len);
+            if(ret < 0) {
+                LOG("Failed to send frame to %s.\n", MAC);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_TrySendFrame(MAC, data, len);
+            LOG("Bluetooth frame send not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_TrySendFrame(MAC, data, len);
+            LOG("nearlink frame send not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_TrySendFrame_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Try_send_frame_to_parent(data, len, tree_level);
+            if(ret < 0) {
+                LOG("Failed to send frame to parent node at level %d.\n", tree_level);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_TrySendFrame_to_parent(data, len, tree_level);
+            LOG("Bluetooth frame send to parent not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_TrySendFrame_to_parent(data, len, tree_level);
+            LOG("nearlink frame send to parent not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_SendControl_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Send_control_to_parent(data, len, tree_level);
+            if(ret < 0) {
+                LOG("Failed to send control frame to parent node at level %d.\n", tree_level);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendControl_to_parent(data, len, tree_level);
+            LOG("Bluetooth control frame send not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendControl_to_parent(data, len, tree_level);
+            LOG("nearlink control frame send not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_TrySendControl_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Try_send_control_by_MAC(MAC, data, len);
+            if(ret < 0) {
+                LOG("Failed to send control frame to %s.\n", MAC);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_TrySendControl(MAC, data, len);
+            LOG("Bluetooth control frame send not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_TrySendControl(MAC, data, len);
+            LOG("nearlink control frame send not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_TrySendControl_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Try_send_control_to_parent(data, len, tree_level);
+            if(ret < 0) {
+                LOG("Failed to send control frame to parent node at level %d.\n", tree_level);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_TrySendControl_to_parent(data, len, tree_level);
+            LOG("Bluetooth control frame send not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_TrySendControl_to_parent(data, len, tree_level);
+            LOG("nearlink control frame send not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_OpenDatagram(WirelessType type) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Datagram_Open(9001);
+            if(ret != 0) {
+                LOG("Failed to open Wi-Fi datagram socket.\n");
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_OpenDatagram();
+            LOG("Bluetooth datagram not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_OpenDatagram();
+            LOG("nearlink datagram not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_SendDatagram_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Send_datagram_by_MAC(MAC, data, len);
+            if(ret != 0) {
+                LOG("Failed to send datagram to %s.\n", MAC);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendDatagram(MAC, data, len);
+            LOG("Bluetooth datagram send not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendDatagram(MAC, data, len);
+            LOG("nearlink datagram send not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_SendDatagram_to_parent(WirelessType type, const char *data, uint16_t len, int tree_level) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Send_datagram_to_parent(data, len, tree_level);
+            if(ret != 0) {
+                LOG("Failed to send datagram to parent node at level %d.\n", tree_level);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendDatagram_to_parent(data, len, tree_level);
+            LOG("Bluetooth datagram send to parent not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendDatagram_to_parent(data, len, tree_level);
+            LOG("nearlink datagram send to parent not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_OpenRawLink(WirelessType type) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_RawLink_Open();
+            if(ret != 0) {
+                LOG("Failed to open Wi-Fi raw link.\n");
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_OpenRawLink();
+            LOG("Bluetooth raw link not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_OpenRawLink();
+            LOG("nearlink raw link not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_SendRaw_to_child(WirelessType type, const char *MAC, const char *data, uint16_t len) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_RawLink_Send_by_MAC(MAC, data, len);
+            if(ret != 0) {
+                LOG("Failed to send raw link frame to %s.\n", MAC);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendRaw(MAC, data, len);
+            LOG("Bluetooth raw link send not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendRaw(MAC, data, len);
+            LOG("nearlink raw link send not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_SendRaw_to_parent(WirelessType type, const char *data, uint16_t len) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_RawLink_Send_to_parent(data, len);
+            if(ret != 0) {
+                LOG("Failed to send raw link frame to parent node.\n");
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendRaw_to_parent(data, len);
+            LOG("Bluetooth raw link send to parent not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendRaw_to_parent(data, len);
+            LOG("nearlink raw link send to parent not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+int HAL_Wireless_SendSubnetBroadcast(WirelessType type, const char *header, uint16_t header_len, const char *data, uint16_t len, int ap_level) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Send_subnet_broadcast(header, header_len, data, len, ap_level);
+            if(ret != 0) {
+                LOG("Failed to send subnet broadcast at level %d.\n", ap_level);
+            }
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_SendBroadcast(header, header_len, data, len);
+            LOG("Bluetooth subnet broadcast not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_SendBroadcast(header, header_len, data, len);
+            LOG("nearlink subnet broadcast not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
 /**
  * @brief 创建无线接收服务器
  * @param type 指定无线通信类型。
@@ -573,6 +909,46 @@ int HAL_Wireless_ReceiveDataFromClient(WirelessType type, int server_fd, char *m
     return ret;
 }
 
+int HAL_Wireless_ReceiveFrameFromClient(WirelessType type, int server_fd, char *mac, PacketBuf **frame) {
+    int ret = -1;
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            ret = HAL_WiFi_Server_ReceiveFrame(server_fd, mac, frame);
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // ret = HAL_Bluetooth_ReceiveFrameFromClient(server_fd, mac, frame);
+            LOG("Bluetooth frame receive from client not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // ret = HAL_nearlink_ReceiveFrameFromClient(server_fd, mac, frame);
+            LOG("nearlink frame receive from client not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            return -1;
+    }
+    return ret;
+}
+
+void HAL_Wireless_WakeupServer(WirelessType type) {
+    switch (type) {
+        case WIRELESS_TYPE_WIFI:
+            HAL_WiFi_Server_Wakeup();
+            break;
+        case WIRELESS_TYPE_BLUETOOTH:
+            // HAL_Bluetooth_WakeupServer();
+            LOG("Bluetooth server wakeup not implemented.\n");
+            break;
+        case WIRELESS_TYPE_NEARLINK:
+            // HAL_nearlink_WakeupServer();
+            LOG("nearlink server wakeup not implemented.\n");
+            break;
+        default:
+            LOG("Unknown wireless type!\n");
+            break;
+    }
+}
+
 /** 
  * @brief 获取所有子节点的MAC地址
  * @param[out] mac_list 存储MAC地址的指针数组
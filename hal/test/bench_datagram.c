@@ -0,0 +1,175 @@
+/*
+ * 数据报后端基准测试：在同一块板子上通过回环地址收发相同的数据报流量，
+ * 统计每帧的接收/发送耗时、拷贝字节数和内存池占用，用于比较套接字后端与netconn零拷贝后端。
+ * 分别以 ENABLE_NETCONN_DATAGRAM 为 0 和 1 编译固件各运行一次，对比两次的输出。
+ */
+#include "hal_wifi.h"
+#include "hal_packet_buf.h"
+#include <stdio.h>
+#include <string.h>
+#include "cmsis_os2.h"
+#include "app_init.h"
+
+#define BENCH_PORT          9001
+#define BENCH_FRAMES        2000    // 每次测试发送的数据报数量
+#define BENCH_FRAME_LEN     513     // 与完整数据帧长度一致
+#define BENCH_BURST         4       // 每批发送的数据报数量，接收方收完一批再发下一批，避免回环接口队列溢出
+#define BENCH_HOLD          4       // 接收方同时持有的数据帧数量，模拟应用层队列
+
+#define BENCH_SENT_BIT      (1 << 0)
+#define BENCH_RECEIVED_BIT  (1 << 1)
+
+#define BENCH_TASK_STACK_SIZE 0x1000
+#define BENCH_TASK_PRIO       (osPriority_t)(13)
+
+static osEventFlagsId_t g_bench_flags = NULL;
+static volatile uint64_t g_tx_cycles = 0;
+static volatile uint32_t g_tx_sent = 0;
+
+static uint64_t cycles_to_us(uint64_t cycles) {
+    return cycles * 1000000 / osKernelGetSysTimerFreq();
+}
+
+// 发送线程：与固件一样从内存池缓冲区发送，每发送一批等接收方收完
+static void bench_sender_task(void *param) {
+    (void)param;
+    PacketBuf *buf = HAL_PacketBuf_Alloc(BENCH_FRAME_LEN);
+    if (buf == NULL) {
+        printf("No packet buffer for sender.\n");
+        return;
+    }
+    for (int i = 0; i < BENCH_FRAME_LEN; i++) {
+        buf->payload[i] = (char)('a' + i % 26);
+    }
+    buf->payload[0] = '1';
+    for (int n = 0; n < BENCH_FRAMES; n++) {
+        uint32_t start = osKernelGetSysTimerCount();
+        if (HAL_WiFi_Send_datagram("127.0.0.1", BENCH_PORT, buf->payload, buf->len) == 0) {
+            g_tx_sent++;
+        }
+        g_tx_cycles += osKernelGetSysTimerCount() - start;
+        if ((n + 1) % BENCH_BURST == 0) {
+            osEventFlagsSet(g_bench_flags, BENCH_SENT_BIT);
+            osEventFlagsWait(g_bench_flags, BENCH_RECEIVED_BIT, osFlagsWaitAny, osWaitForever);
+        }
+    }
+    HAL_PacketBuf_Free(buf);
+}
+
+static void start_sender(void) {
+    osThreadAttr_t attr;
+    attr.name       = "bench_sender_task";
+    attr.attr_bits  = 0U;
+    attr.cb_mem     = NULL;
+    attr.cb_size    = 0U;
+    attr.stack_mem  = NULL;
+    attr.stack_size = BENCH_TASK_STACK_SIZE;
+    attr.priority   = BENCH_TASK_PRIO;
+    if (osThreadNew((osThreadFunc_t)bench_sender_task, NULL, &attr) == NULL) {
+        printf("Create bench_sender_task failed.\n");
+    }
+}
+
+// 接收并处理一帧，丢包时select等到超时，这一次不计入耗时
+static void receive_one(int server_fd, PacketBuf **held, uint32_t *received, uint64_t *rx_cycles) {
+    PacketBuf *frame = NULL;
+    uint32_t start = osKernelGetSysTimerCount();
+    if (HAL_WiFi_Server_ReceiveFrame(server_fd, NULL, &frame) <= 0) {
+        return;
+    }
+    // 读一遍数据，相当于路由层解析帧头、应用层拷贝数据
+    uint32_t sum = 0;
+    for (int i = 0; i < frame->len; i++) {
+        sum += (uint8_t)frame->payload[i];
+    }
+    (void)sum;
+    // 保留最近的几帧，模拟应用层队列中等待读取的数据包
+    int slot = *received % BENCH_HOLD;
+    HAL_PacketBuf_Free(held[slot]);
+    held[slot] = frame;
+    *rx_cycles += osKernelGetSysTimerCount() - start;
+    (*received)++;
+}
+
+static void print_pool(const char *name, PacketBufPoolType pool, uint32_t bytes_per_buf) {
+    PacketBufStats stats;
+    HAL_PacketBuf_GetStats(pool, &stats);
+    printf("  pool %-6s high water %2u x %4u bytes, alloc failed %u\n",
+           name, stats.high_water, bytes_per_buf, stats.alloc_failed);
+}
+
+void bench_datagram_task(void *param) {
+    (void)param;
+    if (HAL_WiFi_Init() != 0 || HAL_PacketBuf_Init() != 0) {
+        printf("Init failed.\n");
+        return;
+    }
+    int server_fd = HAL_WiFi_Create_Server(BENCH_PORT);
+    if (server_fd < 0 || HAL_WiFi_Datagram_Open(BENCH_PORT) != 0) {
+        printf("Failed to open server or datagram.\n");
+        return;
+    }
+    g_bench_flags = osEventFlagsNew(NULL);
+    if (g_bench_flags == NULL) {
+        return;
+    }
+    HAL_WiFi_ResetDatagramStats();
+    start_sender();
+
+    // 一批数据报都到达后再开始计时，只统计接收处理本身的耗时，不包括等待数据报的时间
+    PacketBuf *held[BENCH_HOLD] = {NULL};
+    uint32_t received = 0;
+    uint64_t rx_cycles = 0;
+    for (int batch = 0; batch < BENCH_FRAMES / BENCH_BURST; batch++) {
+        osEventFlagsWait(g_bench_flags, BENCH_SENT_BIT, osFlagsWaitAny, osWaitForever);
+        osDelay(1);  // 等回环接口把这一批数据报交给协议栈
+        for (int n = 0; n < BENCH_BURST; n++) {
+            receive_one(server_fd, held, &received, &rx_cycles);
+        }
+        osEventFlagsSet(g_bench_flags, BENCH_RECEIVED_BIT);
+    }
+    for (int i = 0; i < BENCH_HOLD; i++) {
+        HAL_PacketBuf_Free(held[i]);
+    }
+
+    WiFiDatagramStats stats;
+    HAL_WiFi_GetDatagramStats(&stats);
+    printf("datagram backend: %s\n", ENABLE_NETCONN_DATAGRAM ? "netconn (zero copy)" : "socket");
+    printf("  frames sent %u, received %u, lost %u\n", g_tx_sent, received, g_tx_sent - received);
+    if (received > 0 && g_tx_sent > 0) {
+        printf("  rx %u us/frame, tx %u us/frame\n",
+               (uint32_t)(cycles_to_us(rx_cycles) / received), (uint32_t)(cycles_to_us(g_tx_cycles) / g_tx_sent));
+        printf("  rx zero copy %u/%u, copied %u bytes/frame\n",
+               stats.rx_zero_copy, stats.rx_frames, stats.rx_copied_bytes / received);
+        printf("  tx zero copy %u/%u, copied %u bytes/frame\n",
+               stats.tx_zero_copy, stats.tx_frames, stats.tx_copied_bytes / g_tx_sent);
+    }
+    // 每个持有的数据帧占用的内存：内存池缓冲区，或者只有描述符（数据留在lwIP的pbuf中）
+    print_pool("small", PACKET_BUF_POOL_SMALL, sizeof(PacketBuf) + PACKET_BUF_HEADROOM + PACKET_BUF_DATA_SIZE + 1);
+    print_pool("ref", PACKET_BUF_POOL_REF, sizeof(PacketBuf));
+
+    HAL_WiFi_Datagram_Close();
+    HAL_WiFi_Close_Server(server_fd);
+}
+
+/* 创建任务 */
+static void bench_datagram_entry(void)
+{
+    osThreadAttr_t attr;
+    attr.name       = "bench_datagram_task";
+    attr.attr_bits  = 0U;
+    attr.cb_mem     = NULL;
+    attr.cb_size    = 0U;
+    attr.stack_mem  = NULL;
+    attr.stack_size = BENCH_TASK_STACK_SIZE;
+    attr.priority   = BENCH_TASK_PRIO;
+
+    if (osThreadNew((osThreadFunc_t)bench_datagram_task, NULL, &attr) == NULL) {
+        printf("Create bench_datagram_task failed.\n");
+    } else {
+        printf("Create bench_datagram_task successfully.\n");
+    }
+}
+
+/* 启动任务 */
+app_run(bench_datagram_entry);
@@ -0,0 +1,212 @@
+/*
+ * 链路层直连传输的Linux主机端测试：用AF_PACKET套接字收发与固件相同格式的链路层帧，
+ * 帧头编解码与固件共用hal_raw_link.c，可以在两个网络命名空间之间验证帧格式、回显和丢包。
+ *
+ * 编译（在仓库根目录）：
+ *   gcc -O2 -Ihal/inc hal/test/test_raw_link_linux.c hal/src/hal_raw_link.c -o test_raw_link
+ *
+ * 用veth连接两个网络命名空间（需要root权限）：
+ *   ip netns add mesh_a && ip netns add mesh_b
+ *   ip link add va type veth peer name vb
+ *   ip link set va netns mesh_a && ip link set vb netns mesh_b
+ *   ip -n mesh_a link set va up && ip -n mesh_b link set vb up
+ *
+ * 运行：
+ *   ip netns exec mesh_b ./test_raw_link server vb
+ *   ip netns exec mesh_a ./test_raw_link client va <vb的MAC地址> [帧数]
+ *
+ * 客户端发送数据帧，服务器原样回显，客户端校验内容并统计往返时延和丢包。
+ * 也可以把server运行在接入固件热点的Linux主机上，用固件节点的BSSID作为目标地址。
+ */
+#include "hal_raw_link.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/if_packet.h>
+
+#define TEST_NODE_MAC       "HOST01"    // 主机端使用的节点MAC
+#define TEST_FRAMES         1000        // 默认发送的数据帧数量
+#define TEST_FRAME_LEN      513         // 与完整数据帧长度一致
+#define TEST_TIMEOUT_MS     200         // 等待回显的超时时间
+
+typedef struct {
+    int fd;
+    int ifindex;
+    uint8_t hwaddr[RAW_LINK_ETH_ADDR_SIZE];
+} RawLinkSocket;
+
+static int open_raw_link(const char *ifname, RawLinkSocket *s) {
+    s->fd = socket(AF_PACKET, SOCK_RAW, htons(RAW_LINK_ETHERTYPE));
+    if (s->fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (ioctl(s->fd, SIOCGIFINDEX, &ifr) < 0) {
+        perror("SIOCGIFINDEX");
+        close(s->fd);
+        return -1;
+    }
+    s->ifindex = ifr.ifr_ifindex;
+    if (ioctl(s->fd, SIOCGIFHWADDR, &ifr) < 0) {
+        perror("SIOCGIFHWADDR");
+        close(s->fd);
+        return -1;
+    }
+    memcpy(s->hwaddr, ifr.ifr_hwaddr.sa_data, RAW_LINK_ETH_ADDR_SIZE);
+    // 只接收本接口上的帧
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(RAW_LINK_ETHERTYPE);
+    addr.sll_ifindex = s->ifindex;
+    if (bind(s->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(s->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int send_frame(const RawLinkSocket *s, const uint8_t *dst, const char *data, uint16_t len) {
+    uint8_t frame[RAW_LINK_HEADER_SIZE + RAW_LINK_MAX_FRAME_LEN];
+    if (raw_link_encode_header(frame, dst, s->hwaddr, TEST_NODE_MAC, len) != 0) {
+        return -1;
+    }
+    memcpy(frame + RAW_LINK_HEADER_SIZE, data, len);
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_ifindex = s->ifindex;
+    addr.sll_halen = RAW_LINK_ETH_ADDR_SIZE;
+    memcpy(addr.sll_addr, dst, RAW_LINK_ETH_ADDR_SIZE);
+    ssize_t n = sendto(s->fd, frame, RAW_LINK_HEADER_SIZE + len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    return n == (ssize_t)(RAW_LINK_HEADER_SIZE + len) ? 0 : -1;
+}
+
+// 接收一个本协议的帧，返回数据帧长度，超时返回0，出错返回-1
+static int receive_frame(const RawLinkSocket *s, uint8_t *frame, size_t size, RawLinkInfo *info) {
+    while (1) {
+        ssize_t n = recv(s->fd, frame, size, 0);
+        if (n < 0) {
+            return 0;
+        }
+        if (raw_link_decode_header(frame, (uint16_t)n, info) == 0) {
+            return info->len;
+        }
+        printf("Ignoring malformed frame of %zd bytes.\n", n);
+    }
+}
+
+static int parse_eth(const char *text, uint8_t *eth) {
+    unsigned int b[RAW_LINK_ETH_ADDR_SIZE];
+    if (sscanf(text, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != RAW_LINK_ETH_ADDR_SIZE) {
+        return -1;
+    }
+    for (int i = 0; i < RAW_LINK_ETH_ADDR_SIZE; i++) {
+        eth[i] = (uint8_t)b[i];
+    }
+    return 0;
+}
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// 服务器：把收到的数据帧原样发回上一跳
+static int run_server(const RawLinkSocket *s) {
+    uint8_t frame[RAW_LINK_HEADER_SIZE + RAW_LINK_MAX_FRAME_LEN + 64];
+    RawLinkInfo info;
+    printf("Echo server on ifindex %d, ethertype 0x%04X.\n", s->ifindex, RAW_LINK_ETHERTYPE);
+    while (1) {
+        int len = receive_frame(s, frame, sizeof(frame), &info);
+        if (len < 0) {
+            return -1;
+        }
+        if (len == 0) {
+            continue;
+        }
+        send_frame(s, info.src_eth, (const char *)frame + RAW_LINK_HEADER_SIZE, info.len);
+    }
+}
+
+// 客户端：逐个发送数据帧并等待回显，长度从1到TEST_FRAME_LEN循环，覆盖以太网填充的情况
+static int run_client(const RawLinkSocket *s, const uint8_t *dst, int frames) {
+    struct timeval tv = {0, TEST_TIMEOUT_MS * 1000};
+    setsockopt(s->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    char data[TEST_FRAME_LEN];
+    uint8_t frame[RAW_LINK_HEADER_SIZE + RAW_LINK_MAX_FRAME_LEN + 64];
+    RawLinkInfo info;
+    int received = 0, mismatched = 0;
+    double total_us = 0, max_us = 0;
+    for (int n = 0; n < frames; n++) {
+        uint16_t len = (uint16_t)(n % TEST_FRAME_LEN + 1);
+        for (int i = 0; i < len; i++) {
+            data[i] = (char)(n + i);
+        }
+        double start = now_us();
+        if (send_frame(s, dst, data, len) != 0) {
+            perror("sendto");
+            return -1;
+        }
+        int rlen = receive_frame(s, frame, sizeof(frame), &info);
+        if (rlen <= 0) {
+            continue;
+        }
+        double rtt = now_us() - start;
+        if (rlen != len || memcmp(frame + RAW_LINK_HEADER_SIZE, data, len) != 0) {
+            mismatched++;
+            continue;
+        }
+        received++;
+        total_us += rtt;
+        if (rtt > max_us) {
+            max_us = rtt;
+        }
+    }
+    printf("frames sent %d, echoed %d, lost %d, mismatched %d\n",
+           frames, received, frames - received - mismatched, mismatched);
+    if (received > 0) {
+        printf("rtt avg %.1f us, max %.1f us\n", total_us / received, max_us);
+    }
+    return (received == frames) ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || (strcmp(argv[1], "server") != 0 && strcmp(argv[1], "client") != 0) ||
+        (strcmp(argv[1], "client") == 0 && argc < 4)) {
+        printf("usage: %s server <ifname>\n", argv[0]);
+        printf("       %s client <ifname> <peer mac> [frames]\n", argv[0]);
+        return 2;
+    }
+    RawLinkSocket s;
+    if (open_raw_link(argv[2], &s) != 0) {
+        return 1;
+    }
+    int ret;
+    if (strcmp(argv[1], "server") == 0) {
+        ret = run_server(&s);
+    } else {
+        uint8_t dst[RAW_LINK_ETH_ADDR_SIZE];
+        if (parse_eth(argv[3], dst) != 0) {
+            printf("Invalid MAC address: %s\n", argv[3]);
+            close(s.fd);
+            return 2;
+        }
+        int frames = (argc > 4) ? atoi(argv[4]) : TEST_FRAMES;
+        ret = run_client(&s, dst, frames);
+    }
+    close(s.fd);
+    return ret == 0 ? 0 : 1;
+}
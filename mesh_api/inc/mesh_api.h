@@ -1,6 +1,138 @@
 #ifndef MESH_API_H
 #define MESH_API_H
 
+#include <stdint.h>
+
+#define MESH_SEND_FLAG_COMPRESS 0x01    // 压缩数据后发送，压缩后没有变小时自动按原数据发送
+#define MESH_MAX_DATA_LEN       493     // 单个数据包最多携带的数据长度
+#define MESH_MAX_PENDING_SENDS  16      // 同时等待应答的异步发送数量
+#define MESH_SEND_TIMEOUT_MS    3000    // 异步发送默认等待应答的时间
+#define MESH_MAX_LOANS          4       // 应用同时借用的接收缓冲区数量
+#define MESH_MAX_BATCH          16      // 一次批量发送或接收的最大消息数量
+#define MESH_PORT_DEFAULT       0       // 默认端口，mesh_send、mesh_recv等不带端口的接口都使用它
+#define MESH_MAX_PORTS          8       // 除默认端口外可以同时绑定的端口数量
+#define MESH_PORT_QUEUE_DEPTH   5       // 绑定端口时默认的接收队列长度
+#define MESH_RX_QUEUE_DEPTH     5       // 默认端口接收队列的默认长度
+#define MESH_WAIT_FOREVER       0xFFFFFFFFU  // 阻塞接收时一直等到有数据
+
+// 请求/响应式RPC
+#define MESH_PORT_RPC           255     // RPC使用的端口，不能用mesh_bind_port绑定
+#define MESH_RPC_HEADER_SIZE    4       // RPC头：类型、方法号、2字节关联ID
+#define MESH_RPC_MAX_DATA_LEN   (MESH_MAX_DATA_LEN - MESH_RPC_HEADER_SIZE)  // 请求或响应数据的最大长度
+#define MESH_RPC_MAX_PENDING    8       // 同时等待响应的调用数量
+#define MESH_RPC_MAX_METHODS    8       // 可以注册的方法数量
+#define MESH_RPC_QUEUE_DEPTH    4       // 收到后等待mesh_rpc_serve处理的请求数量
+#define MESH_RPC_TIMEOUT_MS     3000    // 默认等待响应的时间
+
+// 字节流
+#define MESH_PORT_STREAM        254     // 字节流使用的端口，不能用mesh_bind_port绑定
+#define MESH_MAX_STREAMS        2       // 同时打开的流数量
+#define MESH_STREAM_MAX_WINDOW  8       // 每个方向在途分段数量的上限，实际窗口按确认和丢包动态调整
+#define MESH_STREAM_BUF_QUOTA   6       // 所有流合计保留的数据包缓冲区上限，不挤占转发和控制面；每个流每个方向另保底1个
+#define MESH_STREAM_HEADER_SIZE 8       // 流头：类型、流ID、角色、序号、确认号、窗口
+#define MESH_STREAM_SEGMENT_SIZE (MESH_MAX_DATA_LEN - MESH_STREAM_HEADER_SIZE)  // 每个分段携带的数据长度
+#define MESH_STREAM_TIMEOUT_MS  5000    // 默认的建立连接超时
+#define MESH_STREAM_ERR_FAILED  -1      // 参数错误、连接被复位或重传超时
+#define MESH_STREAM_ERR_TIMEOUT -2      // 等待超时，连接仍然有效
+
+// 主题发布/订阅
+#define MESH_PORT_PUBSUB        253     // 发布/订阅使用的端口，不能用mesh_bind_port绑定
+#define MESH_TOPIC_MAX_LEN      32      // 主题的最大长度
+#define MESH_MAX_SUBSCRIPTIONS  8       // 本节点可以同时订阅的主题数量
+#define MESH_PUBSUB_QUEUE_DEPTH 5       // 收到后等待mesh_recv_topic取走的发布数据数量
+
+// RPC调用结果，非负数表示响应数据的长度
+#define MESH_RPC_ERR_FAILED      -1     // 网络未连接、参数错误、没有空闲的调用槽位或发送失败
+#define MESH_RPC_ERR_TIMEOUT     -2     // 等待响应超时
+#define MESH_RPC_ERR_UNREACHABLE -3     // 根节点回应目标节点不在网络中
+#define MESH_RPC_ERR_NO_METHOD   -4     // 目标节点没有注册该方法
+#define MESH_RPC_ERR_HANDLER     -5     // 目标节点的处理函数返回失败
+
+/** 数据的传输方式 */
+typedef enum {
+    MESH_TRANSPORT_TCP = 0,     // 每一跳使用TCP长连接，可靠传输
+    MESH_TRANSPORT_UDP,         // 每一跳使用UDP数据报，不保证送达，需要可靠性时由应用根据应答自行重发
+    MESH_TRANSPORT_RAW,         // 每一跳直接发送链路层帧，不经过IP，不保证送达；协议栈不支持时退回TCP
+} MeshTransport;
+
+/** 异步发送的结果 */
+typedef enum {
+    MESH_SEND_DELIVERED = 0,    // 目标节点已应答
+    MESH_SEND_TIMEOUT,          // 超时未收到应答
+    MESH_SEND_UNREACHABLE,      // 根节点回应目标节点不在网络中
+    MESH_SEND_FAILED,           // 第一跳就发送失败
+} MeshSendStatus;
+
+/**
+ * @brief 异步发送完成回调，在定时器线程或路由传输线程中调用，不能长时间阻塞
+ * @param handle mesh_send_async返回的消息句柄
+ * @param status 发送结果
+ * @param arg 发送时传入的参数
+ */
+typedef void (*MeshSendCallback)(int handle, MeshSendStatus status, void *arg);
+
+/** 完成队列中的一条发送结果 */
+typedef struct {
+    int handle;                 // 消息句柄
+    MeshSendStatus status;      // 发送结果
+} MeshSendCompletion;
+
+/** 借用的接收数据，数据留在协议栈的数据包缓冲区中，用完后调用mesh_recv_release归还 */
+typedef struct {
+    char src_mac[7];            // 发送节点的MAC地址
+    const void *data;           // 数据，只读，不以'\0'结尾
+    uint16_t len;               // 数据长度
+    void *handle;               // 内部使用
+} MeshRecvLoan;
+
+/** 批量发送中的一条消息 */
+typedef struct {
+    const char *dest_mac;       // 目标节点的MAC地址，"FFFFFF"表示广播
+    const void *data;           // 要发送的数据，可以包含'\0'
+    uint16_t len;               // 数据长度，不超过MESH_MAX_DATA_LEN
+} MeshSendItem;
+
+/** 批量接收中的一条消息，buf和buf_size由调用方填写 */
+typedef struct {
+    char src_mac[7];            // 发送节点的MAC地址
+    void *buf;                  // 存储接收到的数据，不添加'\0'
+    uint16_t buf_size;          // buf的容量，数据超出部分被丢弃
+    uint16_t len;               // 拷贝到buf中的数据长度
+} MeshRecvItem;
+
+/** 预留的发送缓冲区，应用直接把数据写到data中，再调用mesh_send_commit发送 */
+typedef struct {
+    void *data;                 // 可写的数据区，位于协议栈数据包缓冲区中帧头之后
+    uint16_t capacity;          // 预留的数据长度
+    void *handle;               // 内部使用
+} MeshSendBuffer;
+
+/** 接收队列满时的丢弃策略 */
+typedef enum {
+    MESH_DROP_TAIL = 0,         // 丢弃新到达的数据包
+    MESH_DROP_OLDEST,           // 丢弃队列中最早的数据包，适合只关心最新数据的应用
+} MeshDropPolicy;
+
+/**
+ * @brief RPC方法的处理函数，在调用mesh_rpc_serve的线程中执行
+ * @param src_mac 调用方节点的MAC地址
+ * @param request 请求数据
+ * @param request_len 请求数据长度
+ * @param[out] response 响应数据，直接写在要发出的数据包中
+ * @param response_size response的容量，即MESH_RPC_MAX_DATA_LEN
+ * @param arg 注册时传入的参数
+ * @return 响应数据长度；小于0表示处理失败，调用方收到MESH_RPC_ERR_HANDLER
+ */
+typedef int (*MeshRpcHandler)(const char *src_mac, const void *request, uint16_t request_len,
+                              void *response, uint16_t response_size, void *arg);
+
+/** Mesh网络初始化选项，未设置的字段为0时使用默认值 */
+typedef struct {
+    MeshTransport transport;    // 数据的传输方式，路由信息始终使用TCP
+    uint16_t rx_queue_depth;    // 默认端口接收队列的长度，0表示MESH_RX_QUEUE_DEPTH
+    MeshDropPolicy drop_policy; // 接收队列（包括绑定的端口）满时的丢弃策略
+} MeshInitConfig;
+
 /**
  * @brief 初始化Mesh网络
  * @param ssid Mesh网络的SSID
@@ -9,19 +141,144 @@
  */
 int mesh_init(const char *ssid, const char *password);
 
+/**
+ * @brief 按指定选项初始化Mesh网络
+ * @param ssid Mesh网络的SSID
+ * @param password Mesh网络的密码
+ * @param config 初始化选项，NULL表示使用默认选项（与mesh_init相同）
+ * @return 0表示成功，-1表示失败
+ * @note 网络中所有节点需要使用相同的传输方式
+ */
+int mesh_init_ex(const char *ssid, const char *password, const MeshInitConfig *config);
+
 /**
  * @brief 发送数据给Mesh网络中的其他节点
  * @param dest_mac 目标节点的MAC地址
  * @param data 要发送的数据
- * @note 目前data的长度不能超过490字节
+ * @note data的长度不能超过MESH_MAX_DATA_LEN（493）字节，超长时返回-1，不会截断发送
  * @return 0表示成功，-1表示失败
  */
 int mesh_send_data(const char *dest_mac, const char *data);
 
+/**
+ * @brief 发送数据给Mesh网络中的其他节点，可按消息选择发送选项
+ * @param dest_mac 目标节点的MAC地址，"FFFFFF"表示广播
+ * @param data 要发送的数据
+ * @param flags 发送选项，MESH_SEND_FLAG_COMPRESS表示压缩数据，0与mesh_send_data相同
+ * @note 接收方自动解压，mesh_recv_data收到的是原始数据
+ * @return 0表示成功，-1表示失败
+ */
+int mesh_send_data_ex(const char *dest_mac, const char *data, int flags);
+
+/**
+ * @brief 按长度发送数据给Mesh网络中的其他节点，数据可以是任意二进制内容
+ * @param dest_mac 目标节点的MAC地址，"FFFFFF"表示广播
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度，不超过MESH_MAX_DATA_LEN
+ * @param flags 发送选项，同mesh_send_data_ex
+ * @return 0表示成功，-1表示失败（网络未连接、数据过长或下一跳的发送队列已满）
+ */
+int mesh_send(const char *dest_mac, const void *data, uint16_t len, int flags);
+
+/**
+ * @brief 一次发送多条消息，网络状态和本节点MAC只检查一次，
+ *        发往同一下一跳的消息连续进入发送队列，开启合并发送时合并成少量数据帧
+ * @param items 要发送的消息
+ * @param count 消息数量，不超过MESH_MAX_BATCH
+ * @param flags 发送选项，同mesh_send_data_ex，对所有消息生效
+ * @return 按顺序成功发送的消息数量，遇到发送队列已满时停止，调用方可以稍后重发剩余的消息；
+ *         -1表示网络未连接或参数错误
+ */
+int mesh_send_batch(const MeshSendItem *items, int count, int flags);
+
+/**
+ * @brief 预留一个发送缓冲区，应用把数据直接写到协议栈的数据包缓冲区中，发送时不再拷贝
+ * @param len 预留的数据长度，不超过MESH_MAX_DATA_LEN
+ * @param[out] buf 存储预留的缓冲区
+ * @return 0表示成功，-1表示失败（数据过长或内存池已耗尽）
+ * @note 预留的缓冲区必须用mesh_send_commit发送或用mesh_send_abort放弃，否则会一直占用内存池
+ */
+int mesh_send_reserve(uint16_t len, MeshSendBuffer *buf);
+
+/**
+ * @brief 填写帧头并发送预留的缓冲区，无论成功与否缓冲区都被交还，之后不能再访问buf中的数据
+ * @param buf mesh_send_reserve预留的缓冲区
+ * @param dest_mac 目标节点的MAC地址，"FFFFFF"表示广播
+ * @param len 实际写入的数据长度，不超过预留的长度
+ * @param flags 发送选项，同mesh_send_data_ex
+ * @return 0表示成功，-1表示失败（网络未连接、长度错误或下一跳的发送队列已满）
+ */
+int mesh_send_commit(MeshSendBuffer *buf, const char *dest_mac, uint16_t len, int flags);
+
+/**
+ * @brief 放弃预留的缓冲区，不发送
+ * @param buf mesh_send_reserve预留的缓冲区
+ */
+void mesh_send_abort(MeshSendBuffer *buf);
+
+/**
+ * @brief 绑定一个端口，为它创建独立的接收队列，发往该端口的数据包不再占用默认接收队列
+ * @param port 端口，1~255
+ * @param depth 接收队列长度，0表示使用MESH_PORT_QUEUE_DEPTH
+ * @return 0表示成功，-1表示端口已绑定、已绑定MESH_MAX_PORTS个端口或创建队列失败
+ * @note 发往未绑定端口的数据包在目标节点被丢弃；队列满时只丢弃该端口自己的数据包
+ */
+int mesh_bind_port(uint8_t port, uint16_t depth);
+
+/**
+ * @brief 解除端口绑定，丢弃队列中尚未读取的数据包
+ * @param port 端口
+ * @return 0表示成功，-1表示端口没有绑定
+ * @note 不能与该端口的mesh_recv_port同时调用
+ */
+int mesh_unbind_port(uint8_t port);
+
+/**
+ * @brief 发送数据到目标节点的指定端口
+ * @param dest_mac 目标节点的MAC地址，"FFFFFF"表示广播
+ * @param port 目标端口，MESH_PORT_DEFAULT与mesh_send相同
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度，不超过MESH_MAX_DATA_LEN
+ * @param flags 发送选项，同mesh_send_data_ex
+ * @return 0表示成功，-1表示失败
+ */
+int mesh_send_port(const char *dest_mac, uint8_t port, const void *data, uint16_t len, int flags);
+
+/**
+ * @brief 非阻塞接收发往指定端口的数据
+ * @param port 已绑定的端口，MESH_PORT_DEFAULT与mesh_recv相同
+ * @param[out] src_mac 存储发送节点的MAC地址，至少7字节，可以为NULL
+ * @param[out] buf 存储接收到的数据，不添加'\0'
+ * @param buf_size buf的容量，数据超出部分被丢弃
+ * @return 拷贝到buf中的数据长度，-1表示没有数据或端口没有绑定
+ */
+int mesh_recv_port(uint8_t port, char *src_mac, void *buf, uint16_t buf_size);
+
+/**
+ * @brief 异步发送数据并跟踪送达结果，不等待应答直接返回，可以同时有多个消息在途
+ * @param dest_mac 目标节点的MAC地址，不能是广播地址
+ * @param data 要发送的数据，可以包含'\0'
+ * @param len 数据长度，不超过MESH_MAX_DATA_LEN
+ * @param flags 发送选项，同mesh_send_data_ex
+ * @param timeout_ms 等待目标节点应答的时间，0表示使用默认值MESH_SEND_TIMEOUT_MS
+ * @param cb 完成回调，NULL表示把结果放入完成队列，由mesh_poll_completion取出
+ * @param arg 回调参数
+ * @return 大于0的消息句柄；-1表示失败（网络未连接、在途消息过多或发送队列已满），不会再收到结果
+ */
+int mesh_send_async(const char *dest_mac, const void *data, uint16_t len, int flags,
+                    uint32_t timeout_ms, MeshSendCallback cb, void *arg);
+
+/**
+ * @brief 非阻塞取出一条异步发送的结果（发送时cb为NULL的消息）
+ * @param[out] completion 存储发送结果
+ * @return 0表示取到结果，-1表示完成队列为空
+ */
+int mesh_poll_completion(MeshSendCompletion *completion);
+
 /**
  * @brief 广播数据给Mesh网络中的所有节点
  * @param data 要发送的数据
- * @note 目前data的长度不能超过490字节
+ * @note data的长度不能超过MESH_MAX_DATA_LEN（493）字节，超长时返回-1，不会截断发送
  * @return 0表示成功，-1表示失败
  */
 int mesh_broadcast(const char *data);
@@ -29,11 +286,203 @@ int mesh_broadcast(const char *data);
 /**
  * @brief 非阻塞接收数据
  * @param[out] src_mac 存储发送节点的MAC地址
- * @param[out] data 存储接收到的数据
+ * @param[out] data 存储接收到的数据，以'\0'结尾，至少MESH_MAX_DATA_LEN + 1字节
  * @return 0表示成功，-1表示失败
+ * @note 数据中包含'\0'时请使用mesh_recv
  */
 int mesh_recv_data(char *src_mac, char *data);
 
+/**
+ * @brief 阻塞接收数据，直到收到数据或超时
+ * @param[out] src_mac 存储发送节点的MAC地址
+ * @param[out] data 存储接收到的数据，以'\0'结尾，至少MESH_MAX_DATA_LEN + 1字节
+ * @param timeout_ms 最长等待时间（毫秒），0表示不等待，MESH_WAIT_FOREVER表示一直等待
+ * @return 0表示成功，-1表示超时
+ */
+int mesh_recv_data_timeout(char *src_mac, char *data, uint32_t timeout_ms);
+
+/**
+ * @brief 阻塞接收数据，按长度返回，直到收到数据或超时
+ * @param[out] src_mac 存储发送节点的MAC地址，至少7字节，可以为NULL
+ * @param[out] buf 存储接收到的数据，不添加'\0'
+ * @param buf_size buf的容量，数据超出部分被丢弃
+ * @param timeout_ms 最长等待时间（毫秒），0表示不等待，MESH_WAIT_FOREVER表示一直等待
+ * @return 拷贝到buf中的数据长度，-1表示超时
+ */
+int mesh_recv_timeout(char *src_mac, void *buf, uint16_t buf_size, uint32_t timeout_ms);
+
+/**
+ * @brief 获取接收方向丢弃的数据包数量，包括接收队列已满、发往未绑定端口和解压失败的数据包
+ * @return 从启动以来丢弃的数据包数量
+ */
+uint32_t mesh_get_rx_dropped(void);
+
+/**
+ * @brief 非阻塞接收数据，按长度返回，数据可以是任意二进制内容
+ * @param[out] src_mac 存储发送节点的MAC地址，至少7字节，可以为NULL
+ * @param[out] buf 存储接收到的数据，不添加'\0'
+ * @param buf_size buf的容量，数据超出部分被丢弃
+ * @return 拷贝到buf中的数据长度，-1表示没有数据
+ */
+int mesh_recv(char *src_mac, void *buf, uint16_t buf_size);
+
+/**
+ * @brief 非阻塞接收多条数据，一次取完队列中已有的消息
+ * @param[in,out] items 调用方填写每条的buf和buf_size，返回时填写src_mac和len
+ * @param count items的数量
+ * @return 接收到的消息数量，0表示没有数据
+ */
+int mesh_recv_batch(MeshRecvItem *items, int count);
+
+/**
+ * @brief 非阻塞接收数据，不拷贝，直接借用协议栈中的数据包缓冲区
+ * @param[out] loan 存储借到的数据
+ * @return 0表示成功，-1表示没有数据或已借出MESH_MAX_LOANS个尚未归还
+ * @note 归还之前数据一直有效，应尽快归还，借出期间缓冲区不能用于接收新的数据包
+ */
+int mesh_recv_borrow(MeshRecvLoan *loan);
+
+/**
+ * @brief 归还mesh_recv_borrow借到的数据，之后loan中的数据不能再访问
+ * @param loan 借到的数据
+ */
+void mesh_recv_release(MeshRecvLoan *loan);
+
+/**
+ * @brief 注册RPC方法
+ * @param method 方法号
+ * @param handler 处理函数，NULL表示取消注册
+ * @param arg 处理函数的参数
+ * @return 0表示成功，-1表示已注册MESH_RPC_MAX_METHODS个方法
+ */
+int mesh_rpc_register(uint8_t method, MeshRpcHandler handler, void *arg);
+
+/**
+ * @brief 调用目标节点的RPC方法，阻塞直到收到响应或超时
+ * @param dest_mac 目标节点的MAC地址，不能是广播地址
+ * @param method 方法号
+ * @param request 请求数据，长度为0时可以为NULL
+ * @param request_len 请求数据长度，不超过MESH_RPC_MAX_DATA_LEN
+ * @param[out] response 存储响应数据，响应直接拷贝到这里，不经过接收队列
+ * @param response_size response的容量，超出部分被丢弃
+ * @param timeout_ms 等待响应的时间，0表示使用MESH_RPC_TIMEOUT_MS
+ * @return 拷贝到response中的数据长度，失败返回MESH_RPC_ERR_*
+ * @note 多个线程可以同时调用，最多MESH_RPC_MAX_PENDING个调用同时等待响应
+ */
+int mesh_rpc_call(const char *dest_mac, uint8_t method, const void *request, uint16_t request_len,
+                  void *response, uint16_t response_size, uint32_t timeout_ms);
+
+/**
+ * @brief 处理一个收到的RPC请求：调用注册的处理函数并把响应发回调用方
+ * @param timeout_ms 等待请求的时间，0表示不等待，MESH_WAIT_FOREVER表示一直等待
+ * @return 0表示处理了一个请求，-1表示没有请求
+ * @note 应用在自己的线程中循环调用，处理函数在该线程中执行；没有线程处理时请求会超时
+ */
+int mesh_rpc_serve(uint32_t timeout_ms);
+
+/**
+ * @brief 与目标节点建立一个有序、可靠的字节流，阻塞直到连接建立
+ * @param dest_mac 目标节点的MAC地址，不能是广播地址，目标节点需要先调用mesh_stream_listen
+ * @param timeout_ms 建立连接的超时时间，0表示使用MESH_STREAM_TIMEOUT_MS
+ * @return 流句柄（非负数），失败返回MESH_STREAM_ERR_*
+ */
+int mesh_stream_open(const char *dest_mac, uint32_t timeout_ms);
+
+/**
+ * @brief 开始接受其他节点建立的流，之前收到的连接请求被拒绝
+ * @return 0表示成功，-1表示失败
+ */
+int mesh_stream_listen(void);
+
+/**
+ * @brief 取出一个其他节点建立的流
+ * @param[out] peer_mac 存储对方节点的MAC地址，至少7字节，可以为NULL
+ * @param timeout_ms 等待时间，0表示不等待，MESH_WAIT_FOREVER表示一直等待
+ * @return 流句柄（非负数），失败返回MESH_STREAM_ERR_*
+ */
+int mesh_stream_accept(char *peer_mac, uint32_t timeout_ms);
+
+/**
+ * @brief 向流中写入数据，数据被切成分段按窗口发送，对方确认前由协议栈保存用于重传
+ * @param handle 流句柄
+ * @param data 要写入的数据
+ * @param len 数据长度，不受单个数据包长度限制
+ * @param timeout_ms 发送窗口已满时等待的时间，MESH_WAIT_FOREVER表示一直等待
+ * @return 已写入的字节数，可能小于len（超时）；一个字节也没有写入时返回MESH_STREAM_ERR_*
+ */
+int mesh_stream_write(int handle, const void *data, uint32_t len, uint32_t timeout_ms);
+
+/**
+ * @brief 从流中按顺序读取数据
+ * @param handle 流句柄
+ * @param[out] buf 存储读到的数据
+ * @param size buf的容量
+ * @param timeout_ms 没有数据时等待的时间，0表示不等待，MESH_WAIT_FOREVER表示一直等待
+ * @return 读到的字节数；0表示对方已关闭且数据已读完；失败返回MESH_STREAM_ERR_*
+ */
+int mesh_stream_read(int handle, void *buf, uint32_t size, uint32_t timeout_ms);
+
+/**
+ * @brief 关闭流：通知对方数据已写完，等待对方确认剩余数据后释放
+ * @param handle 流句柄
+ * @return 0表示剩余数据都已被确认，否则返回MESH_STREAM_ERR_*；无论结果如何句柄都已释放
+ */
+int mesh_stream_close(int handle);
+
+/**
+ * @brief 订阅主题，之后其他节点发布到该主题的数据可以用mesh_recv_topic接收
+ * @param topic 主题，以'\0'结尾，长度不超过MESH_TOPIC_MAX_LEN
+ * @return 0表示成功（包括已经订阅），-1表示参数错误或已订阅MESH_MAX_SUBSCRIPTIONS个主题
+ * @note 订阅摘要随路由表逐级报给父节点，大约一个路由维护周期后生效
+ */
+int mesh_subscribe(const char *topic);
+
+/**
+ * @brief 取消订阅主题
+ * @param topic 主题
+ * @return 0表示成功，-1表示没有订阅该主题
+ */
+int mesh_unsubscribe(const char *topic);
+
+/**
+ * @brief 向主题发布数据，只发给子树中有订阅者的节点，不像mesh_broadcast发给所有节点
+ * @param topic 主题，以'\0'结尾，长度不超过MESH_TOPIC_MAX_LEN
+ * @param data 数据，长度为0时可以为NULL
+ * @param len 数据长度，与主题一起不超过MESH_MAX_DATA_LEN - 1
+ * @return 0表示成功，-1表示失败
+ * @note 非根节点的发布先发给根节点，再由根节点向下分发；本节点订阅了该主题时同样会收到
+ */
+int mesh_publish(const char *topic, const void *data, uint16_t len);
+
+/**
+ * @brief 接收订阅的主题上发布的数据
+ * @param[out] topic 存储主题，至少MESH_TOPIC_MAX_LEN + 1字节，可以为NULL
+ * @param[out] src_mac 存储发布者的MAC地址，至少7字节，可以为NULL
+ * @param[out] buf 存储数据
+ * @param buf_size buf的容量，超出部分被丢弃
+ * @param timeout_ms 没有数据时等待的时间，0表示不等待，MESH_WAIT_FOREVER表示一直等待
+ * @return 拷贝到buf中的数据长度，-1表示没有数据
+ */
+int mesh_recv_topic(char *topic, char *src_mac, void *buf, uint16_t buf_size, uint32_t timeout_ms);
+
+/**
+ * @brief 设置小数据合并发送的参数，发往同一下一跳的多个小数据包合并成一帧发送
+ * @param delay_ms 数据包最长等待合并的时间（毫秒），0表示不等待，只合并已经积压的数据包
+ * @param threshold 合并后的长度达到该字节数时立即发送
+ * @return 0表示成功，-1表示参数错误
+ * @note 可以在运行时调用；接收方自动拆开，mesh_recv_data逐个收到原来的数据包
+ */
+int mesh_set_aggregation(int delay_ms, int threshold);
+
+/**
+ * @brief 设置某个子节点所在子树在本节点上行链路中的权重
+ * @param child_mac 直连子节点的MAC地址，NULL表示本节点自己发出的数据
+ * @param weight 权重，1~255，权重为2的子树分到的带宽是权重为1的两倍；0表示恢复默认权重
+ * @return 0表示成功，-1表示失败
+ * @note 只影响本节点转发给父节点的数据，队列满时只丢弃该子树自己的数据包
+ */
+int mesh_set_subtree_weight(const char *child_mac, int weight);
+
 /**
  * @brief 判断网络是否连接
  * @return 1表示已连接，0表示未连接
@@ -6,6 +6,7 @@
 #include "network_fsm.h"
 #include "routing_transport.h"
 #include "hal_wireless.h"
+#include "hal_packet_buf.h"
 #include "mesh_api.h"
 
 // 定义宏开关，打开或关闭日志输出
@@ -30,6 +31,8 @@ osThreadId_t route_transport_task_id;
 
 extern osMessageQueueId_t dataPacketQueueId;
 
+static osSemaphoreId_t loan_semaphore = NULL;  // 剩余可借出的接收缓冲区数量
+
 // Mesh配置全局变量
 extern MeshNetworkConfig g_mesh_config;
 
@@ -45,6 +48,10 @@ void network_task(void) {
 }
 
 int mesh_init(const char *ssid, const char *password) {
+    return mesh_init_ex(ssid, password, NULL);
+}
+
+int mesh_init_ex(const char *ssid, const char *password, const MeshInitConfig *config) {
     LOG("Initializing mesh network...\n");
     // 检查 SSID 和密码是否合法
     if (strlen(ssid) > 15 || strlen(password) > 64) {
@@ -55,6 +62,40 @@ int mesh_init(const char *ssid, const char *password) {
     strcpy(mesh_ssid, ssid);
     strcpy(mesh_password, password);
 
+    // 设置数据的传输方式，需要在路由传输线程启动前设置
+    MeshTransport transport = (config == NULL) ? MESH_TRANSPORT_TCP : config->transport;
+    switch (transport) {
+        case MESH_TRANSPORT_UDP:
+            set_data_transport(DATA_TRANSPORT_UDP);
+            break;
+        case MESH_TRANSPORT_RAW:
+            set_data_transport(DATA_TRANSPORT_RAW);
+            break;
+        default:
+            set_data_transport(DATA_TRANSPORT_TCP);
+            break;
+    }
+    // 接收队列的长度同样需要在路由传输线程创建队列之前设置
+    if (config == NULL) {
+        set_receive_queue(MESH_RX_QUEUE_DEPTH, RX_DROP_TAIL);
+    } else {
+        set_receive_queue((config->rx_queue_depth == 0) ? MESH_RX_QUEUE_DEPTH : config->rx_queue_depth,
+                          (config->drop_policy == MESH_DROP_OLDEST) ? RX_DROP_OLDEST : RX_DROP_TAIL);
+    }
+
+    // 初始化数据包缓冲区内存池
+    if (HAL_PacketBuf_Init() != 0) {
+        LOG("Failed to init packet buffer pool.\n");
+        return -1;
+    }
+    if (loan_semaphore == NULL) {
+        loan_semaphore = osSemaphoreNew(MESH_MAX_LOANS, MESH_MAX_LOANS, NULL);
+        if (loan_semaphore == NULL) {
+            LOG("Failed to create loan semaphore.\n");
+            return -1;
+        }
+    }
+
     // 创建network线程
     osThreadAttr_t attr1;
     attr1.name       = "network_task";         // 任务名
@@ -91,76 +132,1039 @@ int mesh_init(const char *ssid, const char *password) {
     return 0;
 }
 
+static int mesh_broadcast_ex(const char *data, uint16_t len, int flags);
+
+// 填写帧头并发送已经写好数据的数据包，dest_mac为"FFFFFF"时广播，返回前释放调用方持有的引用
+static int send_prepared_packet(PacketBuf *buf, const char *my_mac, const char *dest_mac, uint8_t port, int flags) {
+    int ret = 0;
+    if (strncmp(dest_mac, "FFFFFF", MAC_SIZE) != 0) {
+        fill_data_packet_header(buf, my_mac, dest_mac, '0');
+    } else if (g_mesh_config.tree_level == 0) {
+        // 如果自己是根节点，则直接广播数据包
+        fill_data_packet_header(buf, "000000", "FFFFFF", '4');
+    } else {
+        // 如果不是根节点，则向根节点发送广播请求
+        fill_data_packet_header(buf, my_mac, "000000", '3');
+    }
+    buf->payload[PACKET_PORT_OFFSET] = (char)port;
+    // 帧头填好后才能压缩，压缩后的数据包沿用帧头
+    if (flags & MESH_SEND_FLAG_COMPRESS) {
+        buf = compress_data_packet(buf);
+    }
+    if (strncmp(dest_mac, "FFFFFF", MAC_SIZE) != 0) {
+        ret = send_packet_buf_async(buf, NULL, NULL);
+    } else if (g_mesh_config.tree_level == 0) {
+        broadcast_data_packet(buf);
+    } else {
+        send_packet_buf(buf);  // 目标地址"000000"不在路由表中，发给父节点
+    }
+    HAL_PacketBuf_Free(buf);
+    return ret;
+}
+
 int mesh_send_data(const char *dest_mac, const char *data) {
+    return mesh_send_data_ex(dest_mac, data, 0);
+}
+
+int mesh_send_data_ex(const char *dest_mac, const char *data, int flags) {
+    // 超长的字符串返回失败而不是截断，先按size_t比较，避免转换为uint16_t时回绕
+    size_t len = (data != NULL) ? strlen(data) : 0;
+    if (len > MESH_MAX_DATA_LEN) {
+        LOG("Data too long to send: %u bytes.\n", (unsigned int)len);
+        return -1;
+    }
+    return mesh_send(dest_mac, data, (uint16_t)len, flags);
+}
+
+int mesh_send(const char *dest_mac, const void *data, uint16_t len, int flags) {
+    return mesh_send_port(dest_mac, MESH_PORT_DEFAULT, data, len, flags);
+}
+
+int mesh_send_port(const char *dest_mac, uint8_t port, const void *data, uint16_t len, int flags) {
     // 检查网络是否连接
     if (network_connected() != 1) {
         LOG("Network is not connected.\n");
         return -1;
     }
-    // DataPacket packet;
-    // 如果目标MAC地址是广播地址，则直接广播数据包
-    if (strcmp(dest_mac, "FFFFFF") == 0) {
-        mesh_broadcast(data);
-    }else{
-        // 如果目标MAC地址不是广播地址，则向目标节点发送数据包
-        send_data_packet(dest_mac, data);
+    if (dest_mac == NULL || data == NULL || len > MESH_MAX_DATA_LEN) {
+        LOG("Invalid data to send.\n");
+        return -1;
+    }
+    PacketBuf *buf = alloc_data_packet(len);
+    if (buf == NULL) {
+        return -1;
+    }
+    memcpy(buf->payload + PACKET_DATA_OFFSET, data, len);
+    // 目标MAC地址是广播地址时广播数据包，否则向目标节点发送数据包
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    return send_prepared_packet(buf, my_mac, dest_mac, port, flags);
+}
+
+int mesh_send_batch(const MeshSendItem *items, int count, int flags) {
+    if (items == NULL || count < 0 || count > MESH_MAX_BATCH) {
+        LOG("Invalid batch to send.\n");
+        return -1;
+    }
+    // 整批只检查一次网络状态、取一次本节点MAC
+    if (network_connected() != 1) {
+        LOG("Network is not connected.\n");
+        return -1;
+    }
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    int sent = 0;
+    for (; sent < count; sent++) {
+        const MeshSendItem *item = &items[sent];
+        if (item->dest_mac == NULL || item->data == NULL || item->len > MESH_MAX_DATA_LEN) {
+            LOG("Invalid data to send.\n");
+            break;
+        }
+        PacketBuf *buf = alloc_data_packet(item->len);
+        if (buf == NULL) {
+            break;
+        }
+        memcpy(buf->payload + PACKET_DATA_OFFSET, item->data, item->len);
+        // 连续入队，发送线程取出时同一下一跳的数据帧已经积压在一起，可以合并成一帧
+        if (send_prepared_packet(buf, my_mac, item->dest_mac, MESH_PORT_DEFAULT, flags) != 0) {
+            break;
+        }
+    }
+    return sent;
+}
+
+int mesh_send_reserve(uint16_t len, MeshSendBuffer *buf) {
+    if (buf == NULL || len > MESH_MAX_DATA_LEN) {
+        LOG("Invalid length to reserve.\n");
+        return -1;
+    }
+    // 帧头的位置留空，发送时填写，数据区就是最终发出的数据帧的一部分
+    PacketBuf *packet = alloc_data_packet(len);
+    if (packet == NULL) {
+        return -1;
+    }
+    buf->data = packet->payload + PACKET_DATA_OFFSET;
+    buf->capacity = len;
+    buf->handle = packet;
+    return 0;
+}
+
+int mesh_send_commit(MeshSendBuffer *buf, const char *dest_mac, uint16_t len, int flags) {
+    if (buf == NULL || buf->handle == NULL) {
+        return -1;
+    }
+    PacketBuf *packet = (PacketBuf *)buf->handle;
+    buf->data = NULL;
+    buf->handle = NULL;
+    if (dest_mac == NULL || len > buf->capacity) {
+        LOG("Invalid data to send.\n");
+        HAL_PacketBuf_Free(packet);
+        return -1;
+    }
+    if (network_connected() != 1) {
+        LOG("Network is not connected.\n");
+        HAL_PacketBuf_Free(packet);
+        return -1;
+    }
+    // 实际写入的数据可能比预留的短，保持数据后的'\0'与其他数据包一致
+    packet->len = PACKET_DATA_OFFSET + len;
+    packet->payload[packet->len] = '\0';
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    return send_prepared_packet(packet, my_mac, dest_mac, MESH_PORT_DEFAULT, flags);
+}
+
+void mesh_send_abort(MeshSendBuffer *buf) {
+    if (buf == NULL) {
+        return;
+    }
+    HAL_PacketBuf_Free((PacketBuf *)buf->handle);
+    buf->data = NULL;
+    buf->handle = NULL;
+}
+
+// 等待应答的异步发送，按数据包编号、端口和目标地址匹配应答
+typedef struct {
+    int handle;                 // 0 表示空位
+    char dest_mac[MAC_SIZE + 1];
+    char num[3];                // 数据包编号，应答包沿用
+    uint8_t port;               // 端口，应答包沿用
+    uint32_t deadline;          // 超时的系统tick
+    MeshSendCallback cb;
+    void *arg;
+} PendingSend;
+
+#define ASYNC_CHECK_INTERVAL_MS 100  // 检查超时的周期
+
+static PendingSend pending_sends[MESH_MAX_PENDING_SENDS];
+static osMutexId_t pending_mutex = NULL;
+static osMessageQueueId_t completion_queue = NULL;
+static osTimerId_t pending_timer = NULL;
+static int next_handle = 1;
+
+// 结束一个等待中的发送，handle不匹配说明已经结束过，需要持有pending_mutex，返回时已释放
+static void finish_pending(PendingSend *p, MeshSendStatus status) {
+    int handle = p->handle;
+    MeshSendCallback cb = p->cb;
+    void *arg = p->arg;
+    p->handle = 0;
+    osMutexRelease(pending_mutex);
+    if (cb != NULL) {
+        cb(handle, status, arg);
+        return;
+    }
+    MeshSendCompletion completion = {handle, status};
+    if (osMessageQueuePut(completion_queue, &completion, 0, 0) != osOK) {
+        LOG("Completion queue full, result of %d dropped.\n", handle);
+    }
+}
+
+static PendingSend *find_pending(int handle) {
+    for (int i = 0; i < MESH_MAX_PENDING_SENDS; i++) {
+        if (pending_sends[i].handle == handle) {
+            return &pending_sends[i];
+        }
+    }
+    return NULL;
+}
+
+// 路由传输线程收到应答时调用：status 1 来自目标节点，status 2 来自根节点
+// 根节点的应答没有目标地址可比对，编号之外再比对端口，减少编号循环后误匹配其他数据包的应答
+static int handle_reply(const PacketBuf *buf) {
+    const char *frame = buf->payload;
+    char status = frame[PACKET_STATUS_OFFSET];
+    osMutexAcquire(pending_mutex, osWaitForever);
+    for (int i = 0; i < MESH_MAX_PENDING_SENDS; i++) {
+        PendingSend *p = &pending_sends[i];
+        if (p->handle == 0 || memcmp(p->num, frame + PACKET_NUM_OFFSET, 3) != 0 ||
+            p->port != (uint8_t)frame[PACKET_PORT_OFFSET]) {
+            continue;
+        }
+        if (status == '1' && strncmp(p->dest_mac, frame + PACKET_SRC_MAC_OFFSET, MAC_SIZE) != 0) {
+            continue;
+        }
+        finish_pending(p, status == '1' ? MESH_SEND_DELIVERED : MESH_SEND_UNREACHABLE);
+        return 0;
+    }
+    osMutexRelease(pending_mutex);
+    return -1;  // 不是在等待的应答，按原来的方式交给应用层
+}
+
+// 定时检查超时，在定时器线程中调用
+static void check_pending_timeout(void *arg) {
+    (void)arg;
+    uint32_t now = osKernelGetTickCount();
+    osMutexAcquire(pending_mutex, osWaitForever);
+    for (int i = 0; i < MESH_MAX_PENDING_SENDS; i++) {
+        PendingSend *p = &pending_sends[i];
+        if (p->handle != 0 && (int32_t)(now - p->deadline) >= 0) {
+            finish_pending(p, MESH_SEND_TIMEOUT);
+            osMutexAcquire(pending_mutex, osWaitForever);
+        }
+    }
+    osMutexRelease(pending_mutex);
+}
+
+// 第一跳发送失败时不用再等应答
+static void async_tx_complete(PacketBuf *buf, int result, void *arg) {
+    (void)buf;
+    if (result == TX_RESULT_OK) {
+        return;
+    }
+    osMutexAcquire(pending_mutex, osWaitForever);
+    PendingSend *p = find_pending((int)(intptr_t)arg);
+    if (p == NULL) {
+        osMutexRelease(pending_mutex);
+        return;
+    }
+    finish_pending(p, MESH_SEND_FAILED);
+}
+
+static int async_init(void) {
+    if (pending_mutex != NULL) {
+        return 0;
+    }
+    completion_queue = osMessageQueueNew(MESH_MAX_PENDING_SENDS, sizeof(MeshSendCompletion), NULL);
+    pending_timer = osTimerNew(check_pending_timeout, osTimerPeriodic, NULL, NULL);
+    osMutexId_t mutex = osMutexNew(NULL);
+    if (completion_queue == NULL || pending_timer == NULL || mutex == NULL) {
+        LOG("Failed to init async send.\n");
+        return -1;
     }
+    memset(pending_sends, 0, sizeof(pending_sends));
+    pending_mutex = mutex;
+    set_reply_handler(handle_reply);
+    osTimerStart(pending_timer, ASYNC_CHECK_INTERVAL_MS * osKernelGetTickFreq() / 1000);
     return 0;
 }
 
+int mesh_send_async(const char *dest_mac, const void *data, uint16_t len, int flags,
+                    uint32_t timeout_ms, MeshSendCallback cb, void *arg) {
+    if (network_connected() != 1) {
+        LOG("Network is not connected.\n");
+        return -1;
+    }
+    if (dest_mac == NULL || data == NULL || len > MESH_MAX_DATA_LEN || strncmp(dest_mac, "FFFFFF", MAC_SIZE) == 0) {
+        LOG("Invalid data to send.\n");
+        return -1;
+    }
+    if (async_init() != 0) {
+        return -1;
+    }
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    PacketBuf *buf = create_data_packet(my_mac, dest_mac, '0', data, len);
+    if (buf == NULL) {
+        return -1;
+    }
+    if (flags & MESH_SEND_FLAG_COMPRESS) {
+        buf = compress_data_packet(buf);
+    }
+    // 先登记再发送，应答可能在发送函数返回前就到达
+    osMutexAcquire(pending_mutex, osWaitForever);
+    PendingSend *p = find_pending(0);
+    if (p == NULL) {
+        osMutexRelease(pending_mutex);
+        HAL_PacketBuf_Free(buf);
+        LOG("Too many pending sends.\n");
+        return -1;
+    }
+    int handle = next_handle;
+    next_handle = (next_handle == INT32_MAX) ? 1 : next_handle + 1;
+    p->handle = handle;
+    strncpy(p->dest_mac, dest_mac, MAC_SIZE);
+    p->dest_mac[MAC_SIZE] = '\0';
+    memcpy(p->num, buf->payload + PACKET_NUM_OFFSET, 3);
+    p->port = (uint8_t)buf->payload[PACKET_PORT_OFFSET];
+    p->deadline = osKernelGetTickCount() + ((timeout_ms == 0) ? MESH_SEND_TIMEOUT_MS : timeout_ms) * osKernelGetTickFreq() / 1000;
+    p->cb = cb;
+    p->arg = arg;
+    osMutexRelease(pending_mutex);
+
+    int ret = send_packet_buf_async(buf, async_tx_complete, (void *)(intptr_t)handle);
+    HAL_PacketBuf_Free(buf);
+    if (ret != 0) {
+        // 没有入队，不会有结果，直接撤销登记
+        osMutexAcquire(pending_mutex, osWaitForever);
+        p = find_pending(handle);
+        if (p != NULL) {
+            p->handle = 0;
+        }
+        osMutexRelease(pending_mutex);
+        return -1;
+    }
+    return handle;
+}
+
+int mesh_poll_completion(MeshSendCompletion *completion) {
+    if (completion == NULL || completion_queue == NULL) {
+        return -1;
+    }
+    return osMessageQueueGet(completion_queue, completion, NULL, 0) == osOK ? 0 : -1;
+}
+
 int mesh_broadcast(const char *data) {
+    size_t len = (data != NULL) ? strlen(data) : 0;
+    if (len > MESH_MAX_DATA_LEN) {
+        LOG("Data too long to broadcast: %u bytes.\n", (unsigned int)len);
+        return -1;
+    }
+    return mesh_broadcast_ex(data, (uint16_t)len, 0);
+}
+
+static int mesh_broadcast_ex(const char *data, uint16_t len, int flags) {
     // 检查网络是否连接
     if (network_connected() != 1) {
         LOG("Network is not connected.\n");
         return -1;
     }
-    DataPacket packet;
-    // 如果自己是根节点，则直接广播数据包
-    if (g_mesh_config.tree_level == 0) {
-        packet.type = '1';
-        strcpy(packet.src_mac, "000000");
-        strcpy(packet.dest_mac, "FFFFFF");
-        packet.status = '4';
-        memcpy(packet.packet_num, "000", 3);
-        memcpy(packet.crc, "00", 2);
-        strcpy(packet.data, data);
-        broadcast_data_packet(packet);
-    }else{
-        // 如果不是根节点，则向根节点发送广播请求
-        packet.type = '1';
-        char my_mac[7] = {0};
-        HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
-        strcpy(packet.src_mac, my_mac);
-        strcpy(packet.dest_mac, "000000");
-        packet.status = '3';
-        memcpy(packet.packet_num, "000", 3);
-        memcpy(packet.crc, "00", 2);
-        strcpy(packet.data, data);
-        char *packet_data = generate_data_packet(packet);
-        HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, packet_data, g_mesh_config.tree_level - 1);
+    if (data == NULL || len > MESH_MAX_DATA_LEN) {
+        LOG("Invalid data to broadcast.\n");
+        return -1;
     }
-    return 0;
+    PacketBuf *buf = alloc_data_packet(len);
+    if (buf == NULL) {
+        return -1;
+    }
+    memcpy(buf->payload + PACKET_DATA_OFFSET, data, len);
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    return send_prepared_packet(buf, my_mac, "FFFFFF", MESH_PORT_DEFAULT, flags);
 }
 
 int mesh_recv_data(char *src_mac, char *data) {
-    // 从队列中获取数据包
-    DataPacket packet;
-    osStatus_t status = osMessageQueueGet(dataPacketQueueId, &packet, NULL, 0);
-    if (status != osOK) {
-        LOG("no data in queue.\n");
+    int len = mesh_recv(src_mac, data, MESH_MAX_DATA_LEN);
+    if (len < 0) {
         return -1;
     }
-    if (packet.status == '1') {
+    data[len] = '\0';
+    return 0;
+}
+
+// 从接收队列中取出一个数据包缓冲区，应答包不交给应用，跳过；等待timeout_ms后队列仍为空返回NULL
+static PacketBuf *pop_data_packet(osMessageQueueId_t queue, uint32_t timeout_ms) {
+    PacketBuf *packet = NULL;
+    if (queue == NULL) {
+        return NULL;
+    }
+    uint32_t timeout = (timeout_ms == MESH_WAIT_FOREVER) ? osWaitForever : timeout_ms * osKernelGetTickFreq() / 1000;
+    uint32_t start = osKernelGetTickCount();
+    while (1) {
+        // 跳过应答包后只等待剩余的时间
+        uint32_t wait = timeout;
+        if (timeout != osWaitForever) {
+            uint32_t elapsed = osKernelGetTickCount() - start;
+            wait = (elapsed >= timeout) ? 0 : timeout - elapsed;
+        }
+        if (osMessageQueueGet(queue, &packet, NULL, wait) != osOK) {
+            LOG("no data in queue.\n");
+            return NULL;
+        }
+        if (packet->payload[PACKET_STATUS_OFFSET] != '1') {
+            return packet;
+        }
         LOG("Received a ack packet.\n");
-        return -1;
+        HAL_PacketBuf_Free(packet);
     }
+}
+
+static uint16_t packet_data_len(const PacketBuf *packet) {
+    return (packet->len > PACKET_DATA_OFFSET) ? packet->len - PACKET_DATA_OFFSET : 0;
+}
+
+// 拷贝数据包中的源地址和数据，释放数据包，返回拷贝的数据长度
+static uint16_t copy_data_packet(PacketBuf *packet, char *src_mac, void *buf, uint16_t buf_size) {
     // 解析数据包
-    strncpy(src_mac, packet.src_mac, MAC_SIZE);
-    src_mac[MAC_SIZE] = '\0';
-    strcpy(data, packet.data);
+    if (src_mac != NULL) {
+        strncpy(src_mac, packet->payload + PACKET_SRC_MAC_OFFSET, MAC_SIZE);
+        src_mac[MAC_SIZE] = '\0';
+    }
+    // 按帧长度拷贝，零拷贝接收的缓冲区数据不以'\0'结尾
+    uint16_t data_len = packet_data_len(packet);
+    if (data_len > buf_size) {
+        LOG("Receive buffer too small, %d bytes dropped.\n", data_len - buf_size);
+        data_len = buf_size;
+    }
+    memcpy(buf, packet->payload + PACKET_DATA_OFFSET, data_len);
+    HAL_PacketBuf_Free(packet);
+    return data_len;
+}
+
+int mesh_recv(char *src_mac, void *buf, uint16_t buf_size) {
+    PacketBuf *packet = pop_data_packet(dataPacketQueueId, 0);
+    if (packet == NULL) {
+        return -1;
+    }
+    return copy_data_packet(packet, src_mac, buf, buf_size);
+}
+
+int mesh_recv_timeout(char *src_mac, void *buf, uint16_t buf_size, uint32_t timeout_ms) {
+    PacketBuf *packet = pop_data_packet(dataPacketQueueId, timeout_ms);
+    if (packet == NULL) {
+        return -1;
+    }
+    return copy_data_packet(packet, src_mac, buf, buf_size);
+}
+
+int mesh_recv_data_timeout(char *src_mac, char *data, uint32_t timeout_ms) {
+    int len = mesh_recv_timeout(src_mac, data, MESH_MAX_DATA_LEN, timeout_ms);
+    if (len < 0) {
+        return -1;
+    }
+    data[len] = '\0';
+    return 0;
+}
+
+uint32_t mesh_get_rx_dropped(void) {
+    return get_receive_dropped();
+}
+
+int mesh_recv_port(uint8_t port, char *src_mac, void *buf, uint16_t buf_size) {
+    PacketBuf *packet = pop_data_packet(get_port_queue(port), 0);
+    if (packet == NULL) {
+        return -1;
+    }
+    return copy_data_packet(packet, src_mac, buf, buf_size);
+}
+
+int mesh_bind_port(uint8_t port, uint16_t depth) {
+    if (port == MESH_PORT_DEFAULT || port == MESH_PORT_RPC || port == MESH_PORT_STREAM || port == MESH_PORT_PUBSUB ||
+        get_port_queue(port) != NULL) {
+        LOG("Port %d is already bound.\n", port);
+        return -1;
+    }
+    osMessageQueueId_t queue = osMessageQueueNew((depth == 0) ? MESH_PORT_QUEUE_DEPTH : depth, sizeof(PacketBuf *), NULL);
+    if (queue == NULL) {
+        LOG("Failed to create queue for port %d.\n", port);
+        return -1;
+    }
+    if (bind_port_queue(port, queue) != 0) {
+        osMessageQueueDelete(queue);
+        return -1;
+    }
     return 0;
 }
 
+int mesh_unbind_port(uint8_t port) {
+    osMessageQueueId_t queue = get_port_queue(port);
+    if (port == MESH_PORT_DEFAULT || queue == NULL || bind_port_queue(port, NULL) != 0) {
+        return -1;
+    }
+    // 解除绑定后路由线程不会再投递，释放队列中剩余的数据包
+    PacketBuf *packet = NULL;
+    while (osMessageQueueGet(queue, &packet, NULL, 0) == osOK) {
+        HAL_PacketBuf_Free(packet);
+    }
+    osMessageQueueDelete(queue);
+    return 0;
+}
+
+int mesh_recv_batch(MeshRecvItem *items, int count) {
+    if (items == NULL || count <= 0) {
+        return 0;
+    }
+    int received = 0;
+    while (received < count) {
+        PacketBuf *packet = pop_data_packet(dataPacketQueueId, 0);
+        if (packet == NULL) {
+            break;
+        }
+        MeshRecvItem *item = &items[received++];
+        item->len = copy_data_packet(packet, item->src_mac, item->buf, item->buf_size);
+    }
+    return received;
+}
+
+int mesh_recv_borrow(MeshRecvLoan *loan) {
+    if (loan == NULL) {
+        return -1;
+    }
+    if (loan_semaphore == NULL) {
+        return -1;
+    }
+    // 借出的数量有上限，应用不归还时只会停止接收，不会耗尽内存池
+    if (osSemaphoreAcquire(loan_semaphore, 0) != osOK) {
+        LOG("Too many loans outstanding.\n");
+        return -1;
+    }
+    PacketBuf *packet = pop_data_packet(dataPacketQueueId, 0);
+    if (packet == NULL) {
+        osSemaphoreRelease(loan_semaphore);
+        return -1;
+    }
+    strncpy(loan->src_mac, packet->payload + PACKET_SRC_MAC_OFFSET, MAC_SIZE);
+    loan->src_mac[MAC_SIZE] = '\0';
+    loan->data = packet->payload + PACKET_DATA_OFFSET;
+    loan->len = packet_data_len(packet);
+    loan->handle = packet;
+    return 0;
+}
+
+void mesh_recv_release(MeshRecvLoan *loan) {
+    if (loan == NULL || loan->handle == NULL) {
+        return;
+    }
+    HAL_PacketBuf_Free((PacketBuf *)loan->handle);
+    loan->handle = NULL;
+    loan->data = NULL;
+    loan->len = 0;
+    osSemaphoreRelease(loan_semaphore);
+}
+
+// RPC：请求和响应都发往MESH_PORT_RPC，数据位开头是RPC头；响应本身就是确认，数据包以PACKET_STATUS_NO_ACK发送
+// [0] 类型 [1] 方法号 [2-3] 关联ID（大端序），后面是请求或响应数据；错误响应的数据是一个字节的错误码
+#define RPC_KIND_REQUEST    'Q'
+#define RPC_KIND_RESPONSE   'R'
+#define RPC_KIND_ERROR      'E'
+
+typedef enum {
+    RPC_SLOT_FREE = 0,
+    RPC_SLOT_WAITING,           // 请求已发出，等待响应
+    RPC_SLOT_DONE,              // 已收到响应，调用方还没有取走结果
+} RpcSlotState;
+
+typedef struct {
+    RpcSlotState state;
+    uint16_t id;                // 关联ID
+    char dest_mac[MAC_SIZE + 1];
+    char num[3];                // 请求包编号，根节点的不可达回应沿用
+    void *response;             // 调用方的响应缓冲区，响应直接拷贝到这里
+    uint16_t response_size;
+    int result;                 // 响应长度或MESH_RPC_ERR_*
+    osSemaphoreId_t done;       // 收到响应时释放
+} RpcSlot;
+
+typedef struct {
+    uint8_t method;
+    MeshRpcHandler handler;     // NULL 表示空位
+    void *arg;
+} RpcMethod;
+
+static RpcSlot rpc_slots[MESH_RPC_MAX_PENDING];
+static RpcMethod rpc_methods[MESH_RPC_MAX_METHODS];
+static osMutexId_t rpc_mutex = NULL;    // 保护调用槽位和方法表
+static osMessageQueueId_t rpc_request_queue = NULL;
+static uint16_t rpc_next_id = 1;
+
+// 结束一个等待中的调用，需要持有rpc_mutex
+static void rpc_finish(RpcSlot *slot, int result) {
+    slot->result = result;
+    slot->state = RPC_SLOT_DONE;
+    osSemaphoreRelease(slot->done);
+}
+
+// 收到响应，直接拷贝到等待的调用方的缓冲区
+static void rpc_handle_response(const PacketBuf *buf) {
+    const char *frame = buf->payload;
+    const uint8_t *header = (const uint8_t *)frame + PACKET_DATA_OFFSET;
+    uint16_t len = packet_data_len(buf) - MESH_RPC_HEADER_SIZE;
+    uint16_t id = (uint16_t)((header[2] << 8) | header[3]);
+    osMutexAcquire(rpc_mutex, osWaitForever);
+    for (int i = 0; i < MESH_RPC_MAX_PENDING; i++) {
+        RpcSlot *slot = &rpc_slots[i];
+        if (slot->state != RPC_SLOT_WAITING || slot->id != id ||
+            strncmp(slot->dest_mac, frame + PACKET_SRC_MAC_OFFSET, MAC_SIZE) != 0) {
+            continue;
+        }
+        if (header[0] == RPC_KIND_ERROR) {
+            rpc_finish(slot, (len > 0) ? -(int)header[MESH_RPC_HEADER_SIZE] : MESH_RPC_ERR_FAILED);
+        } else {
+            if (len > slot->response_size) {
+                len = slot->response_size;
+            }
+            memcpy(slot->response, header + MESH_RPC_HEADER_SIZE, len);
+            rpc_finish(slot, len);
+        }
+        break;
+    }
+    osMutexRelease(rpc_mutex);
+}
+
+// 根节点回应目标节点不在网络中，按请求包编号匹配
+static void rpc_handle_unreachable(const PacketBuf *buf) {
+    osMutexAcquire(rpc_mutex, osWaitForever);
+    for (int i = 0; i < MESH_RPC_MAX_PENDING; i++) {
+        RpcSlot *slot = &rpc_slots[i];
+        if (slot->state == RPC_SLOT_WAITING && memcmp(slot->num, buf->payload + PACKET_NUM_OFFSET, 3) == 0) {
+            rpc_finish(slot, MESH_RPC_ERR_UNREACHABLE);
+            break;
+        }
+    }
+    osMutexRelease(rpc_mutex);
+}
+
+// RPC端口的处理函数，在路由传输线程中调用：响应交给等待的调用方，请求放入请求队列
+static void rpc_port_handler(PacketBuf *buf) {
+    char status = buf->payload[PACKET_STATUS_OFFSET];
+    if (status == '1') {
+        return;  // 请求或响应的逐跳应答，RPC以响应为准
+    }
+    if (status == '2') {
+        rpc_handle_unreachable(buf);
+        return;
+    }
+    if (packet_data_len(buf) < MESH_RPC_HEADER_SIZE) {
+        return;
+    }
+    if (buf->payload[PACKET_DATA_OFFSET] != RPC_KIND_REQUEST) {
+        rpc_handle_response(buf);
+        return;
+    }
+    HAL_PacketBuf_Ref(buf);
+    if (osMessageQueuePut(rpc_request_queue, &buf, 0, 0) != osOK) {
+        LOG("RPC request queue is full.\n");
+        HAL_PacketBuf_Free(buf);
+    }
+}
+
+static int rpc_init(void) {
+    if (rpc_mutex != NULL) {
+        return 0;
+    }
+    rpc_request_queue = osMessageQueueNew(MESH_RPC_QUEUE_DEPTH, sizeof(PacketBuf *), NULL);
+    if (rpc_request_queue == NULL) {
+        LOG("Failed to init RPC.\n");
+        return -1;
+    }
+    for (int i = 0; i < MESH_RPC_MAX_PENDING; i++) {
+        rpc_slots[i].state = RPC_SLOT_FREE;
+        rpc_slots[i].done = osSemaphoreNew(1, 0, NULL);
+        if (rpc_slots[i].done == NULL) {
+            LOG("Failed to init RPC.\n");
+            return -1;
+        }
+    }
+    osMutexId_t mutex = osMutexNew(NULL);
+    if (mutex == NULL) {
+        LOG("Failed to init RPC.\n");
+        return -1;
+    }
+    rpc_mutex = mutex;
+    return set_port_handler(MESH_PORT_RPC, rpc_port_handler);
+}
+
+int mesh_rpc_register(uint8_t method, MeshRpcHandler handler, void *arg) {
+    if (rpc_init() != 0) {
+        return -1;
+    }
+    int ret = -1;
+    osMutexAcquire(rpc_mutex, osWaitForever);
+    RpcMethod *free_entry = NULL;
+    for (int i = 0; i < MESH_RPC_MAX_METHODS; i++) {
+        RpcMethod *m = &rpc_methods[i];
+        if (m->handler != NULL && m->method == method) {
+            free_entry = m;
+            break;
+        }
+        if (m->handler == NULL && free_entry == NULL) {
+            free_entry = m;
+        }
+    }
+    if (free_entry != NULL) {
+        free_entry->method = method;
+        free_entry->handler = handler;
+        free_entry->arg = arg;
+        ret = 0;
+    } else if (handler == NULL) {
+        ret = 0;  // 本来就没有注册
+    }
+    osMutexRelease(rpc_mutex);
+    return ret;
+}
+
+int mesh_rpc_call(const char *dest_mac, uint8_t method, const void *request, uint16_t request_len,
+                  void *response, uint16_t response_size, uint32_t timeout_ms) {
+    if (network_connected() != 1) {
+        LOG("Network is not connected.\n");
+        return MESH_RPC_ERR_FAILED;
+    }
+    if (dest_mac == NULL || strncmp(dest_mac, "FFFFFF", MAC_SIZE) == 0 || (request == NULL && request_len > 0) ||
+        request_len > MESH_RPC_MAX_DATA_LEN || (response == NULL && response_size > 0)) {
+        LOG("Invalid RPC call.\n");
+        return MESH_RPC_ERR_FAILED;
+    }
+    if (rpc_init() != 0) {
+        return MESH_RPC_ERR_FAILED;
+    }
+    PacketBuf *buf = alloc_data_packet(MESH_RPC_HEADER_SIZE + request_len);
+    if (buf == NULL) {
+        return MESH_RPC_ERR_FAILED;
+    }
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    fill_data_packet_header(buf, my_mac, dest_mac, PACKET_STATUS_NO_ACK);
+    buf->payload[PACKET_PORT_OFFSET] = (char)MESH_PORT_RPC;
+
+    // 先登记再发送，响应可能在发送函数返回前就到达
+    osMutexAcquire(rpc_mutex, osWaitForever);
+    RpcSlot *slot = NULL;
+    for (int i = 0; i < MESH_RPC_MAX_PENDING; i++) {
+        if (rpc_slots[i].state == RPC_SLOT_FREE) {
+            slot = &rpc_slots[i];
+            break;
+        }
+    }
+    if (slot == NULL) {
+        osMutexRelease(rpc_mutex);
+        HAL_PacketBuf_Free(buf);
+        LOG("Too many pending RPC calls.\n");
+        return MESH_RPC_ERR_FAILED;
+    }
+    uint16_t id = rpc_next_id;
+    rpc_next_id = (rpc_next_id == UINT16_MAX) ? 1 : rpc_next_id + 1;
+    slot->state = RPC_SLOT_WAITING;
+    slot->id = id;
+    strncpy(slot->dest_mac, dest_mac, MAC_SIZE);
+    slot->dest_mac[MAC_SIZE] = '\0';
+    memcpy(slot->num, buf->payload + PACKET_NUM_OFFSET, 3);
+    slot->response = response;
+    slot->response_size = response_size;
+    osMutexRelease(rpc_mutex);
+
+    uint8_t *header = (uint8_t *)buf->payload + PACKET_DATA_OFFSET;
+    header[0] = RPC_KIND_REQUEST;
+    header[1] = method;
+    header[2] = (uint8_t)(id >> 8);
+    header[3] = (uint8_t)(id & 0xFF);
+    if (request_len > 0) {
+        memcpy(header + MESH_RPC_HEADER_SIZE, request, request_len);
+    }
+    int ret = send_packet_buf_async(buf, NULL, NULL);
+    HAL_PacketBuf_Free(buf);
+
+    int signaled = 0;
+    if (ret == 0) {
+        uint32_t timeout = ((timeout_ms == 0) ? MESH_RPC_TIMEOUT_MS : timeout_ms) * osKernelGetTickFreq() / 1000;
+        signaled = (osSemaphoreAcquire(slot->done, timeout) == osOK);
+    }
+    osMutexAcquire(rpc_mutex, osWaitForever);
+    int result = (ret == 0) ? MESH_RPC_ERR_TIMEOUT : MESH_RPC_ERR_FAILED;
+    if (slot->state == RPC_SLOT_DONE) {
+        result = slot->result;
+        if (!signaled) {
+            osSemaphoreAcquire(slot->done, 0);  // 响应恰好在超时后到达，取走信号，下次调用不受影响
+        }
+    }
+    slot->state = RPC_SLOT_FREE;
+    osMutexRelease(rpc_mutex);
+    return result;
+}
+
+int mesh_rpc_serve(uint32_t timeout_ms) {
+    if (rpc_init() != 0) {
+        return -1;
+    }
+    PacketBuf *request = NULL;
+    uint32_t timeout = (timeout_ms == MESH_WAIT_FOREVER) ? osWaitForever : timeout_ms * osKernelGetTickFreq() / 1000;
+    if (osMessageQueueGet(rpc_request_queue, &request, NULL, timeout) != osOK) {
+        return -1;
+    }
+    const uint8_t *req_header = (const uint8_t *)request->payload + PACKET_DATA_OFFSET;
+    uint8_t method = req_header[1];
+    MeshRpcHandler handler = NULL;
+    void *arg = NULL;
+    osMutexAcquire(rpc_mutex, osWaitForever);
+    for (int i = 0; i < MESH_RPC_MAX_METHODS; i++) {
+        if (rpc_methods[i].handler != NULL && rpc_methods[i].method == method) {
+            handler = rpc_methods[i].handler;
+            arg = rpc_methods[i].arg;
+            break;
+        }
+    }
+    osMutexRelease(rpc_mutex);
+
+    // 处理函数直接把响应写在要发出的数据包中
+    PacketBuf *reply = alloc_data_packet(MESH_MAX_DATA_LEN);
+    if (reply == NULL) {
+        HAL_PacketBuf_Free(request);
+        return 0;  // 请求已取出，调用方会超时
+    }
+    char src_mac[MAC_SIZE + 1] = {0};
+    memcpy(src_mac, request->payload + PACKET_SRC_MAC_OFFSET, MAC_SIZE);
+    uint8_t *header = (uint8_t *)reply->payload + PACKET_DATA_OFFSET;
+    int len = MESH_RPC_ERR_NO_METHOD;
+    if (handler != NULL) {
+        len = handler(src_mac, req_header + MESH_RPC_HEADER_SIZE, packet_data_len(request) - MESH_RPC_HEADER_SIZE,
+                      header + MESH_RPC_HEADER_SIZE, MESH_RPC_MAX_DATA_LEN, arg);
+        if (len < 0 || len > MESH_RPC_MAX_DATA_LEN) {
+            len = MESH_RPC_ERR_HANDLER;
+        }
+    }
+    header[0] = RPC_KIND_RESPONSE;
+    if (len < 0) {
+        header[0] = RPC_KIND_ERROR;
+        header[MESH_RPC_HEADER_SIZE] = (uint8_t)(-len);
+        len = 1;
+    }
+    header[1] = method;
+    header[2] = req_header[2];
+    header[3] = req_header[3];
+    reply->len = PACKET_DATA_OFFSET + MESH_RPC_HEADER_SIZE + len;
+    reply->payload[reply->len] = '\0';
+    HAL_PacketBuf_Free(request);
+
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    fill_data_packet_header(reply, my_mac, src_mac, PACKET_STATUS_NO_ACK);
+    reply->payload[PACKET_PORT_OFFSET] = (char)MESH_PORT_RPC;
+    if (send_packet_buf_async(reply, NULL, NULL) != 0) {
+        LOG("Failed to send RPC response to %s.\n", src_mac);
+    }
+    HAL_PacketBuf_Free(reply);
+    return 0;
+}
+
+// 发布/订阅：发布包发往MESH_PORT_PUBSUB，数据位开头是主题长度和主题，格式见routing_transport.h
+static char subscriptions[MESH_MAX_SUBSCRIPTIONS][MESH_TOPIC_MAX_LEN + 1];  // 空字符串表示空位
+static osMutexId_t pubsub_mutex = NULL;     // 保护订阅表
+static osMessageQueueId_t pubsub_queue = NULL;
+
+// 是否订阅了该主题，需要持有pubsub_mutex
+static int find_subscription(const char *topic, uint8_t len) {
+    for (int i = 0; i < MESH_MAX_SUBSCRIPTIONS; i++) {
+        if (strlen(subscriptions[i]) == len && memcmp(subscriptions[i], topic, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// 订阅表变化后重新计算本节点的订阅摘要，需要持有pubsub_mutex
+static void update_subscriptions(void) {
+    uint32_t summary = 0;
+    for (int i = 0; i < MESH_MAX_SUBSCRIPTIONS; i++) {
+        if (subscriptions[i][0] != '\0') {
+            summary |= topic_summary_mask(subscriptions[i], (uint8_t)strlen(subscriptions[i]));
+        }
+    }
+    set_local_subscriptions(summary);
+}
+
+// 发布/订阅端口的处理函数，在路由传输线程中调用：订阅摘要可能误判，按完整主题过滤后放入接收队列
+static void pubsub_port_handler(PacketBuf *buf) {
+    if (buf->payload[PACKET_STATUS_OFFSET] != PACKET_STATUS_PUBLISH || packet_data_len(buf) < 1) {
+        return;
+    }
+    uint8_t topic_len = (uint8_t)buf->payload[PACKET_DATA_OFFSET];
+    if (topic_len == 0 || topic_len > MESH_TOPIC_MAX_LEN || packet_data_len(buf) < 1 + topic_len) {
+        return;
+    }
+    osMutexAcquire(pubsub_mutex, osWaitForever);
+    int found = find_subscription(buf->payload + PACKET_DATA_OFFSET + 1, topic_len);
+    osMutexRelease(pubsub_mutex);
+    if (found < 0) {
+        return;
+    }
+    HAL_PacketBuf_Ref(buf);
+    if (osMessageQueuePut(pubsub_queue, &buf, 0, 0) != osOK) {
+        LOG("Publish queue is full.\n");
+        HAL_PacketBuf_Free(buf);
+    }
+}
+
+static int pubsub_init(void) {
+    if (pubsub_mutex != NULL) {
+        return 0;
+    }
+    pubsub_queue = osMessageQueueNew(MESH_PUBSUB_QUEUE_DEPTH, sizeof(PacketBuf *), NULL);
+    if (pubsub_queue == NULL) {
+        LOG("Failed to init publish/subscribe.\n");
+        return -1;
+    }
+    osMutexId_t mutex = osMutexNew(NULL);
+    if (mutex == NULL) {
+        LOG("Failed to init publish/subscribe.\n");
+        return -1;
+    }
+    pubsub_mutex = mutex;
+    return set_port_handler(MESH_PORT_PUBSUB, pubsub_port_handler);
+}
+
+int mesh_subscribe(const char *topic) {
+    if (topic == NULL || topic[0] == '\0' || strlen(topic) > MESH_TOPIC_MAX_LEN) {
+        LOG("Invalid topic.\n");
+        return -1;
+    }
+    if (pubsub_init() != 0) {
+        return -1;
+    }
+    int ret = 0;
+    osMutexAcquire(pubsub_mutex, osWaitForever);
+    if (find_subscription(topic, (uint8_t)strlen(topic)) < 0) {
+        ret = -1;
+        for (int i = 0; i < MESH_MAX_SUBSCRIPTIONS; i++) {
+            if (subscriptions[i][0] == '\0') {
+                strcpy(subscriptions[i], topic);
+                update_subscriptions();
+                ret = 0;
+                break;
+            }
+        }
+    }
+    osMutexRelease(pubsub_mutex);
+    return ret;
+}
+
+int mesh_unsubscribe(const char *topic) {
+    if (topic == NULL || strlen(topic) > MESH_TOPIC_MAX_LEN || pubsub_mutex == NULL) {
+        return -1;
+    }
+    osMutexAcquire(pubsub_mutex, osWaitForever);
+    int index = find_subscription(topic, (uint8_t)strlen(topic));
+    if (index >= 0) {
+        subscriptions[index][0] = '\0';
+        update_subscriptions();
+    }
+    osMutexRelease(pubsub_mutex);
+    return (index >= 0) ? 0 : -1;
+}
+
+int mesh_publish(const char *topic, const void *data, uint16_t len) {
+    if (network_connected() != 1) {
+        LOG("Network is not connected.\n");
+        return -1;
+    }
+    size_t topic_len = (topic == NULL) ? 0 : strlen(topic);
+    if (topic_len == 0 || topic_len > MESH_TOPIC_MAX_LEN || (data == NULL && len > 0) ||
+        len > MESH_MAX_DATA_LEN - 1 - topic_len) {
+        LOG("Invalid publish.\n");
+        return -1;
+    }
+    PacketBuf *buf = alloc_data_packet((uint16_t)(1 + topic_len + len));
+    if (buf == NULL) {
+        return -1;
+    }
+    char *payload = buf->payload + PACKET_DATA_OFFSET;
+    payload[0] = (char)topic_len;
+    memcpy(payload + 1, topic, topic_len);
+    if (len > 0) {
+        memcpy(payload + 1 + topic_len, data, len);
+    }
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    int ret = 0;
+    if (g_mesh_config.tree_level == 0) {
+        // 如果自己是根节点，则直接向有订阅者的子树分发
+        fill_data_packet_header(buf, my_mac, "FFFFFF", PACKET_STATUS_PUBLISH);
+        buf->payload[PACKET_PORT_OFFSET] = (char)MESH_PORT_PUBSUB;
+        publish_data_packet(buf);
+    } else {
+        // 如果不是根节点，则向根节点发送发布请求，发布包不要求应答
+        fill_data_packet_header(buf, my_mac, "000000", PACKET_STATUS_PUBLISH_REQUEST);
+        buf->payload[PACKET_PORT_OFFSET] = (char)MESH_PORT_PUBSUB;
+        ret = send_packet_buf_async(buf, NULL, NULL);
+    }
+    HAL_PacketBuf_Free(buf);
+    return ret;
+}
+
+int mesh_recv_topic(char *topic, char *src_mac, void *buf, uint16_t buf_size, uint32_t timeout_ms) {
+    if (pubsub_init() != 0) {
+        return -1;
+    }
+    PacketBuf *packet = pop_data_packet(pubsub_queue, timeout_ms);
+    if (packet == NULL) {
+        return -1;
+    }
+    // 去掉主题后与普通数据包一样拷贝
+    uint8_t topic_len = (uint8_t)packet->payload[PACKET_DATA_OFFSET];
+    if (topic != NULL) {
+        memcpy(topic, packet->payload + PACKET_DATA_OFFSET + 1, topic_len);
+        topic[topic_len] = '\0';
+    }
+    if (src_mac != NULL) {
+        memcpy(src_mac, packet->payload + PACKET_SRC_MAC_OFFSET, MAC_SIZE);
+        src_mac[MAC_SIZE] = '\0';
+    }
+    uint16_t len = packet_data_len(packet) - 1 - topic_len;
+    if (len > buf_size) {
+        len = buf_size;
+    }
+    memcpy(buf, packet->payload + PACKET_DATA_OFFSET + 1 + topic_len, len);
+    HAL_PacketBuf_Free(packet);
+    return len;
+}
+
+int mesh_set_aggregation(int delay_ms, int threshold) {
+    if (delay_ms < 0 || threshold < 0) {
+        LOG("Invalid aggregation config!\n");
+        return -1;
+    }
+    TxAggregationConfig config;
+    config.delay_ms = (uint32_t)delay_ms;
+    config.threshold = (threshold > TX_BUNDLE_MAX_LEN) ? TX_BUNDLE_MAX_LEN : (uint16_t)threshold;
+    tx_engine_set_aggregation(&config);
+    return 0;
+}
+
+int mesh_set_subtree_weight(const char *child_mac, int weight) {
+    if (weight < 0 || weight > 255) {
+        LOG("Invalid weight: %d\n", weight);
+        return -1;
+    }
+    return tx_engine_set_fair_weight(child_mac, (uint8_t)weight);
+}
+
 int mesh_network_connected(void) {
     return network_connected();
 }
\ No newline at end of file
@@ -0,0 +1,794 @@
+#include <stdio.h>
+#include <string.h>
+#include "cmsis_os2.h"
+#include "network_fsm.h"
+#include "routing_transport.h"
+#include "hal_wireless.h"
+#include "hal_packet_buf.h"
+#include "mesh_api.h"
+
+// 定义宏开关，打开或关闭日志输出
+#define ENABLE_LOG 0  // 1 表示开启日志，0 表示关闭日志
+
+// 定义 LOG 宏，如果 ENABLE_LOG 为 1，则打印日志，并输出文件名、行号、日志内容
+#if ENABLE_LOG
+    #define LOG(fmt, ...) printf("LOG [%s:%d]: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+    #define LOG(fmt, ...) // 空实现，日志输出被禁用
+#endif
+
+/*
+ * 字节流：分段走MESH_PORT_STREAM端口，数据包状态为PACKET_STATUS_NO_ACK，由流自己确认。
+ * 数据位开头是流头：
+ * [0] 类型 [1] 流ID（发起方分配） [2] 发送方角色，'I'发起方 'L'接收方
+ * [3-4] 分段序号 [5-6] 确认号，即期望收到的下一个分段序号 [7] 接收窗口，还能接收的分段数量
+ * 序号按分段计数，建立连接的SYN和SYN-ACK、结束的FIN各占一个序号，与数据分段一起按序确认和重传。
+ * 接收方缓存窗口内乱序到达的分段，按序交给应用；发送方只重传最早一个未确认的分段，超时时间指数退避。
+ * 发送窗口取对方通告的接收窗口和拥塞窗口中较小的一个：拥塞窗口每收到一个窗口的确认加1，丢包时减半，
+ * 多跳路径上窗口会一直增长到填满路径；重传超时按测得的往返时间计算。
+ * 所有流保留的缓冲区合计不超过MESH_STREAM_BUF_QUOTA，超出时新分段等待、收到的分段丢弃由对方重传。
+ */
+#define STREAM_KIND_SYN         'S'
+#define STREAM_KIND_SYN_ACK     'Y'
+#define STREAM_KIND_DATA        'D'
+#define STREAM_KIND_ACK         'A'
+#define STREAM_KIND_FIN         'F'
+#define STREAM_KIND_RST         'R'
+
+#define STREAM_ROLE_INITIATOR   'I'
+#define STREAM_ROLE_LISTENER    'L'
+
+#define STREAM_TICK_MS          50      // 检查重传的周期
+#define STREAM_RTO_MS           500     // 还没有测到往返时间时的重传超时
+#define STREAM_MIN_RTO_MS       100     // 按往返时间计算的重传超时下限
+#define STREAM_INITIAL_WINDOW   2       // 初始拥塞窗口
+#define STREAM_MAX_RTO_MS       4000    // 退避后的最长重传超时
+#define STREAM_MAX_RETRIES      8       // 同一分段连续重传这么多次仍没有收到对方的任何分段，视为连接断开
+#define STREAM_LINGER_MS        3000    // 关闭时等待对方确认剩余数据的时间
+#define STREAM_DUP_ACK_RETRANSMIT 2     // 连续收到这么多个重复确认时立即重传，不等超时
+
+// 等待的事件
+#define STREAM_EVENT_READ       (1 << 0)    // 有数据可读
+#define STREAM_EVENT_WRITE      (1 << 1)    // 发送窗口有空位或数据已被确认
+#define STREAM_EVENT_STATE      (1 << 2)    // 连接建立、断开
+#define STREAM_EVENT_ALL        (STREAM_EVENT_READ | STREAM_EVENT_WRITE | STREAM_EVENT_STATE)
+
+typedef enum {
+    STREAM_FREE = 0,
+    STREAM_SYN_SENT,            // 发起方已发出SYN，等待SYN-ACK
+    STREAM_ESTABLISHED,         // 可以收发数据
+    STREAM_RESET,               // 对方复位或重传超时，等待应用关闭
+} StreamState;
+
+typedef struct {
+    StreamState state;
+    char peer_mac[MAC_SIZE + 1];
+    uint8_t id;
+    uint8_t initiator;          // 1 表示本节点是发起方
+    uint8_t fin_sent;
+    // 发送方向
+    uint16_t snd_una;           // 最早未确认的分段序号
+    uint16_t snd_nxt;           // 下一个分段序号
+    uint8_t peer_window;        // 对方最近通告的接收窗口
+    uint8_t retries;            // snd_una的连续重传次数
+    uint8_t dup_acks;           // 连续收到的重复确认数量，说明后面的分段到了、snd_una丢了
+    uint8_t cwnd;               // 拥塞窗口
+    uint8_t cwnd_acked;         // 当前拥塞窗口内已确认的分段数量，满一个窗口后窗口加1
+    uint8_t rtt_timing;         // 1 表示正在测量rtt_seq的往返时间
+    uint16_t rtt_seq;           // 正在测量往返时间的分段序号
+    uint32_t rtt_start;         // rtt_seq首次发送的时间
+    uint32_t srtt;              // 平滑往返时间（tick），0 表示还没有测到
+    uint32_t rttvar;            // 往返时间的平均偏差（tick）
+    uint32_t base_rto;          // 按往返时间计算的重传超时（tick）
+    uint32_t rto;               // 当前重传超时，退避后会大于base_rto（tick）
+    uint32_t sent_at;           // snd_una最近一次发送的时间
+    PacketBuf *snd_buf[MESH_STREAM_MAX_WINDOW];  // 未确认的分段，按序号取模存放
+    // 接收方向
+    uint16_t rcv_read;          // 应用下一个要读取的分段序号
+    uint16_t rcv_nxt;           // 期望收到的下一个分段序号，之前的都已按序到达
+    uint16_t read_offset;       // rcv_read分段中已经读取的字节数
+    uint8_t rcv_held;           // rcv_buf中保留的分段数量
+    PacketBuf *rcv_buf[MESH_STREAM_MAX_WINDOW];  // 已收到、尚未读取的分段，按序号取模存放
+    osEventFlagsId_t events;
+} Stream;
+
+static Stream streams[MESH_MAX_STREAMS];
+static osMutexId_t stream_mutex = NULL;     // 保护所有流，应用线程、路由传输线程和定时器线程都会访问
+static osTimerId_t stream_timer = NULL;
+static osMessageQueueId_t accept_queue = NULL;
+static int stream_listening = 0;
+static uint8_t stream_next_id = 0;
+static int stream_bufs_held = 0;            // 所有流的snd_buf和rcv_buf中保留的缓冲区数量
+
+static uint16_t segment_len(const PacketBuf *buf) {
+    return (buf->len > PACKET_DATA_OFFSET + MESH_STREAM_HEADER_SIZE) ?
+           buf->len - PACKET_DATA_OFFSET - MESH_STREAM_HEADER_SIZE : 0;
+}
+
+static uint8_t *stream_header(const PacketBuf *buf) {
+    return (uint8_t *)buf->payload + PACKET_DATA_OFFSET;
+}
+
+static uint16_t read_u16(const uint8_t *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void write_u16(uint8_t *p, uint16_t value) {
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)(value & 0xFF);
+}
+
+static void signal_stream(Stream *s, uint32_t events) {
+    osEventFlagsSet(s->events, events);
+}
+
+// 能否再保留一个缓冲区，held为该流该方向已保留的数量，需要持有stream_mutex
+// 合计不超过MESH_STREAM_BUF_QUOTA，每个方向保底一个，一个流不读数据不会让其他流完全停住
+static int stream_buf_allowed(int held) {
+    return held == 0 || stream_bufs_held < MESH_STREAM_BUF_QUOTA;
+}
+
+static void free_stream_buf(PacketBuf **slot) {
+    if (*slot != NULL) {
+        HAL_PacketBuf_Free(*slot);
+        *slot = NULL;
+        stream_bufs_held--;
+    }
+}
+
+// 通告的接收窗口：缓存的空位，并且不超过还能保留的缓冲区数量
+static uint8_t receive_window(const Stream *s) {
+    int window = MESH_STREAM_MAX_WINDOW - (uint16_t)(s->rcv_nxt - s->rcv_read);
+    int quota = MESH_STREAM_BUF_QUOTA - stream_bufs_held;
+    if (quota < 1 && s->rcv_held == 0) {
+        quota = 1;
+    }
+    if (quota < window) {
+        window = quota;
+    }
+    return (uint8_t)((window > 0) ? window : 0);
+}
+
+// 重传最早一个未确认的分段，需要持有stream_mutex
+// 保留的原缓冲区可能还在发送引擎的队列中或正在发送，不能改写或重复入队，拷贝一份写入最新的确认号和接收窗口
+static void retransmit_segment(Stream *s) {
+    const PacketBuf *orig = s->snd_buf[s->snd_una % MESH_STREAM_MAX_WINDOW];
+    PacketBuf *buf = HAL_PacketBuf_Alloc(orig->len);
+    if (buf == NULL) {
+        return;  // 内存池暂时耗尽，下一次超时再重传
+    }
+    memcpy(buf->payload, orig->payload, orig->len);
+    uint8_t *header = stream_header(buf);
+    write_u16(header + 5, s->rcv_nxt);
+    header[7] = receive_window(s);
+    send_packet_buf_async(buf, NULL, NULL);
+    HAL_PacketBuf_Free(buf);
+}
+
+// 创建一个分段，填好数据包帧头和流头，数据由调用方写入
+static PacketBuf *build_segment(const char *peer_mac, uint8_t id, char role, char kind,
+                                uint16_t seq, uint16_t ack, uint8_t window, uint16_t len) {
+    PacketBuf *buf = alloc_data_packet(MESH_STREAM_HEADER_SIZE + len);
+    if (buf == NULL) {
+        return NULL;
+    }
+    char my_mac[MAC_SIZE + 1] = {0};
+    HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac);
+    fill_data_packet_header(buf, my_mac, peer_mac, PACKET_STATUS_NO_ACK);
+    buf->payload[PACKET_PORT_OFFSET] = (char)MESH_PORT_STREAM;
+    uint8_t *header = stream_header(buf);
+    header[0] = (uint8_t)kind;
+    header[1] = id;
+    header[2] = (uint8_t)role;
+    write_u16(header + 3, seq);
+    write_u16(header + 5, ack);
+    header[7] = window;
+    return buf;
+}
+
+static char stream_role(const Stream *s) {
+    return s->initiator ? STREAM_ROLE_INITIATOR : STREAM_ROLE_LISTENER;
+}
+
+// 发送不占序号的确认或复位，丢失了也没关系，对方重传时会再次发送
+static void send_control(Stream *s, char kind) {
+    PacketBuf *buf = build_segment(s->peer_mac, s->id, stream_role(s), kind, s->snd_nxt, s->rcv_nxt,
+                                   receive_window(s), 0);
+    if (buf == NULL) {
+        return;
+    }
+    send_packet_buf_async(buf, NULL, NULL);
+    HAL_PacketBuf_Free(buf);
+}
+
+// 回应不属于任何流的分段
+static void send_reset(const char *peer_mac, uint8_t id, char role) {
+    PacketBuf *buf = build_segment(peer_mac, id, role, STREAM_KIND_RST, 0, 0, 0, 0);
+    if (buf == NULL) {
+        return;
+    }
+    send_packet_buf_async(buf, NULL, NULL);
+    HAL_PacketBuf_Free(buf);
+}
+
+// 发出一个占序号的分段，保留引用用于重传；需要持有stream_mutex，调用方已确认发送窗口有空位
+// 返回-1表示内存池耗尽或已达到缓冲区上限
+static int queue_segment(Stream *s, char kind, const void *data, uint16_t len) {
+    if (!stream_buf_allowed((uint16_t)(s->snd_nxt - s->snd_una))) {
+        return -1;
+    }
+    PacketBuf *buf = build_segment(s->peer_mac, s->id, stream_role(s), kind, s->snd_nxt, s->rcv_nxt,
+                                   receive_window(s), len);
+    if (buf == NULL) {
+        return -1;
+    }
+    if (len > 0) {
+        memcpy(stream_header(buf) + MESH_STREAM_HEADER_SIZE, data, len);
+    }
+    s->snd_buf[s->snd_nxt % MESH_STREAM_MAX_WINDOW] = buf;
+    stream_bufs_held++;
+    if (s->snd_una == s->snd_nxt) {
+        s->sent_at = osKernelGetTickCount();
+    }
+    // 每次只测量一个分段的往返时间
+    if (!s->rtt_timing) {
+        s->rtt_timing = 1;
+        s->rtt_seq = s->snd_nxt;
+        s->rtt_start = osKernelGetTickCount();
+    }
+    s->snd_nxt++;
+    // 发送队列已满时不立即重试，由重传定时器补发
+    send_packet_buf_async(buf, NULL, NULL);
+    return 0;
+}
+
+// 本节点当前可以发出的分段数量；对方窗口为0时仍允许一个分段在途，作为窗口探测
+static int send_window_free(const Stream *s) {
+    int window = (s->peer_window < s->cwnd) ? s->peer_window : s->cwnd;
+    if (window == 0) {
+        window = 1;
+    }
+    return window - (uint16_t)(s->snd_nxt - s->snd_una);
+}
+
+static void release_stream(Stream *s) {
+    for (int i = 0; i < MESH_STREAM_MAX_WINDOW; i++) {
+        free_stream_buf(&s->snd_buf[i]);
+        free_stream_buf(&s->rcv_buf[i]);
+    }
+    s->rcv_held = 0;
+    s->state = STREAM_FREE;
+}
+
+static void reset_stream(Stream *s) {
+    s->state = STREAM_RESET;
+    signal_stream(s, STREAM_EVENT_ALL);
+}
+
+static Stream *alloc_stream(const char *peer_mac, uint8_t id, uint8_t initiator) {
+    for (int i = 0; i < MESH_MAX_STREAMS; i++) {
+        Stream *s = &streams[i];
+        if (s->state != STREAM_FREE) {
+            continue;
+        }
+        strncpy(s->peer_mac, peer_mac, MAC_SIZE);
+        s->peer_mac[MAC_SIZE] = '\0';
+        s->id = id;
+        s->initiator = initiator;
+        s->fin_sent = 0;
+        s->snd_una = 0;
+        s->snd_nxt = 0;
+        s->peer_window = MESH_STREAM_MAX_WINDOW;
+        s->retries = 0;
+        s->dup_acks = 0;
+        s->cwnd = STREAM_INITIAL_WINDOW;
+        s->cwnd_acked = 0;
+        s->rtt_timing = 0;
+        s->srtt = 0;
+        s->rttvar = 0;
+        s->base_rto = STREAM_RTO_MS * osKernelGetTickFreq() / 1000;
+        s->rto = s->base_rto;
+        s->rcv_read = 0;
+        s->rcv_nxt = 0;
+        s->read_offset = 0;
+        s->rcv_held = 0;
+        osEventFlagsClear(s->events, STREAM_EVENT_ALL);
+        return s;
+    }
+    return NULL;
+}
+
+static Stream *find_stream(const char *peer_mac, uint8_t id, uint8_t initiator) {
+    for (int i = 0; i < MESH_MAX_STREAMS; i++) {
+        Stream *s = &streams[i];
+        if (s->state != STREAM_FREE && s->id == id && s->initiator == initiator &&
+            strncmp(s->peer_mac, peer_mac, MAC_SIZE) == 0) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+// 用一次往返时间的测量值更新重传超时，算法与TCP相同：RTO = SRTT + 4 * RTTVAR
+static void update_rtt(Stream *s, uint32_t sample) {
+    if (sample == 0) {
+        sample = 1;
+    }
+    if (s->srtt == 0) {
+        s->srtt = sample;
+        s->rttvar = sample / 2;
+    } else {
+        uint32_t delta = (s->srtt > sample) ? s->srtt - sample : sample - s->srtt;
+        s->rttvar = (3 * s->rttvar + delta) / 4;
+        s->srtt = (7 * s->srtt + sample) / 8;
+    }
+    uint32_t rto = s->srtt + ((s->rttvar > 0) ? 4 * s->rttvar : 1);
+    uint32_t min_rto = STREAM_MIN_RTO_MS * osKernelGetTickFreq() / 1000;
+    uint32_t max_rto = STREAM_MAX_RTO_MS * osKernelGetTickFreq() / 1000;
+    s->base_rto = (rto < min_rto) ? min_rto : ((rto > max_rto) ? max_rto : rto);
+}
+
+// 出现丢包时拥塞窗口减半，超时说明路径上积压严重，窗口退回1
+static void reduce_window(Stream *s, int timeout) {
+    s->cwnd = (timeout || s->cwnd < 2) ? 1 : s->cwnd / 2;
+    s->cwnd_acked = 0;
+    s->rtt_timing = 0;  // 重传过的分段不用来测量往返时间
+}
+
+// 处理对方的确认号和接收窗口，释放已确认的分段；pure_ack表示不携带数据的确认分段
+static void process_ack(Stream *s, uint16_t ack, uint8_t window, int pure_ack) {
+    uint16_t acked = (uint16_t)(ack - s->snd_una);
+    if (acked > (uint16_t)(s->snd_nxt - s->snd_una)) {
+        return;  // 过期的确认
+    }
+    s->peer_window = window;
+    if (acked == 0) {
+        // 对方收到了乱序的分段，最早的分段很可能丢了，快速重传
+        if (pure_ack && s->snd_una != s->snd_nxt && ++s->dup_acks == STREAM_DUP_ACK_RETRANSMIT) {
+            reduce_window(s, 0);
+            retransmit_segment(s);
+            s->sent_at = osKernelGetTickCount();
+        }
+        signal_stream(s, STREAM_EVENT_WRITE);  // 窗口可能变大了
+        return;
+    }
+    s->dup_acks = 0;
+    uint32_t now = osKernelGetTickCount();
+    if (s->rtt_timing && (uint16_t)(s->rtt_seq - s->snd_una) < acked) {
+        update_rtt(s, now - s->rtt_start);
+        s->rtt_timing = 0;
+    }
+    while (s->snd_una != ack) {
+        free_stream_buf(&s->snd_buf[s->snd_una % MESH_STREAM_MAX_WINDOW]);
+        s->snd_una++;
+    }
+    // 每确认一个窗口的分段，拥塞窗口加1
+    s->cwnd_acked += (uint8_t)acked;
+    if (s->cwnd_acked >= s->cwnd) {
+        s->cwnd_acked = 0;
+        if (s->cwnd < MESH_STREAM_MAX_WINDOW) {
+            s->cwnd++;
+        }
+    }
+    s->rto = s->base_rto;
+    s->sent_at = now;
+    // 发起方的SYN被确认，连接建立
+    if (s->state == STREAM_SYN_SENT) {
+        s->state = STREAM_ESTABLISHED;
+        signal_stream(s, STREAM_EVENT_STATE);
+    }
+    signal_stream(s, STREAM_EVENT_WRITE);
+}
+
+// 收下一个占序号的分段，窗口内乱序到达的先缓存，按序到达后交给应用
+static void receive_segment(Stream *s, PacketBuf *buf, uint16_t seq) {
+    uint16_t offset = (uint16_t)(seq - s->rcv_read);
+    if (offset >= MESH_STREAM_MAX_WINDOW || (uint16_t)(seq - s->rcv_nxt) >= MESH_STREAM_MAX_WINDOW) {
+        return;  // 重复的分段，或者窗口已满，回应确认即可
+    }
+    PacketBuf **slot = &s->rcv_buf[seq % MESH_STREAM_MAX_WINDOW];
+    if (*slot == NULL) {
+        if (!stream_buf_allowed(s->rcv_held)) {
+            return;  // 已达到缓冲区上限，对方重传
+        }
+        HAL_PacketBuf_Ref(buf);
+        *slot = buf;
+        s->rcv_held++;
+        stream_bufs_held++;
+    }
+    int delivered = 0;
+    while ((uint16_t)(s->rcv_nxt - s->rcv_read) < MESH_STREAM_MAX_WINDOW &&
+           s->rcv_buf[s->rcv_nxt % MESH_STREAM_MAX_WINDOW] != NULL) {
+        PacketBuf **next = &s->rcv_buf[s->rcv_nxt % MESH_STREAM_MAX_WINDOW];
+        s->rcv_nxt++;
+        // SYN-ACK只用于建立连接，按序到达后直接丢掉，不交给应用
+        if (stream_header(*next)[0] == STREAM_KIND_SYN_ACK && s->rcv_read == (uint16_t)(s->rcv_nxt - 1)) {
+            free_stream_buf(next);
+            s->rcv_held--;
+            s->rcv_read++;
+            continue;
+        }
+        delivered = 1;
+    }
+    if (delivered) {
+        signal_stream(s, STREAM_EVENT_READ);
+    }
+}
+
+// 接收方收到新连接的SYN，需要持有stream_mutex
+static void accept_syn(const char *peer_mac, uint8_t id) {
+    Stream *s = stream_listening ? alloc_stream(peer_mac, id, 0) : NULL;
+    if (s == NULL) {
+        LOG("Refusing stream %d from %s.\n", id, peer_mac);
+        send_reset(peer_mac, id, STREAM_ROLE_LISTENER);
+        return;
+    }
+    // SYN占用了对方的序号0，接收方的SYN-ACK占用自己的序号0，数据都从1开始
+    s->rcv_read = 1;
+    s->rcv_nxt = 1;
+    s->state = STREAM_ESTABLISHED;
+    int handle = (int)(s - streams);
+    if (queue_segment(s, STREAM_KIND_SYN_ACK, NULL, 0) != 0 ||
+        osMessageQueuePut(accept_queue, &handle, 0, 0) != osOK) {
+        send_reset(peer_mac, id, STREAM_ROLE_LISTENER);
+        release_stream(s);
+    }
+}
+
+// 根节点回应目标节点不在网络中，按数据包编号找到对应的流
+static void handle_unreachable(const PacketBuf *buf) {
+    for (int i = 0; i < MESH_MAX_STREAMS; i++) {
+        Stream *s = &streams[i];
+        if (s->state != STREAM_SYN_SENT && s->state != STREAM_ESTABLISHED) {
+            continue;
+        }
+        for (int j = 0; j < MESH_STREAM_MAX_WINDOW; j++) {
+            if (s->snd_buf[j] != NULL &&
+                memcmp(s->snd_buf[j]->payload + PACKET_NUM_OFFSET, buf->payload + PACKET_NUM_OFFSET, 3) == 0) {
+                reset_stream(s);
+                return;
+            }
+        }
+    }
+}
+
+// 流端口的处理函数，在路由传输线程中调用
+static void stream_port_handler(PacketBuf *buf) {
+    char status = buf->payload[PACKET_STATUS_OFFSET];
+    if (buf->len < PACKET_DATA_OFFSET + MESH_STREAM_HEADER_SIZE && status != '2') {
+        return;
+    }
+    osMutexAcquire(stream_mutex, osWaitForever);
+    if (status == '2') {
+        handle_unreachable(buf);
+        osMutexRelease(stream_mutex);
+        return;
+    }
+    const uint8_t *header = stream_header(buf);
+    char kind = (char)header[0];
+    uint8_t id = header[1];
+    uint8_t initiator = (header[2] == STREAM_ROLE_LISTENER);  // 对方是接收方，说明本节点是发起方
+    uint16_t seq = read_u16(header + 3);
+    const char *peer_mac = buf->payload + PACKET_SRC_MAC_OFFSET;
+    Stream *s = find_stream(peer_mac, id, initiator);
+    if (s == NULL) {
+        char mac[MAC_SIZE + 1] = {0};
+        memcpy(mac, peer_mac, MAC_SIZE);
+        if (kind == STREAM_KIND_SYN && !initiator) {
+            accept_syn(mac, id);
+        } else if (kind != STREAM_KIND_RST) {
+            send_reset(mac, id, initiator ? STREAM_ROLE_INITIATOR : STREAM_ROLE_LISTENER);
+        }
+        osMutexRelease(stream_mutex);
+        return;
+    }
+    if (kind == STREAM_KIND_RST) {
+        reset_stream(s);
+        osMutexRelease(stream_mutex);
+        return;
+    }
+    if (s->state == STREAM_RESET) {
+        osMutexRelease(stream_mutex);
+        return;
+    }
+    // 收到对方的任何分段说明连接还在，重新开始计算重传次数
+    s->retries = 0;
+    process_ack(s, read_u16(header + 5), header[7], kind == STREAM_KIND_ACK);
+    if (kind == STREAM_KIND_DATA || kind == STREAM_KIND_FIN || kind == STREAM_KIND_SYN_ACK) {
+        receive_segment(s, buf, seq);
+        send_control(s, STREAM_KIND_ACK);
+    } else if (kind == STREAM_KIND_SYN) {
+        send_control(s, STREAM_KIND_ACK);  // 重传的SYN，SYN-ACK由重传定时器补发
+    }
+    osMutexRelease(stream_mutex);
+}
+
+// 重传最早一个未确认的分段，在定时器线程中调用
+static void stream_tick(void *arg) {
+    (void)arg;
+    uint32_t now = osKernelGetTickCount();
+    osMutexAcquire(stream_mutex, osWaitForever);
+    for (int i = 0; i < MESH_MAX_STREAMS; i++) {
+        Stream *s = &streams[i];
+        if ((s->state != STREAM_SYN_SENT && s->state != STREAM_ESTABLISHED) || s->snd_una == s->snd_nxt ||
+            now - s->sent_at < s->rto) {
+            continue;
+        }
+        if (s->retries >= STREAM_MAX_RETRIES) {
+            LOG("Stream %d to %s timed out.\n", s->id, s->peer_mac);
+            reset_stream(s);
+            continue;
+        }
+        reduce_window(s, 1);
+        retransmit_segment(s);
+        s->retries++;
+        s->sent_at = now;
+        uint32_t max_rto = STREAM_MAX_RTO_MS * osKernelGetTickFreq() / 1000;
+        s->rto = (s->rto * 2 > max_rto) ? max_rto : s->rto * 2;
+    }
+    osMutexRelease(stream_mutex);
+}
+
+static int stream_init(void) {
+    if (stream_mutex != NULL) {
+        return 0;
+    }
+    accept_queue = osMessageQueueNew(MESH_MAX_STREAMS, sizeof(int), NULL);
+    stream_timer = osTimerNew(stream_tick, osTimerPeriodic, NULL, NULL);
+    if (accept_queue == NULL || stream_timer == NULL) {
+        LOG("Failed to init stream.\n");
+        return -1;
+    }
+    for (int i = 0; i < MESH_MAX_STREAMS; i++) {
+        streams[i].state = STREAM_FREE;
+        streams[i].events = osEventFlagsNew(NULL);
+        if (streams[i].events == NULL) {
+            LOG("Failed to init stream.\n");
+            return -1;
+        }
+    }
+    osMutexId_t mutex = osMutexNew(NULL);
+    if (mutex == NULL) {
+        LOG("Failed to init stream.\n");
+        return -1;
+    }
+    stream_mutex = mutex;
+    osTimerStart(stream_timer, STREAM_TICK_MS * osKernelGetTickFreq() / 1000);
+    return set_port_handler(MESH_PORT_STREAM, stream_port_handler);
+}
+
+static uint32_t ms_to_ticks(uint32_t timeout_ms) {
+    return (timeout_ms == MESH_WAIT_FOREVER) ? osWaitForever : timeout_ms * osKernelGetTickFreq() / 1000;
+}
+
+// 等待事件直到截止时间，返回0表示等到了事件，-1表示超时
+static int wait_stream(Stream *s, uint32_t events, uint32_t start, uint32_t timeout) {
+    uint32_t wait = timeout;
+    if (timeout != osWaitForever) {
+        uint32_t elapsed = osKernelGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return -1;
+        }
+        wait = timeout - elapsed;
+    }
+    uint32_t flags = osEventFlagsWait(s->events, events, osFlagsWaitAny, wait);
+    return (flags & osFlagsError) ? -1 : 0;
+}
+
+// 检查句柄并加锁，句柄无效时返回NULL且不持有锁
+static Stream *lock_stream(int handle) {
+    if (stream_mutex == NULL || handle < 0 || handle >= MESH_MAX_STREAMS) {
+        return NULL;
+    }
+    osMutexAcquire(stream_mutex, osWaitForever);
+    if (streams[handle].state == STREAM_FREE) {
+        osMutexRelease(stream_mutex);
+        return NULL;
+    }
+    return &streams[handle];
+}
+
+int mesh_stream_open(const char *dest_mac, uint32_t timeout_ms) {
+    if (network_connected() != 1) {
+        LOG("Network is not connected.\n");
+        return MESH_STREAM_ERR_FAILED;
+    }
+    if (dest_mac == NULL || strncmp(dest_mac, "FFFFFF", MAC_SIZE) == 0 || stream_init() != 0) {
+        return MESH_STREAM_ERR_FAILED;
+    }
+    osMutexAcquire(stream_mutex, osWaitForever);
+    Stream *s = alloc_stream(dest_mac, stream_next_id++, 1);
+    if (s == NULL) {
+        osMutexRelease(stream_mutex);
+        LOG("Too many streams.\n");
+        return MESH_STREAM_ERR_FAILED;
+    }
+    s->state = STREAM_SYN_SENT;
+    if (queue_segment(s, STREAM_KIND_SYN, NULL, 0) != 0) {
+        release_stream(s);
+        osMutexRelease(stream_mutex);
+        return MESH_STREAM_ERR_FAILED;
+    }
+    osMutexRelease(stream_mutex);
+
+    int handle = (int)(s - streams);
+    uint32_t start = osKernelGetTickCount();
+    uint32_t timeout = ms_to_ticks((timeout_ms == 0) ? MESH_STREAM_TIMEOUT_MS : timeout_ms);
+    while (1) {
+        osMutexAcquire(stream_mutex, osWaitForever);
+        StreamState state = s->state;
+        if (state != STREAM_SYN_SENT) {
+            if (state != STREAM_ESTABLISHED) {
+                release_stream(s);
+            }
+            osMutexRelease(stream_mutex);
+            return (state == STREAM_ESTABLISHED) ? handle : MESH_STREAM_ERR_FAILED;
+        }
+        osMutexRelease(stream_mutex);
+        if (wait_stream(s, STREAM_EVENT_STATE, start, timeout) != 0) {
+            osMutexAcquire(stream_mutex, osWaitForever);
+            if (s->state == STREAM_ESTABLISHED) {
+                osMutexRelease(stream_mutex);
+                return handle;
+            }
+            release_stream(s);
+            osMutexRelease(stream_mutex);
+            return MESH_STREAM_ERR_TIMEOUT;
+        }
+    }
+}
+
+int mesh_stream_listen(void) {
+    if (stream_init() != 0) {
+        return -1;
+    }
+    stream_listening = 1;
+    return 0;
+}
+
+int mesh_stream_accept(char *peer_mac, uint32_t timeout_ms) {
+    if (stream_mutex == NULL || !stream_listening) {
+        return MESH_STREAM_ERR_FAILED;
+    }
+    int handle = -1;
+    if (osMessageQueueGet(accept_queue, &handle, NULL, ms_to_ticks(timeout_ms)) != osOK) {
+        return MESH_STREAM_ERR_TIMEOUT;
+    }
+    if (peer_mac != NULL) {
+        osMutexAcquire(stream_mutex, osWaitForever);
+        strncpy(peer_mac, streams[handle].peer_mac, MAC_SIZE);
+        peer_mac[MAC_SIZE] = '\0';
+        osMutexRelease(stream_mutex);
+    }
+    return handle;
+}
+
+int mesh_stream_write(int handle, const void *data, uint32_t len, uint32_t timeout_ms) {
+    if (data == NULL && len > 0) {
+        return MESH_STREAM_ERR_FAILED;
+    }
+    uint32_t written = 0;
+    uint32_t start = osKernelGetTickCount();
+    uint32_t timeout = ms_to_ticks(timeout_ms);
+    while (written < len) {
+        Stream *s = lock_stream(handle);
+        if (s == NULL) {
+            return MESH_STREAM_ERR_FAILED;
+        }
+        if (s->state != STREAM_ESTABLISHED || s->fin_sent) {
+            osMutexRelease(stream_mutex);
+            return (written > 0) ? (int)written : MESH_STREAM_ERR_FAILED;
+        }
+        // 发送窗口有空位时把数据切成分段发出，没有空位时等待对方确认
+        int starved = 0;
+        while (written < len && send_window_free(s) > 0) {
+            uint16_t chunk = (len - written > MESH_STREAM_SEGMENT_SIZE) ? MESH_STREAM_SEGMENT_SIZE : (uint16_t)(len - written);
+            if (queue_segment(s, STREAM_KIND_DATA, (const uint8_t *)data + written, chunk) != 0) {
+                starved = 1;
+                break;
+            }
+            written += chunk;
+        }
+        osMutexRelease(stream_mutex);
+        if (written >= len) {
+            break;
+        }
+        if (starved) {
+            // 内存池暂时耗尽，不一定有确认会来唤醒，隔一会儿再试
+            if (timeout != osWaitForever && osKernelGetTickCount() - start >= timeout) {
+                return (written > 0) ? (int)written : MESH_STREAM_ERR_TIMEOUT;
+            }
+            osDelay(STREAM_TICK_MS * osKernelGetTickFreq() / 1000);
+            continue;
+        }
+        if (wait_stream(s, STREAM_EVENT_WRITE | STREAM_EVENT_STATE, start, timeout) != 0) {
+            return (written > 0) ? (int)written : MESH_STREAM_ERR_TIMEOUT;
+        }
+    }
+    return (int)written;
+}
+
+int mesh_stream_read(int handle, void *buf, uint32_t size, uint32_t timeout_ms) {
+    if (buf == NULL || size == 0) {
+        return MESH_STREAM_ERR_FAILED;
+    }
+    uint32_t start = osKernelGetTickCount();
+    uint32_t timeout = ms_to_ticks(timeout_ms);
+    while (1) {
+        Stream *s = lock_stream(handle);
+        if (s == NULL) {
+            return MESH_STREAM_ERR_FAILED;
+        }
+        uint32_t copied = 0;
+        int eof = 0;
+        int window_was_closed = (receive_window(s) == 0);
+        // 从最早的分段开始拷贝，一次可以读完多个分段
+        while (copied < size && s->rcv_read != s->rcv_nxt) {
+            PacketBuf **slot = &s->rcv_buf[s->rcv_read % MESH_STREAM_MAX_WINDOW];
+            if (stream_header(*slot)[0] == STREAM_KIND_FIN) {
+                eof = 1;  // FIN保留在队首，之后的读取都返回0
+                break;
+            }
+            uint16_t available = segment_len(*slot) - s->read_offset;
+            uint16_t n = (size - copied < available) ? (uint16_t)(size - copied) : available;
+            memcpy((uint8_t *)buf + copied, stream_header(*slot) + MESH_STREAM_HEADER_SIZE + s->read_offset, n);
+            copied += n;
+            s->read_offset += n;
+            if (s->read_offset == segment_len(*slot)) {
+                free_stream_buf(slot);
+                s->rcv_held--;
+                s->rcv_read++;
+                s->read_offset = 0;
+            }
+        }
+        // 窗口重新打开时主动通告，对方不用等到下一次窗口探测
+        if (window_was_closed && receive_window(s) > 0 && s->state == STREAM_ESTABLISHED) {
+            send_control(s, STREAM_KIND_ACK);
+        }
+        StreamState state = s->state;
+        osMutexRelease(stream_mutex);
+        if (copied > 0) {
+            return (int)copied;
+        }
+        if (eof) {
+            return 0;
+        }
+        if (state == STREAM_RESET) {
+            return MESH_STREAM_ERR_FAILED;
+        }
+        if (wait_stream(s, STREAM_EVENT_READ | STREAM_EVENT_STATE, start, timeout) != 0) {
+            return MESH_STREAM_ERR_TIMEOUT;
+        }
+    }
+}
+
+int mesh_stream_close(int handle) {
+    Stream *s = lock_stream(handle);
+    if (s == NULL) {
+        return MESH_STREAM_ERR_FAILED;
+    }
+    uint32_t start = osKernelGetTickCount();
+    uint32_t timeout = STREAM_LINGER_MS * osKernelGetTickFreq() / 1000;
+    int ret = 0;
+    // 发出FIN并等待对方确认所有数据，超时后直接释放
+    while (s->state == STREAM_ESTABLISHED && (!s->fin_sent || s->snd_una != s->snd_nxt)) {
+        if (!s->fin_sent && send_window_free(s) > 0 &&
+            queue_segment(s, STREAM_KIND_FIN, NULL, 0) == 0) {
+            s->fin_sent = 1;
+            continue;
+        }
+        osMutexRelease(stream_mutex);
+        int timed_out = wait_stream(s, STREAM_EVENT_WRITE | STREAM_EVENT_STATE, start, timeout);
+        osMutexAcquire(stream_mutex, osWaitForever);
+        if (timed_out != 0) {
+            ret = MESH_STREAM_ERR_TIMEOUT;
+            break;
+        }
+    }
+    if (s->state != STREAM_ESTABLISHED && ret == 0) {
+        ret = MESH_STREAM_ERR_FAILED;
+    }
+    release_stream(s);
+    osMutexRelease(stream_mutex);
+    return ret;
+}
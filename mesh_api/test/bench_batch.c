@@ -0,0 +1,143 @@
+/*
+ * 批量收发基准测试：比较逐条调用mesh_send/mesh_recv与mesh_send_batch/mesh_recv_batch的每秒消息数。
+ * 需要两块板子加入同一个Mesh网络：
+ *   接收端 BENCH_PEER_MAC 留空，依次以逐条、批量两种方式读取，统计每个阶段收到的消息数和速率；
+ *   发送端 BENCH_PEER_MAC 填接收端的MAC，先逐条发送 BENCH_MESSAGES 条，再按批发送同样数量。
+ * 发送队列满时等待1个tick后重发，统计的是消息被发送引擎接受的速率，两种方式在同样条件下比较。
+ */
+#include <stdio.h>
+#include <string.h>
+#include "cmsis_os2.h"
+#include "app_init.h"
+#include "mesh_api.h"
+
+#define BENCH_PEER_MAC      ""      // 接收端的MAC地址，留空表示本节点是接收端
+#define BENCH_MESSAGES      2000    // 每个阶段发送的消息数量
+#define BENCH_MSG_LEN       32      // 消息长度，小消息最能体现每次调用的固定开销
+#define BENCH_BATCH         8       // 每批的消息数量，不超过MESH_MAX_BATCH
+#define BENCH_RECV_PHASE_MS 10000   // 接收端每个阶段的时长
+#define BENCH_IDLE_MS       1       // 接收端没有数据时的等待时间
+
+#define BENCH_TASK_STACK_SIZE 0x1000
+#define BENCH_TASK_PRIO       osPriorityLow4
+
+static uint32_t ticks_to_ms(uint32_t ticks) {
+    return ticks * 1000 / osKernelGetTickFreq();
+}
+
+static void print_rate(const char *name, uint32_t messages, uint32_t ticks) {
+    uint32_t ms = ticks_to_ms(ticks);
+    printf("  %-6s %5u messages in %5u ms, %u msg/s\n", name, messages, ms, (ms > 0) ? messages * 1000 / ms : 0);
+}
+
+static void bench_send(void) {
+    static char payload[BENCH_BATCH][BENCH_MSG_LEN];
+    for (int i = 0; i < BENCH_BATCH; i++) {
+        memset(payload[i], 'a' + i, BENCH_MSG_LEN);
+    }
+    // 逐条发送，每条都要检查网络状态、取本节点MAC
+    uint32_t start = osKernelGetTickCount();
+    for (int n = 0; n < BENCH_MESSAGES;) {
+        if (mesh_send(BENCH_PEER_MAC, payload[n % BENCH_BATCH], BENCH_MSG_LEN, 0) == 0) {
+            n++;
+        } else {
+            osDelay(1);
+        }
+    }
+    print_rate("single", BENCH_MESSAGES, osKernelGetTickCount() - start);
+    osDelay(1000);  // 等发送队列清空，两个阶段互不影响
+
+    // 按批发送，一批中没有发出的消息下次重发
+    MeshSendItem items[BENCH_BATCH];
+    for (int i = 0; i < BENCH_BATCH; i++) {
+        items[i].dest_mac = BENCH_PEER_MAC;
+        items[i].data = payload[i];
+        items[i].len = BENCH_MSG_LEN;
+    }
+    start = osKernelGetTickCount();
+    for (int n = 0; n < BENCH_MESSAGES;) {
+        int count = (BENCH_MESSAGES - n < BENCH_BATCH) ? BENCH_MESSAGES - n : BENCH_BATCH;
+        int sent = mesh_send_batch(items, count, 0);
+        if (sent > 0) {
+            n += sent;
+        }
+        if (sent < count) {
+            osDelay(1);
+        }
+    }
+    print_rate("batch", BENCH_MESSAGES, osKernelGetTickCount() - start);
+}
+
+static void bench_recv(void) {
+    static char data[BENCH_BATCH][MESH_MAX_DATA_LEN];
+    // 逐条接收
+    uint32_t received = 0;
+    uint32_t start = osKernelGetTickCount();
+    while (osKernelGetTickCount() - start < BENCH_RECV_PHASE_MS * osKernelGetTickFreq() / 1000) {
+        if (mesh_recv(NULL, data[0], sizeof(data[0])) >= 0) {
+            received++;
+        } else {
+            osDelay(BENCH_IDLE_MS);
+        }
+    }
+    print_rate("single", received, osKernelGetTickCount() - start);
+
+    // 批量接收，一次取完队列中已有的消息
+    MeshRecvItem items[BENCH_BATCH];
+    for (int i = 0; i < BENCH_BATCH; i++) {
+        items[i].buf = data[i];
+        items[i].buf_size = sizeof(data[i]);
+    }
+    received = 0;
+    start = osKernelGetTickCount();
+    while (osKernelGetTickCount() - start < BENCH_RECV_PHASE_MS * osKernelGetTickFreq() / 1000) {
+        int count = mesh_recv_batch(items, BENCH_BATCH);
+        received += count;
+        if (count == 0) {
+            osDelay(BENCH_IDLE_MS);
+        }
+    }
+    print_rate("batch", received, osKernelGetTickCount() - start);
+}
+
+void bench_batch_task(void *param) {
+    (void)param;
+    if (mesh_init("FsrMesh", "12345678") != 0) {
+        printf("mesh_init failed.\n");
+        return;
+    }
+    while (mesh_network_connected() == 0) {
+        osDelay(100);
+    }
+    osDelay(3000);  // 等路由表稳定
+    if (strlen(BENCH_PEER_MAC) == 0) {
+        printf("batch bench receiver, %u ms per phase:\n", BENCH_RECV_PHASE_MS);
+        bench_recv();
+    } else {
+        printf("batch bench sender to %s, %d x %d bytes, batch of %d:\n",
+               BENCH_PEER_MAC, BENCH_MESSAGES, BENCH_MSG_LEN, BENCH_BATCH);
+        bench_send();
+    }
+}
+
+/* 创建任务 */
+static void bench_batch_entry(void)
+{
+    osThreadAttr_t attr;
+    attr.name       = "bench_batch_task";
+    attr.attr_bits  = 0U;
+    attr.cb_mem     = NULL;
+    attr.cb_size    = 0U;
+    attr.stack_mem  = NULL;
+    attr.stack_size = BENCH_TASK_STACK_SIZE;
+    attr.priority   = BENCH_TASK_PRIO;
+
+    if (osThreadNew((osThreadFunc_t)bench_batch_task, NULL, &attr) == NULL) {
+        printf("Create bench_batch_task failed.\n");
+    } else {
+        printf("Create bench_batch_task successfully.\n");
+    }
+}
+
+/* 启动任务 */
+app_run(bench_batch_entry);
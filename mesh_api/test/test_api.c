@@ -30,7 +30,6 @@ void test_api_task(void)
             osDelay(100);
             continue;
         }
-        osDelay(100);
         // if (mesh_broadcast("Hello, Mesh!") != 0) {
         //     LOG("mesh_broadcast failed.\n");
         // } else {
@@ -39,10 +38,11 @@ void test_api_task(void)
         char src_mac[7] = {0};
         src_mac[6] = '\0';
         char data[512] = {0};
-        if(mesh_recv_data(src_mac, data) == 0) {
+        // 阻塞等待数据，收到后立即处理，不需要轮询
+        if(mesh_recv_data_timeout(src_mac, data, 1000) == 0) {
             LOG("Received data from client: %s, MAC: %s\n", data, src_mac);
         }else {
-            LOG("no data recv.\n");
+            LOG("no data recv, %u dropped.\n", mesh_get_rx_dropped());
             continue;
         }
         LOG("say hi to mac: %s\n", src_mac);
@@ -44,6 +44,12 @@ static WirelessSTAConfig sta_config;
 // 是否是根节点标记位
 static bool is_root = false;
 
+// 设置路由传输事件标志，并唤醒在接收数据帧的路由传输线程立即处理
+static void notify_route_transport(uint32_t bit) {
+    osEventFlagsSet(route_transport_event_flags, bit);
+    HAL_Wireless_WakeupServer(DEFAULT_WIRELESS_TYPE);
+}
+
 
 // 初始化状态机
 int network_fsm_init(const MeshNetworkConfig *config) {
@@ -301,7 +307,7 @@ NetworkState state_open_ap(void) {
         return STATE_TERMINATE;
     } else {
         LOG("AP mode started successfully with SSID: %s\n", ap_ssid);
-        osEventFlagsSet(route_transport_event_flags, ROUTE_TRANSPORT_START_BIT);
+        notify_route_transport(ROUTE_TRANSPORT_START_BIT);
         return STATE_CHECK_ROOT_CONFLICT;
     }
 }
@@ -356,7 +362,7 @@ NetworkState state_check_root_conflict(void) {
                     sta_config.type = DEFAULT_WIRELESS_TYPE;
                     // 关闭AP模式
                     HAL_Wireless_DisableAP(DEFAULT_WIRELESS_TYPE);
-                    osEventFlagsSet(route_transport_event_flags, ROUTE_TRANSPORT_STOP_BIT);
+                    notify_route_transport(ROUTE_TRANSPORT_STOP_BIT);
                     free(scan_results);  // 释放内存
                     return STATE_SCANNING;
                 }
@@ -372,7 +378,7 @@ NetworkState state_check_root_conflict(void) {
         memset(sta_config.bssid, 0, sizeof(sta_config.bssid));           // 清空 bssid
         // 关闭AP模式
         HAL_Wireless_DisableAP(DEFAULT_WIRELESS_TYPE);
-        osEventFlagsSet(route_transport_event_flags, ROUTE_TRANSPORT_STOP_BIT);
+        notify_route_transport(ROUTE_TRANSPORT_STOP_BIT);
         osDelay(100); // 延迟 1s，等待断连的WiFi完全消失
         return STATE_SCANNING;
     }else{
@@ -405,7 +411,7 @@ NetworkState state_create_root(void) {
         return STATE_TERMINATE;
     } else {
         LOG("AP mode started successfully with SSID: %s\n", root_ssid);
-        osEventFlagsSet(route_transport_event_flags, ROUTE_TRANSPORT_START_BIT);
+        notify_route_transport(ROUTE_TRANSPORT_START_BIT);
         is_root = true;
     }
     return STATE_CHECK_ROOT_CONFLICT;
@@ -0,0 +1,42 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <stdint.h>
+
+/*
+ * 轻量级LZ压缩，编码格式与LZ4块格式相同：
+ * | 标记字节(高4位字面量长度，低4位匹配长度-4) | [扩展字面量长度] | 字面量 | 2字节偏移（小端） | [扩展匹配长度] |
+ * 最后一段只有字面量，没有偏移和匹配长度。压缩时遵守LZ4块格式的结尾规则：最后LZ_LAST_LITERALS个字节
+ * 总是字面量，最后一个匹配从距结尾至少LZ_MFLIMIT个字节处开始，输出可以用标准LZ4解压。
+ * 压缩时只需要栈上的哈希表（LZ_HASH_SIZE个uint16_t），解压不需要额外内存。
+ */
+
+#define LZ_HASH_BITS    8                       // 哈希表位数
+#define LZ_HASH_SIZE    (1 << LZ_HASH_BITS)     // 哈希表大小，占用栈空间 LZ_HASH_SIZE * 2 字节
+#define LZ_MIN_MATCH    4                       // 最短匹配长度
+#define LZ_MAX_OFFSET   0xFFFF                  // 最大回溯距离
+#define LZ_LAST_LITERALS 5                      // 结尾必须是字面量的字节数
+#define LZ_MFLIMIT      12                      // 匹配起点到结尾的最小距离
+
+/**
+ * @brief 压缩数据
+ * @param in 原始数据
+ * @param in_len 原始数据长度
+ * @param[out] out 存储压缩后的数据
+ * @param out_cap 输出缓冲区大小
+ * @return 压缩后的长度；输出缓冲区放不下时返回-1
+ * @note 传入 out_cap = in_len - 1 即可在压缩后没有变小时返回-1
+ */
+int lz_compress(const uint8_t *in, uint16_t in_len, uint8_t *out, uint16_t out_cap);
+
+/**
+ * @brief 解压数据
+ * @param in 压缩数据
+ * @param in_len 压缩数据长度
+ * @param[out] out 存储解压后的数据
+ * @param out_cap 输出缓冲区大小
+ * @return 解压后的长度；数据损坏或输出缓冲区放不下时返回-1
+ */
+int lz_decompress(const uint8_t *in, uint16_t in_len, uint8_t *out, uint16_t out_cap);
+
+#endif // LZ_CODEC_H
@@ -1,6 +1,11 @@
 #ifndef ROUTING_TRANSPORT_H
 #define ROUTING_TRANSPORT_H
 
+#include <stdint.h>
+#include "cmsis_os2.h"
+#include "hal_packet_buf.h"
+#include "tx_engine.h"
+
 #define MAC_SIZE 6
 #define HASH_TABLE_SIZE 100     // 哈希表大小，选择适当大小避免冲突过多
 #define MAX_NODES 100           // 最大节点数量
@@ -38,16 +43,253 @@ typedef struct {
     char dest_mac[MAC_SIZE];  // 目标节点MAC地址
     char status;  // 数据包状态
     char packet_num[3];  // 数据包编号
-    char crc[2];        // 校验位
-    char data[494];  // 数据位
+    char hop_limit;     // 剩余跳数
+    char flags;         // 标志位
+    char port;          // 端口
+    char data[493];  // 数据位
 } DataPacket;
 
-void broadcast_data_packet(DataPacket packet);
+// 数据包各字段在帧中的偏移，转发时直接按偏移读取，无需解析整个数据包
+#define PACKET_TYPE_OFFSET      0
+#define PACKET_SRC_MAC_OFFSET   1
+#define PACKET_DEST_MAC_OFFSET  7
+#define PACKET_STATUS_OFFSET    13
+#define PACKET_NUM_OFFSET       14
+#define PACKET_HOP_LIMIT_OFFSET 17
+#define PACKET_FLAGS_OFFSET     18
+#define PACKET_PORT_OFFSET      19
+#define PACKET_DATA_OFFSET      20
+#define PACKET_DATA_SIZE        493
+#define PACKET_MAX_SIZE         513
+
+// 数据包状态：'0' 需要目标节点应答，'1' 应答，'2' 目标不可达，'3' 广播请求，'4' 广播
+#define PACKET_STATUS_NO_ACK    '5'     // 不需要应答，由上层协议自己确认，转发方式与'0'相同
+#define PACKET_STATUS_PUBLISH_REQUEST '6'   // 发布请求，与'3'一样先发给根节点
+#define PACKET_STATUS_PUBLISH   '7'     // 发布，从根节点向下只转发给有订阅者的子树
+
+// 发布包的数据位以主题开头：[0] 主题长度 [1..] 主题，后面是发布的数据
+#define PACKET_TOPIC_MAX_LEN    32
+// 订阅摘要：每个主题按哈希映射到32位中的一位，节点把自己和子树的摘要附在路由包末尾报给父节点。
+// 不同主题可能映射到同一位，只会多转发，目标节点按完整主题过滤
+#define TOPIC_SUMMARY_BITS      32
+
+// 剩余跳数以一位十六进制字符存放，每转发一次减1，减到0时丢弃
+#define PACKET_HOP_LIMIT_DEFAULT 15
+
+// 标志位同样以一位十六进制字符存放
+#define PACKET_FLAG_COMPRESSED  0x01    // 数据位经过lz_codec压缩
+
+// 端口以一个字节存放，目标节点按端口把数据包放入不同的接收队列
+#define PACKET_PORT_DEFAULT     0       // 默认端口，放入dataPacketQueueId
+#define PACKET_MAX_PORTS        8       // 除默认端口外可以同时绑定的端口数量
+#define PACKET_MAX_PORT_HANDLERS 3      // 可以设置处理函数的端口数量，供协议栈内部的服务使用
+
+// 数据包的传输方式，路由包始终使用TCP
+typedef enum {
+    DATA_TRANSPORT_TCP = 0,     // TCP长连接，可靠传输
+    DATA_TRANSPORT_UDP,         // UDP数据报，不保证送达，适合可以容忍丢包的遥测数据
+    DATA_TRANSPORT_RAW,         // 链路层帧，不经过IP和TCP，不保证送达
+} DataTransport;
+
+// 接收队列满时的丢弃策略
+typedef enum {
+    RX_DROP_TAIL = 0,           // 丢弃新到达的数据包
+    RX_DROP_OLDEST,             // 丢弃队列中最早的数据包，保留最新的数据
+} RxDropPolicy;
+
+#define RX_QUEUE_DEPTH_DEFAULT  5       // 默认的接收队列长度
+
+// 转发统计信息，用于衡量每一跳的转发时延
+typedef struct {
+    uint32_t forwarded;     // 已转发的数据包数量
+    uint64_t total_us;      // 累计转发耗时（微秒），32位约71分钟就会回绕
+    uint32_t max_us;        // 单次最大转发耗时（微秒）
+    uint32_t hop_expired;   // 剩余跳数耗尽而丢弃的数据包数量
+    uint32_t loop_detected; // 检测到环路而丢弃的数据包数量
+    uint32_t publish_pruned; // 因子树中没有订阅者而没有发给子节点的发布包数量
+    uint32_t control_dropped; // 内存池耗尽或发送队列已满而丢弃的发给父节点的控制帧数量
+} ForwardStats;
+
+/**
+ * @brief 生成一个数据包，帧头和数据直接写入从内存池分配的缓冲区
+ * @param src_mac 源节点MAC地址
+ * @param dest_mac 目标节点MAC地址
+ * @param status 数据包状态
+ * @param data 数据
+ * @param data_len 数据长度，不超过PACKET_DATA_SIZE
+ * @return 数据包缓冲区，使用完需调用HAL_PacketBuf_Free释放；失败返回NULL
+ */
+PacketBuf* create_data_packet(const char *src_mac, const char *dest_mac, char status, const char *data, uint16_t data_len);
+
+/**
+ * @brief 分配一个数据包缓冲区，帧头留空，调用方直接把数据写到payload + PACKET_DATA_OFFSET
+ * @param data_len 数据长度，不超过PACKET_DATA_SIZE
+ * @return 数据包缓冲区，失败返回NULL
+ * @note 写完数据后调用fill_data_packet_header填写帧头
+ */
+PacketBuf* alloc_data_packet(uint16_t data_len);
+
+/**
+ * @brief 填写数据包的帧头，分配新的数据包编号
+ * @param buf alloc_data_packet分配的缓冲区
+ * @param src_mac 源节点MAC地址
+ * @param dest_mac 目标节点MAC地址
+ * @param status 数据包状态
+ */
+void fill_data_packet_header(PacketBuf *buf, const char *src_mac, const char *dest_mac, char status);
+
+/**
+ * @brief 向所有子节点广播数据包，所有子节点共用同一个缓冲区
+ * @param buf 数据包缓冲区
+ */
+void broadcast_data_packet(PacketBuf *buf);
+
+/**
+ * @brief 计算主题在订阅摘要中对应的位
+ * @param topic 主题
+ * @param len 主题长度
+ * @return 只有一位为1的摘要
+ */
+uint32_t topic_summary_mask(const char *topic, uint8_t len);
+
+/**
+ * @brief 设置本节点的订阅摘要
+ * @param summary 本节点订阅的所有主题的topic_summary_mask按位或
+ * @note 路由线程在维护周期中发现摘要变化后重新上报路由表，父节点据此决定是否向本子树转发
+ */
+void set_local_subscriptions(uint32_t summary);
+
+/**
+ * @brief 从本节点开始分发发布包：本节点订阅了该主题时放入接收队列，再发给子树中有订阅者的子节点
+ * @param buf 状态为PACKET_STATUS_PUBLISH的数据包缓冲区
+ * @note 根节点发布或收到发布请求时调用，其他节点的发布请求先发给根节点
+ */
+void publish_data_packet(PacketBuf *buf);
+
+/**
+ * @brief 按目标地址查找下一跳并发送数据包
+ * @param buf 数据包缓冲区
+ * @note 数据包放入下一跳的发送队列后立即返回，发送引擎持有一次引用，调用方可以直接释放
+ */
+void send_packet_buf(PacketBuf *buf);
+
+/**
+ * @brief 按目标地址查找下一跳并异步发送数据包，发送完成后调用回调
+ * @param buf 数据包缓冲区
+ * @param cb 发送完成回调，在发送线程中调用，可以为NULL
+ * @param arg 回调参数
+ * @return 0 表示已放入发送队列，-1 表示下一跳的队列已满，不会调用回调
+ * @note 回调只表示本节点已把数据包交给下一跳，端到端的送达由目标节点的应答确认
+ */
+int send_packet_buf_async(PacketBuf *buf, TxCompleteCallback cb, void *arg);
+
+/**
+ * @brief 压缩数据包的数据位
+ * @param buf 数据包缓冲区，调用后由本函数接管
+ * @return 压缩后的数据包缓冲区；压缩后没有变小或内存池耗尽时返回原缓冲区
+ */
+PacketBuf* compress_data_packet(PacketBuf *buf);
+
+/**
+ * @brief 设置数据包的传输方式
+ * @param transport 传输方式
+ * @note 需要在route_transport_task启动前调用
+ */
+void set_data_transport(DataTransport transport);
+
+/**
+ * @brief 设置默认端口接收队列的长度和所有接收队列的丢弃策略
+ * @param depth 默认端口接收队列的长度，0表示使用RX_QUEUE_DEPTH_DEFAULT
+ * @param policy 队列满时的丢弃策略
+ * @note 队列长度需要在route_transport_task启动前设置，丢弃策略可以随时修改；
+ *       队列中的数据包占用内存池缓冲区，长度不宜超过小缓冲区的数量
+ */
+void set_receive_queue(uint16_t depth, RxDropPolicy policy);
+
+/**
+ * @brief 获取因接收队列已满、端口未绑定或解压失败而丢弃的数据包数量
+ * @return 丢弃的数据包数量
+ */
+uint32_t get_receive_dropped(void);
+
+/**
+ * @brief 应答包处理函数，在路由传输线程中调用，不能长时间阻塞
+ * @param buf 发给本节点的应答包（status为'1'）或目标不可达回应（status为'2'）
+ * @return 0 表示已处理，不再放入接收队列；其他值表示交给应用层接收
+ */
+typedef int (*ReplyHandler)(const PacketBuf *buf);
+
+/**
+ * @brief 设置应答包处理函数，NULL表示应答包全部放入接收队列
+ * @param handler 应答包处理函数
+ */
+void set_reply_handler(ReplyHandler handler);
+
+/**
+ * @brief 为端口绑定接收队列，发给该端口的数据包放入这个队列
+ * @param port 端口，不能是PACKET_PORT_DEFAULT
+ * @param queue 存放PacketBuf指针的消息队列，NULL表示解除绑定
+ * @return 0 表示成功，-1 表示端口已绑定、没有空位或没有绑定
+ * @note 发往未绑定端口的数据包被丢弃；解除绑定返回后路由线程不会再访问该队列
+ */
+int bind_port_queue(uint8_t port, osMessageQueueId_t queue);
+
+/**
+ * @brief 端口处理函数，在路由传输线程中调用，不能长时间阻塞
+ * @param buf 发给本节点该端口的数据包，需要保留时自己调用HAL_PacketBuf_Ref
+ */
+typedef void (*PortHandler)(PacketBuf *buf);
+
+/**
+ * @brief 为端口设置处理函数，发给该端口的数据包直接交给它，不再放入接收队列
+ * @param port 端口，不能是PACKET_PORT_DEFAULT
+ * @param handler 处理函数
+ * @return 0 表示成功，-1 表示没有空位
+ * @note 设置后不能取消，用于随协议栈一直存在的服务
+ */
+int set_port_handler(uint8_t port, PortHandler handler);
+
+/**
+ * @brief 获取端口绑定的接收队列
+ * @param port 端口
+ * @return 接收队列，PACKET_PORT_DEFAULT返回dataPacketQueueId，未绑定返回NULL
+ */
+osMessageQueueId_t get_port_queue(uint8_t port);
 
 void send_data_packet(const char *dest_mac, const char *data);
 
+/**
+ * @brief 发送数据包，可选择是否压缩
+ * @param dest_mac 目标节点MAC地址
+ * @param data 数据
+ * @param flags PACKET_FLAG_COMPRESSED表示压缩数据位，0表示不压缩
+ */
+void send_data_packet_ex(const char *dest_mac, const char *data, uint8_t flags);
+
+/**
+ * @brief 按长度发送数据包，数据可以包含'\0'
+ * @param dest_mac 目标节点MAC地址
+ * @param data 数据
+ * @param len 数据长度，不超过PACKET_DATA_SIZE
+ * @param flags PACKET_FLAG_COMPRESSED表示压缩数据位，0表示不压缩
+ * @return 0 表示已放入下一跳的发送队列，-1 表示数据过长、内存池耗尽或发送队列已满
+ */
+int send_data_packet_len(const char *dest_mac, const char *data, uint16_t len, uint8_t flags);
+
 char* generate_data_packet(DataPacket packet);
 
 void route_transport_task(void);
 
+/**
+ * @brief 获取本节点的转发统计信息
+ * @param[out] stats 存储转发统计信息
+ * @note 平均每跳时延 = total_us / forwarded
+ */
+void get_forward_stats(ForwardStats *stats);
+
+/**
+ * @brief 清空本节点的转发统计信息
+ */
+void reset_forward_stats(void);
+
 #endif
\ No newline at end of file
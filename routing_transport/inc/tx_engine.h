@@ -0,0 +1,179 @@
+#ifndef TX_ENGINE_H
+#define TX_ENGINE_H
+
+#include <stdint.h>
+#include "hal_packet_buf.h"
+
+/*
+ * 异步发送引擎：每个下一跳（父节点或某个直连子节点）有一个独立的有界发送队列，
+ * 由单独的发送线程依次发送。连接以非阻塞方式建立和写入，某个邻居不可达或不再接收时只有它自己的队列积压，
+ * 接收线程和发往其他邻居的数据包都不会被阻塞。
+ * 每个下一跳的队列又分为控制面（路由包、重发请求）和数据面，控制面严格优先发送，
+ * 并走单独的连接，应用数据突发不会拖慢路由收敛。
+ * 数据面队列中发往同一下一跳的多个小数据帧可以合并成一个合并帧发送（类似Nagle算法），
+ * 接收方拆开后逐个处理，需要继续转发的数据帧在新的下一跳队列中重新合并。
+ * 发往父节点的数据面再按入口（本节点自己或转发来源的子节点）分成多个队列，以差额轮询（DRR）
+ * 按权重分配上行链路，某个子树发送过多时只会挤满自己的队列，不会占用其他子树的份额。
+ */
+
+#define TX_MAX_NEXT_HOPS    9       // 父节点1个 + 子节点8个，与AP最多接入的子节点数量一致
+#define TX_QUEUE_DEPTH      4       // 每个下一跳的发送队列长度，队列中的数据包占用内存池缓冲区
+#define TX_ITEM_TIMEOUT_MS  2000    // 数据包在队列中的最长等待时间，超时视为发送失败
+#define TX_RETRY_BACKOFF_MS 1000    // 发送失败后暂停该下一跳的时间，避免反复连接不可达的邻居
+#define TX_POLL_INTERVAL_MS 10      // 有连接正在建立或发送缓冲区已满时，发送线程检查连接状态的间隔
+
+// 小数据帧合并
+#define ENABLE_TX_AGGREGATION   1       // 1 表示数据面合并发往同一下一跳的数据帧，0 表示逐个发送
+#define TX_AGGREGATE_DELAY_MS   5       // 默认的最长等待时间，队首数据帧等待超过该时间后立即发送
+#define TX_AGGREGATE_THRESHOLD  256     // 默认的字节阈值，合并帧达到该长度后立即发送
+#define TX_BUNDLE_TYPE          '4'     // 合并帧的类型位
+#define TX_BUNDLE_HEADER_SIZE   1       // 合并帧帧头：类型位
+#define TX_BUNDLE_LEN_SIZE      3       // 每个数据帧前的长度字段，三位十进制字符
+#define TX_BUNDLE_MAX_LEN       PACKET_BUF_DATA_SIZE  // 合并帧最大长度，放得进一个小缓冲区
+
+// 上行公平队列
+#define ENABLE_TX_FAIR_QUEUE    1       // 1 表示发往父节点的数据按入口子节点分队列轮询，0 表示按到达顺序发送
+#define TX_FAIR_QUEUES          9       // 本节点1个 + 子节点8个，每个队列长度为TX_QUEUE_DEPTH
+#define TX_FAIR_QUANTUM         PACKET_BUF_DATA_SIZE  // 权重为1的队列每轮可发送的字节数，不小于一个完整数据帧
+#define TX_FAIR_WEIGHT_DEFAULT  1       // 默认权重
+
+// 发送结果
+#define TX_RESULT_OK        0       // 已发送
+#define TX_RESULT_FAILED    -1      // 连接失败或发送出错
+#define TX_RESULT_TIMEOUT   -2      // 在队列中等待超时
+#define TX_RESULT_DROPPED   -3      // 拓扑变化后被清空
+
+// 发送方式
+#define TX_FLAG_DATAGRAM    0x01    // 以UDP数据报发送，否则以带长度前缀的TCP数据帧发送
+#define TX_FLAG_CONTROL     0x02    // 控制面数据帧，优先发送，通过控制面连接发送
+#define TX_FLAG_RAW         0x04    // 以链路层帧直接发送，不经过IP
+
+// 发送平面
+typedef enum {
+    TX_PLANE_DATA = 0,      // 数据面：数据包、子网广播的单播回退
+    TX_PLANE_CONTROL,       // 控制面：路由包、广播重发请求
+    TX_PLANE_MAX,
+} TxPlane;
+
+/**
+ * @brief 发送完成回调，在发送线程中调用，不能长时间阻塞
+ * @param buf 发送的数据包缓冲区，回调返回后发送引擎释放自己持有的引用
+ * @param result 发送结果，TX_RESULT_*
+ * @param arg 提交时传入的参数
+ */
+typedef void (*TxCompleteCallback)(PacketBuf *buf, int result, void *arg);
+
+// 单个平面的统计信息
+typedef struct {
+    uint32_t submitted;     // 已提交的数据包数量
+    uint32_t sent;          // 已发送的数据包数量
+    uint32_t failed;        // 发送失败的数据包数量
+    uint32_t timeout;       // 等待超时的数据包数量
+    uint32_t dropped;       // 队列已满被拒绝或被清空的数据包数量
+    uint32_t backlog;       // 当前所有下一跳队列中等待发送的数据包数量
+    uint32_t max_backlog;   // 历史最大积压数量
+    uint32_t max_depth;     // 单个队列的最大深度
+    uint32_t bundles;       // 发送的合并帧数量
+    uint32_t bundled;       // 以合并帧发送的数据包数量
+} TxPlaneStats;
+
+// 发送引擎统计信息，按平面分别统计，可以看出是哪个平面拥塞
+typedef struct {
+    TxPlaneStats plane[TX_PLANE_MAX];
+} TxEngineStats;
+
+// 单个上行公平队列的统计信息
+typedef struct {
+    char mac[7];            // 入口子节点的MAC地址，本节点自己发出的数据包为空字符串
+    uint8_t weight;         // 权重
+    uint32_t enqueued;      // 已入队的数据包数量
+    uint32_t dropped;       // 队列已满被拒绝的数据包数量
+    uint32_t backlog;       // 当前积压的数据包数量
+    uint32_t max_backlog;   // 历史最大积压数量
+    uint32_t sent_bytes;    // 已发送的字节数，各队列之比反映实际分到的带宽
+} TxFairQueueStats;
+
+// 小数据帧合并参数
+typedef struct {
+    uint32_t delay_ms;      // 队首数据帧最长等待时间，0 表示不等待，只合并已经在队列中积压的数据帧
+    uint16_t threshold;     // 合并帧达到该长度后立即发送，不超过TX_BUNDLE_MAX_LEN
+} TxAggregationConfig;
+
+/**
+ * @brief 初始化发送引擎并创建发送线程，重复调用直接返回
+ * @return 0 表示成功，-1 表示失败
+ */
+int tx_engine_init(void);
+
+/**
+ * @brief 把数据包放入下一跳的发送队列
+ * @param next_hop_mac 下一跳子节点的MAC地址，NULL表示父节点
+ * @param buf 数据包缓冲区，发送引擎持有一次引用直到发送完成
+ * @param flags TX_FLAG_*，TX_FLAG_CONTROL表示放入控制面队列
+ * @param cb 发送完成回调，可以为NULL
+ * @param arg 回调参数
+ * @return 0 表示已入队，完成后调用cb；-1 表示队列已满或发送引擎未启动，不会调用cb
+ */
+int tx_engine_submit(const char *next_hop_mac, PacketBuf *buf, uint8_t flags, TxCompleteCallback cb, void *arg);
+
+/**
+ * @brief 把转发的数据包放入下一跳的发送队列，并指明它从哪个子节点收到
+ * @param next_hop_mac 下一跳子节点的MAC地址，NULL表示父节点
+ * @param ingress_mac 收到该数据包的子节点MAC地址，NULL表示本节点自己发出
+ * @param buf 数据包缓冲区，发送引擎持有一次引用直到发送完成
+ * @param flags TX_FLAG_*
+ * @param cb 发送完成回调，可以为NULL
+ * @param arg 回调参数
+ * @return 0 表示已入队；-1 表示该入口的队列已满或发送引擎未启动，不会调用cb
+ * @note 只有发往父节点的数据面按入口分队列，其他情况与tx_engine_submit相同
+ */
+int tx_engine_submit_from(const char *next_hop_mac, const char *ingress_mac, PacketBuf *buf, uint8_t flags,
+                          TxCompleteCallback cb, void *arg);
+
+/**
+ * @brief 清空所有发送队列，队列中的数据包以TX_RESULT_DROPPED完成
+ * @note 父节点变化或路由传输停止时调用
+ */
+void tx_engine_reset(void);
+
+/**
+ * @brief 获取发送引擎的统计信息
+ * @param[out] stats 存储统计信息
+ */
+void tx_engine_get_stats(TxEngineStats *stats);
+
+/**
+ * @brief 设置某个入口在上行链路上的权重，权重为2的子树分到的带宽是权重为1的两倍
+ * @param ingress_mac 入口子节点的MAC地址，NULL表示本节点自己
+ * @param weight 权重，1~255；0表示取消设置，恢复默认权重
+ * @return 0 表示成功，-1 表示没有空闲的队列
+ * @note 设置过权重的子节点一直保留自己的队列，子节点离开后需要用0取消
+ */
+int tx_engine_set_fair_weight(const char *ingress_mac, uint8_t weight);
+
+/**
+ * @brief 获取上行公平队列的统计信息
+ * @param[out] stats 存储统计信息，第一个总是本节点自己
+ * @param max_count stats的容量
+ * @return 写入的队列数量
+ */
+int tx_engine_get_fair_stats(TxFairQueueStats *stats, int max_count);
+
+/**
+ * @brief 设置小数据帧合并参数，可以在运行时调用
+ * @param config 合并参数，NULL表示恢复默认值
+ * @note ENABLE_TX_AGGREGATION为0时不起作用
+ */
+void tx_engine_set_aggregation(const TxAggregationConfig *config);
+
+/**
+ * @brief 依次取出合并帧中的数据帧
+ * @param bundle 合并帧，从类型位开始
+ * @param len 合并帧长度
+ * @param[in,out] offset 首次调用时为TX_BUNDLE_HEADER_SIZE，返回后指向下一个数据帧
+ * @param[out] frame_len 取出的数据帧长度
+ * @return 数据帧的起始位置，指向合并帧内部；没有更多数据帧或格式错误时返回NULL
+ */
+char *tx_bundle_next(char *bundle, uint16_t len, uint16_t *offset, uint16_t *frame_len);
+
+#endif // TX_ENGINE_H
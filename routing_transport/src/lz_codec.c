@@ -0,0 +1,164 @@
+#include "lz_codec.h"
+#include <string.h>
+
+static uint32_t lz_hash(const uint8_t *p) {
+    uint32_t v = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    return (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+// 写入扩展长度（标记字节中的4位放不下时），返回写入后的位置，空间不足返回NULL
+static uint8_t *write_length(uint8_t *op, const uint8_t *oend, uint32_t len) {
+    while (len >= 255) {
+        if (op >= oend) {
+            return NULL;
+        }
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op >= oend) {
+        return NULL;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// 写入一段序列：字面量 + 可选的匹配，match_len为0表示最后一段
+static uint8_t *write_sequence(uint8_t *op, const uint8_t *oend, const uint8_t *literal, uint32_t literal_len,
+                               uint16_t offset, uint32_t match_len) {
+    if (op >= oend) {
+        return NULL;
+    }
+    uint8_t *token = op++;
+    *token = (uint8_t)((literal_len >= 15 ? 15 : literal_len) << 4);
+    if (literal_len >= 15 && (op = write_length(op, oend, literal_len - 15)) == NULL) {
+        return NULL;
+    }
+    if (op + literal_len > oend) {
+        return NULL;
+    }
+    memcpy(op, literal, literal_len);
+    op += literal_len;
+    if (match_len == 0) {
+        return op;
+    }
+    if (op + 2 > oend) {
+        return NULL;
+    }
+    *op++ = (uint8_t)(offset & 0xFF);
+    *op++ = (uint8_t)(offset >> 8);
+    uint32_t code = match_len - LZ_MIN_MATCH;
+    *token |= (uint8_t)(code >= 15 ? 15 : code);
+    if (code >= 15 && (op = write_length(op, oend, code - 15)) == NULL) {
+        return NULL;
+    }
+    return op;
+}
+
+int lz_compress(const uint8_t *in, uint16_t in_len, uint8_t *out, uint16_t out_cap) {
+    if (in == NULL || out == NULL) {
+        return -1;
+    }
+    uint16_t table[LZ_HASH_SIZE];
+    memset(table, 0xFF, sizeof(table));  // 0xFFFF表示空位
+
+    const uint8_t *ip = in;
+    const uint8_t *iend = in + in_len;
+    const uint8_t *anchor = in;  // 尚未输出的字面量起点
+    uint8_t *op = out;
+    const uint8_t *oend = out + out_cap;
+
+    // 按LZ4块格式的结尾规则，匹配从距结尾至少LZ_MFLIMIT字节处开始，并在最后LZ_LAST_LITERALS字节之前结束
+    while (iend - ip >= LZ_MFLIMIT) {
+        uint32_t h = lz_hash(ip);
+        uint16_t ref_pos = table[h];
+        table[h] = (uint16_t)(ip - in);
+        const uint8_t *ref = in + ref_pos;
+        if (ref_pos == 0xFFFF || ip - ref > LZ_MAX_OFFSET || memcmp(ref, ip, LZ_MIN_MATCH) != 0) {
+            ip++;
+            continue;
+        }
+        // 向后扩展匹配
+        uint32_t match_len = LZ_MIN_MATCH;
+        while (ip + match_len < iend - LZ_LAST_LITERALS && ref[match_len] == ip[match_len]) {
+            match_len++;
+        }
+        op = write_sequence(op, oend, anchor, (uint32_t)(ip - anchor), (uint16_t)(ip - ref), match_len);
+        if (op == NULL) {
+            return -1;
+        }
+        ip += match_len;
+        anchor = ip;
+    }
+    // 最后一段只有字面量
+    op = write_sequence(op, oend, anchor, (uint32_t)(iend - anchor), 0, 0);
+    if (op == NULL) {
+        return -1;
+    }
+    return (int)(op - out);
+}
+
+int lz_decompress(const uint8_t *in, uint16_t in_len, uint8_t *out, uint16_t out_cap) {
+    if (in == NULL || out == NULL) {
+        return -1;
+    }
+    const uint8_t *ip = in;
+    const uint8_t *iend = in + in_len;
+    uint8_t *op = out;
+    uint8_t *oend = out + out_cap;
+
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        // 字面量
+        uint32_t literal_len = token >> 4;
+        if (literal_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                literal_len += b;
+            } while (b == 255);
+        }
+        if (literal_len > (uint32_t)(iend - ip) || literal_len > (uint32_t)(oend - op)) {
+            return -1;
+        }
+        memcpy(op, ip, literal_len);
+        ip += literal_len;
+        op += literal_len;
+        if (ip == iend) {
+            break;  // 最后一段没有匹配
+        }
+        // 匹配
+        if (iend - ip < 2) {
+            return -1;
+        }
+        uint16_t offset = (uint16_t)(ip[0] | (ip[1] << 8));
+        ip += 2;
+        if (offset == 0 || offset > op - out) {
+            return -1;
+        }
+        uint32_t match_len = token & 0x0F;
+        if (match_len == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) {
+                    return -1;
+                }
+                b = *ip++;
+                match_len += b;
+            } while (b == 255);
+        }
+        match_len += LZ_MIN_MATCH;
+        if (match_len > (uint32_t)(oend - op)) {
+            return -1;
+        }
+        // 匹配区域可能与输出重叠，逐字节复制
+        const uint8_t *ref = op - offset;
+        for (uint32_t i = 0; i < match_len; i++) {
+            op[i] = ref[i];
+        }
+        op += match_len;
+    }
+    return (int)(op - out);
+}
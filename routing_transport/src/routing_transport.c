@@ -4,14 +4,19 @@
 #include "cmsis_os2.h"
 #include "app_init.h"
 #include "hal_wireless.h"
+#include "hal_packet_buf.h"
 #include "network_fsm.h"
 #include "routing_transport.h"
+#include "lz_codec.h"
+#include "tx_engine.h"
 #include "std_def.h"
 
 extern MeshNetworkConfig g_mesh_config;
 
-#define QUEUE_SIZE 5  // 队列的容量
 osMessageQueueId_t dataPacketQueueId;
+static uint16_t rx_queue_depth = RX_QUEUE_DEPTH_DEFAULT;   // 队列的容量
+static RxDropPolicy rx_drop_policy = RX_DROP_TAIL;
+static volatile uint32_t rx_dropped = 0;                   // 没能放入接收队列或解压失败的数据包数量
 
 // 定义宏开关，打开或关闭日志输出
 #define ENABLE_LOG 0  // 1 表示开启日志，0 表示关闭日志
@@ -23,6 +28,30 @@ osMessageQueueId_t dataPacketQueueId;
     #define LOG(fmt, ...) do { UNUSED(fmt); } while (0) 
 #endif
 
+// 定义宏开关，打开或关闭直通转发
+#define ENABLE_CUT_THROUGH 1  // 1 表示中继时只读取帧头的目标地址直接转发，0 表示先解析整个数据包再转发
+
+// 定义宏开关，打开或关闭子网广播
+#define ENABLE_SUBNET_BROADCAST 1  // 1 表示向下广播时向热点子网发送一次UDP广播，0 表示逐个子节点单播
+#define ENABLE_BROADCAST_NACK   1  // 1 表示子节点发现广播序号缺失时向父节点请求重发
+
+// 子网广播：帧头为 "2" + 3位每跳广播序号，后面是原始数据包
+#define SUBNET_BROADCAST_HEADER_SIZE 4
+#define BROADCAST_REPAIR_SIZE 4     // 父节点保留最近几个广播包用于重发
+#define BROADCAST_SEEN_SIZE   8     // 记录最近收到的广播包，用于去重
+
+// 环路检测：记录最近转发过的数据包，同一个数据包以更少的剩余跳数再次到达说明出现了环路
+#define LOOP_CACHE_SIZE 8           // 记录的数据包数量
+#define LOOP_CACHE_TIMEOUT_MS 2000  // 记录的有效时间
+
+// 空闲时或每隔这么久检查一次子节点是否离开
+#define ROUTE_MAINTAIN_INTERVAL_MS 1000
+
+// 订阅摘要附在路由包末尾，单独一行："S XXXXXXXX"；解析路由包时只读取节点数指定的行数，不认识这一行的节点会忽略它
+#define SUBSCRIPTION_LINE_TAG     'S'
+#define SUBSCRIPTION_LINE_SIZE    11    // 换行、标记、空格和8位十六进制摘要
+#define SUBSCRIPTION_MAX_CHILDREN 8     // 与AP最多接入的子节点数量一致
+
 // 路由传输层开启标志位
 extern osEventFlagsId_t route_transport_event_flags;
 #define ROUTE_TRANSPORT_START_BIT (1 << 0)
@@ -30,6 +59,9 @@ extern osEventFlagsId_t route_transport_event_flags;
 
 HashTable* table = NULL;  // 定义哈希表
 
+static DataTransport data_transport = DATA_TRANSPORT_TCP;  // 数据包的传输方式
+static ReplyHandler reply_handler = NULL;  // 发给本节点的应答包先交给它处理
+
 struct Graph* graph = NULL;  // 定义图
 
 // 简单的哈希函数，将MAC地址转化为哈希值
@@ -381,6 +413,158 @@ void add_tree_node(const char *mac, HashTable** p_table, struct Graph** p_graph,
     *p_graph = new_graph;
 }
 
+typedef struct {
+    char mac[MAC_SIZE + 1];     // 空字符串表示空位
+    uint32_t summary;           // 该子节点所在子树的订阅摘要
+} ChildSubscription;
+
+static volatile uint32_t local_subscriptions = 0;   // 本节点的订阅摘要
+static ChildSubscription child_subscriptions[SUBSCRIPTION_MAX_CHILDREN];
+static uint32_t reported_subscriptions = 0;         // 最近一次报给父节点的摘要
+
+uint32_t topic_summary_mask(const char *topic, uint8_t len) {
+    // FNV-1a哈希
+    uint32_t hash = 2166136261U;
+    for (uint8_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)topic[i];
+        hash *= 16777619U;
+    }
+    return (uint32_t)1 << (hash % TOPIC_SUMMARY_BITS);
+}
+
+void set_local_subscriptions(uint32_t summary) {
+    local_subscriptions = summary;
+}
+
+static ChildSubscription *find_child_subscription(const char *mac) {
+    for (int i = 0; i < SUBSCRIPTION_MAX_CHILDREN; i++) {
+        if (child_subscriptions[i].mac[0] != '\0' && strncmp(child_subscriptions[i].mac, mac, MAC_SIZE) == 0) {
+            return &child_subscriptions[i];
+        }
+    }
+    return NULL;
+}
+
+static void remove_child_subscription(const char *mac) {
+    ChildSubscription *entry = find_child_subscription(mac);
+    if (entry != NULL) {
+        entry->mac[0] = '\0';
+    }
+}
+
+static void clear_child_subscriptions(void) {
+    for (int i = 0; i < SUBSCRIPTION_MAX_CHILDREN; i++) {
+        child_subscriptions[i].mac[0] = '\0';
+    }
+}
+
+// 从子节点的路由包中取出它的子树订阅摘要，没有摘要行时删除记录，之后照常向它转发发布包
+static void update_child_subscription(const char *mac, const char *data) {
+    const char *line = strrchr(data, '\n');
+    if (line == NULL || line[1] != SUBSCRIPTION_LINE_TAG || line[2] != ' ') {
+        remove_child_subscription(mac);
+        return;
+    }
+    ChildSubscription *entry = find_child_subscription(mac);
+    for (int i = 0; i < SUBSCRIPTION_MAX_CHILDREN && entry == NULL; i++) {
+        if (child_subscriptions[i].mac[0] == '\0') {
+            entry = &child_subscriptions[i];
+            strncpy(entry->mac, mac, MAC_SIZE);
+            entry->mac[MAC_SIZE] = '\0';
+        }
+    }
+    if (entry != NULL) {
+        entry->summary = (uint32_t)strtoul(line + 3, NULL, 16);
+    }
+}
+
+// 本节点和所有子树的订阅摘要
+static uint32_t subtree_subscriptions(void) {
+    uint32_t summary = local_subscriptions;
+    for (int i = 0; i < SUBSCRIPTION_MAX_CHILDREN; i++) {
+        if (child_subscriptions[i].mac[0] != '\0') {
+            summary |= child_subscriptions[i].summary;
+        }
+    }
+    return summary;
+}
+
+// 在路由包末尾写入订阅摘要行，返回写入的长度
+static int append_subscription_line(char *output) {
+    reported_subscriptions = subtree_subscriptions();
+    return sprintf(output, "\n%c %08lX", SUBSCRIPTION_LINE_TAG, (unsigned long)reported_subscriptions);
+}
+
+static ForwardStats forward_stats = {0};
+static int route_update_pending = 0;    // 路由包没有发出，下一个维护周期重新上报
+
+// 通过发送引擎的控制面把控制帧（路由包、重发请求）发给父节点
+// 路由线程不阻塞在直接发送上：内存池耗尽或队列已满时丢弃并计数，路由包由维护周期重新上报，
+// 重发请求不再补发，与请求在链路上丢失一样，对应的广播不再修复
+static void send_frame_to_parent(const char *data, uint16_t len)
+{
+    int is_route = (data[0] == '0');
+    PacketBuf *buf = HAL_PacketBuf_Alloc(len);
+    if (buf != NULL) {
+        memcpy(buf->payload, data, len);
+        int ret = tx_engine_submit(NULL, buf, TX_FLAG_CONTROL, NULL, NULL);
+        HAL_PacketBuf_Free(buf);
+        if (ret == 0) {
+            if (is_route) {
+                route_update_pending = 0;
+            }
+            return;
+        }
+    }
+    LOG("Failed to queue frame to parent, dropped.\n");
+    forward_stats.control_dropped++;
+    if (is_route) {
+        route_update_pending = 1;
+    }
+}
+
+// 把当前的路由表发送给父节点
+static void send_route_table_update(void)
+{
+    if (g_mesh_config.tree_level == 0 || table == NULL || graph == NULL) {
+        return;
+    }
+    // 每个节点最多11字节（MAC、空格、父节点索引、换行），再加上"0\nN\n"包头、订阅摘要行和结束符
+    char* output = (char*)malloc((11 * table->num_nodes + 8 + SUBSCRIPTION_LINE_SIZE) * sizeof(char));
+    if (output == NULL) {
+        return;
+    }
+    generateFormattedString(graph, table, output);
+    size_t len = strlen(output);
+    len += append_subscription_line(output + len);
+    send_frame_to_parent(output, len);
+    free(output);
+}
+
+// 没有子节点时只把自己报给父节点
+static void send_leaf_route_to_parent(const char *my_mac)
+{
+    char msg[16 + SUBSCRIPTION_LINE_SIZE];
+    int len = sprintf(msg, "0\n1\n%.6s -1", my_mac);
+    len += append_subscription_line(msg + len);
+    send_frame_to_parent(msg, len);
+}
+
+// 本节点或子树的订阅变化后重新上报路由表，父节点据此决定是否向本子树转发发布包；
+// 上次路由包因内存池耗尽没有发出时也在这里补发
+static void report_subscription_changes(void)
+{
+    if (g_mesh_config.tree_level == 0 || table == NULL ||
+        (!route_update_pending && subtree_subscriptions() == reported_subscriptions)) {
+        return;
+    }
+    if (graph != NULL) {
+        send_route_table_update();
+    } else {
+        send_leaf_route_to_parent((const char *)table->indexToMac[0]);
+    }
+}
+
 // 处理路由包
 void process_route_packet(const char *mac, char *data)
 {
@@ -389,41 +573,171 @@ void process_route_packet(const char *mac, char *data)
         LOG("ERROR: hash Table is NULL.\n");
     }
 
+    update_child_subscription(mac, data);  // add_tree_node会用strtok改写data，先取出订阅摘要
     add_tree_node(mac, &table, &graph, data);
     LOG("add_tree_node success!");
     printGraph(graph);
     LOG("printGraph success!");
 
-    char* output = (char*)malloc(11 * table->num_nodes * sizeof(char));
-    generateFormattedString(graph, table, output);
-
-    if (g_mesh_config.tree_level != 0) {
-        // 发送自己的路由表给父节点
-        HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, output, g_mesh_config.tree_level - 1);
-    }
-
-    free(output);
-    
+    // 每个节点最多11字节（MAC、空格、父节点索引、换行），再加上"0\nN\n"包头和结束符
+    // 发送自己的路由表给父节点
+    send_route_table_update();
 }
 
 // 处理数据包
 /*
-| [0]:数据包类型 | [1-6]:源节点MAC地址 | [7-12]:目标节点MAC地址 | [13]:数据包状态 | [14-16]:数据包编号 | [17-18]:校验位（可选） | [19-512]数据位 |
-| -------------- | ------------------- | ---------------------- | --------------- | ------------------ | ---------------------- | -------------- |
-| 1:表示数据透传 | A1B2C3              | B2C3A1                 | 0：发送包       | 000~999            |                        |                |
+| [0]:数据包类型 | [1-6]:源节点MAC地址 | [7-12]:目标节点MAC地址 | [13]:数据包状态 | [14-16]:数据包编号 | [17]:剩余跳数 | [18]:标志位 | [19]:端口 | [20-512]数据位 |
+| -------------- | ------------------- | ---------------------- | --------------- | ------------------ | ------------- | ----------- | --------- | -------------- |
+| 1:表示数据透传 | A1B2C3              | B2C3A1                 | 0：发送包       | 000~999            | F             | 0           | 0x00~0xFF |                |
 */
 // 创建一个数据包的数据结构
 
-DataPacket parse_data_packet(const char *data) {
-    DataPacket packet;
-    packet.type = data[0];
-    memcpy(packet.src_mac, data + 1, MAC_SIZE);
-    memcpy(packet.dest_mac, data + 7, MAC_SIZE);
-    packet.status = data[13];
-    memcpy(packet.packet_num, data + 14, 3);
-    memcpy(packet.crc, data + 17, 2);
-    memcpy(packet.data, data + 19, 494);
-    return packet;
+// 记录一次转发的耗时，start为开始处理该数据包时的系统计数
+static void record_forward_time(uint32_t start) {
+    uint32_t elapsed = osKernelGetSysTimerCount() - start;
+    uint32_t us = (uint32_t)((uint64_t)elapsed * 1000000 / osKernelGetSysTimerFreq());
+    forward_stats.forwarded++;
+    forward_stats.total_us += us;
+    if (us > forward_stats.max_us) {
+        forward_stats.max_us = us;
+    }
+}
+
+void get_forward_stats(ForwardStats *stats) {
+    if (stats == NULL) {
+        return;
+    }
+    memcpy(stats, &forward_stats, sizeof(ForwardStats));
+}
+
+void reset_forward_stats(void) {
+    memset(&forward_stats, 0, sizeof(ForwardStats));
+}
+
+typedef struct {
+    char src_mac[MAC_SIZE];
+    char dest_mac[MAC_SIZE];
+    char packet_num[3];
+    uint8_t hop_limit;      // 上次经过本节点时的剩余跳数，0表示空位
+    uint32_t tick;          // 上次经过本节点的时间
+} LoopCacheEntry;
+
+static LoopCacheEntry loop_cache[LOOP_CACHE_SIZE];
+static int loop_cache_next = 0;
+
+static uint8_t hex_char_to_int(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return 0;
+}
+
+static char int_to_hex_char(uint8_t value) {
+    return "0123456789ABCDEF"[value & 0x0F];
+}
+
+// 检查数据包是否以更少的剩余跳数再次经过本节点，返回1表示出现环路
+static int check_loop(const char *frame, uint8_t hop_limit) {
+    uint32_t now = osKernelGetTickCount();
+    uint32_t timeout = LOOP_CACHE_TIMEOUT_MS * osKernelGetTickFreq() / 1000;
+    for (int i = 0; i < LOOP_CACHE_SIZE; i++) {
+        LoopCacheEntry *entry = &loop_cache[i];
+        if (entry->hop_limit == 0 || now - entry->tick > timeout) {
+            continue;
+        }
+        if (memcmp(entry->src_mac, frame + PACKET_SRC_MAC_OFFSET, MAC_SIZE) != 0 ||
+            memcmp(entry->dest_mac, frame + PACKET_DEST_MAC_OFFSET, MAC_SIZE) != 0 ||
+            memcmp(entry->packet_num, frame + PACKET_NUM_OFFSET, 3) != 0) {
+            continue;
+        }
+        // 同一条路径上的数据包每次到达本节点的剩余跳数相同，跳数更少说明绕了一圈回来
+        int looped = hop_limit < entry->hop_limit;
+        entry->hop_limit = hop_limit;
+        entry->tick = now;
+        return looped;
+    }
+    LoopCacheEntry *entry = &loop_cache[loop_cache_next];
+    loop_cache_next = (loop_cache_next + 1) % LOOP_CACHE_SIZE;
+    memcpy(entry->src_mac, frame + PACKET_SRC_MAC_OFFSET, MAC_SIZE);
+    memcpy(entry->dest_mac, frame + PACKET_DEST_MAC_OFFSET, MAC_SIZE);
+    memcpy(entry->packet_num, frame + PACKET_NUM_OFFSET, 3);
+    entry->hop_limit = hop_limit;
+    entry->tick = now;
+    return 0;
+}
+
+typedef struct {
+    char dest_mac[MAC_SIZE];
+    uint8_t used;           // 0表示空位
+    uint32_t tick;          // 上次因该目标节点刷新路由的时间
+} RouteRefreshEntry;
+
+static RouteRefreshEntry route_refresh[LOOP_CACHE_SIZE];
+static int route_refresh_next = 0;
+
+// 同一目标节点在LOOP_CACHE_TIMEOUT_MS内只刷新一次路由，环路中的多个数据包不会重复发送整张路由表
+static int route_refresh_allowed(const char *dest_mac) {
+    uint32_t now = osKernelGetTickCount();
+    uint32_t timeout = LOOP_CACHE_TIMEOUT_MS * osKernelGetTickFreq() / 1000;
+    for (int i = 0; i < LOOP_CACHE_SIZE; i++) {
+        RouteRefreshEntry *entry = &route_refresh[i];
+        if (entry->used && memcmp(entry->dest_mac, dest_mac, MAC_SIZE) == 0) {
+            if (now - entry->tick <= timeout) {
+                return 0;
+            }
+            entry->tick = now;
+            return 1;
+        }
+    }
+    RouteRefreshEntry *entry = &route_refresh[route_refresh_next];
+    route_refresh_next = (route_refresh_next + 1) % LOOP_CACHE_SIZE;
+    memcpy(entry->dest_mac, dest_mac, MAC_SIZE);
+    entry->used = 1;
+    entry->tick = now;
+    return 1;
+}
+
+// 出现环路说明本节点或父节点关于目标节点的路由已经过期，删除本地记录并重新上报路由表
+static void refresh_route(const char *dest_mac) {
+    if (!route_refresh_allowed(dest_mac)) {
+        return;
+    }
+    LOG("Refreshing route for %.6s\n", dest_mac);
+    int dest_index = (table == NULL) ? -1 : find(table, (unsigned char*)dest_mac);
+    if (dest_index > 0 && graph != NULL) {
+        del_then_gen(&graph, &table, dest_index);
+    }
+    send_route_table_update();
+}
+
+// 转发前检查环路并将剩余跳数减1，返回0表示可以转发，-1表示已丢弃
+static int prepare_forward(char *frame) {
+    uint8_t hop_limit = hex_char_to_int(frame[PACKET_HOP_LIMIT_OFFSET]);
+    if (check_loop(frame, hop_limit)) {
+        LOG("Loop detected, dropping data packet.\n");
+        forward_stats.loop_detected++;
+        refresh_route(frame + PACKET_DEST_MAC_OFFSET);
+        return -1;
+    }
+    if (hop_limit <= 1) {
+        LOG("Hop limit exceeded, dropping data packet.\n");
+        forward_stats.hop_expired++;
+        return -1;
+    }
+    frame[PACKET_HOP_LIMIT_OFFSET] = int_to_hex_char(hop_limit - 1);
+    return 0;
+}
+
+// 根据目标节点在图中的索引，找到通往该节点的直连子节点的MAC地址
+static void get_next_hop_child(int dest_index, char *next_hop_mac) {
+    while (graph->parentArray[dest_index] != 0)
+    {
+        dest_index = graph->parentArray[dest_index];
+    }
+    uc2c(table->indexToMac[dest_index], next_hop_mac);
 }
 
 char* generate_data_packet(DataPacket packet) {
@@ -433,65 +747,626 @@ char* generate_data_packet(DataPacket packet) {
     memcpy(data + 7, packet.dest_mac, MAC_SIZE);
     data[13] = packet.status;
     memcpy(data + 14, packet.packet_num, 3);
-    packet.crc[0] = '0';
-    packet.crc[1] = '0';
-    memcpy(data + 17, packet.crc, 2);
-    memcpy(data + 19, packet.data, 494);
+    data[17] = int_to_hex_char(PACKET_HOP_LIMIT_DEFAULT);
+    data[18] = int_to_hex_char(0);
+    data[19] = packet.port;
+    memcpy(data + 20, packet.data, 493);
     return data;
 }
 
-void broadcast_data_packet(DataPacket packet) {
-    char* packet_data = generate_data_packet(packet);
+PacketBuf* alloc_data_packet(uint16_t data_len) {
+    if (data_len > PACKET_DATA_SIZE) {
+        LOG("Data too long: %d\n", data_len);
+        return NULL;
+    }
+    PacketBuf *buf = HAL_PacketBuf_Alloc(PACKET_DATA_OFFSET + data_len);
+    if (buf == NULL) {
+        LOG("Failed to allocate packet buffer.\n");
+        return NULL;
+    }
+    return buf;
+}
+
+void fill_data_packet_header(PacketBuf *buf, const char *src_mac, const char *dest_mac, char status) {
+    char *frame = buf->payload;
+    frame[PACKET_TYPE_OFFSET] = '1';
+    memcpy(frame + PACKET_SRC_MAC_OFFSET, src_mac, MAC_SIZE);
+    memcpy(frame + PACKET_DEST_MAC_OFFSET, dest_mac, MAC_SIZE);
+    frame[PACKET_STATUS_OFFSET] = status;
+    // 数据包编号按000~999循环，用于环路检测区分同一源节点发出的不同数据包；
+    // 应用线程和路由线程都会组包，计数器用原子操作递增，不加锁
+    static uint32_t packet_num = 0;
+    uint32_t value = __atomic_fetch_add(&packet_num, 1, __ATOMIC_RELAXED) % 1000;
+    char num[4];
+    snprintf(num, sizeof(num), "%03u", (unsigned int)value);
+    memcpy(frame + PACKET_NUM_OFFSET, num, 3);
+    frame[PACKET_HOP_LIMIT_OFFSET] = int_to_hex_char(PACKET_HOP_LIMIT_DEFAULT);
+    frame[PACKET_FLAGS_OFFSET] = int_to_hex_char(0);
+    frame[PACKET_PORT_OFFSET] = PACKET_PORT_DEFAULT;
+}
+
+PacketBuf* create_data_packet(const char *src_mac, const char *dest_mac, char status, const char *data, uint16_t data_len) {
+    PacketBuf *buf = alloc_data_packet(data_len);
+    if (buf == NULL) {
+        return NULL;
+    }
+    fill_data_packet_header(buf, src_mac, dest_mac, status);
+    memcpy(buf->payload + PACKET_DATA_OFFSET, data, data_len);
+    return buf;
+}
+
+PacketBuf* compress_data_packet(PacketBuf *buf) {
+    uint16_t data_len = buf->len - PACKET_DATA_OFFSET;
+    if (data_len <= LZ_MIN_MATCH) {
+        return buf;
+    }
+    // 输出空间比原数据少1字节，压缩后没有变小时直接发送原数据
+    PacketBuf *out = HAL_PacketBuf_Alloc(buf->len - 1);
+    if (out == NULL) {
+        return buf;
+    }
+    int ret = lz_compress((const uint8_t *)buf->payload + PACKET_DATA_OFFSET, data_len,
+                          (uint8_t *)out->payload + PACKET_DATA_OFFSET, data_len - 1);
+    if (ret < 0) {
+        LOG("Data not compressible, sending as is.\n");
+        HAL_PacketBuf_Free(out);
+        return buf;
+    }
+    memcpy(out->payload, buf->payload, PACKET_DATA_OFFSET);
+    uint8_t flags = hex_char_to_int(buf->payload[PACKET_FLAGS_OFFSET]) | PACKET_FLAG_COMPRESSED;
+    out->payload[PACKET_FLAGS_OFFSET] = int_to_hex_char(flags);
+    out->len = PACKET_DATA_OFFSET + ret;
+    out->payload[out->len] = '\0';
+    HAL_PacketBuf_Free(buf);
+    return out;
+}
+
+// 解压数据包的数据位，返回新的缓冲区，失败返回NULL
+static PacketBuf* decompress_data_packet(const PacketBuf *buf) {
+    PacketBuf *out = HAL_PacketBuf_Alloc(PACKET_MAX_SIZE);
+    if (out == NULL) {
+        return NULL;
+    }
+    int ret = lz_decompress((const uint8_t *)buf->payload + PACKET_DATA_OFFSET, buf->len - PACKET_DATA_OFFSET,
+                            (uint8_t *)out->payload + PACKET_DATA_OFFSET, PACKET_DATA_SIZE);
+    if (ret < 0) {
+        LOG("Failed to decompress data packet.\n");
+        HAL_PacketBuf_Free(out);
+        return NULL;
+    }
+    memcpy(out->payload, buf->payload, PACKET_DATA_OFFSET);
+    uint8_t flags = hex_char_to_int(buf->payload[PACKET_FLAGS_OFFSET]) & ~PACKET_FLAG_COMPRESSED;
+    out->payload[PACKET_FLAGS_OFFSET] = int_to_hex_char(flags);
+    out->len = PACKET_DATA_OFFSET + ret;
+    out->payload[out->len] = '\0';
+    return out;
+}
+
+void set_data_transport(DataTransport transport) {
+    data_transport = transport;
+}
+
+void set_receive_queue(uint16_t depth, RxDropPolicy policy) {
+    rx_queue_depth = (depth == 0) ? RX_QUEUE_DEPTH_DEFAULT : depth;
+    rx_drop_policy = policy;
+}
+
+uint32_t get_receive_dropped(void) {
+    return rx_dropped;
+}
+
+void set_reply_handler(ReplyHandler handler) {
+    reply_handler = handler;
+}
+
+static uint8_t data_tx_flags(void) {
+    switch (data_transport) {
+        case DATA_TRANSPORT_UDP:
+            return TX_FLAG_DATAGRAM;
+        case DATA_TRANSPORT_RAW:
+            return TX_FLAG_RAW;
+        default:
+            return 0;
+    }
+}
+
+// 按数据包的传输方式放入子节点的发送队列，由发送线程异步发送
+static int send_buf_to_child(const char *mac, PacketBuf *buf, TxCompleteCallback cb, void *arg) {
+    return tx_engine_submit(mac, buf, data_tx_flags(), cb, arg);
+}
+
+// 按数据包的传输方式放入父节点的发送队列，由发送线程异步发送
+// ingress_mac为转发来源的子节点，NULL表示本节点自己发出，上行链路按来源公平分配
+static int send_buf_to_parent(const char *ingress_mac, PacketBuf *buf, TxCompleteCallback cb, void *arg) {
+    return tx_engine_submit_from(NULL, ingress_mac, buf, data_tx_flags(), cb, arg);
+}
+
+void process_data_packet(const char *mac, PacketBuf *buf);
+
+#if ENABLE_SUBNET_BROADCAST
+typedef struct {
+    int seq;                    // 每跳广播序号，-1 表示空位
+    PacketBuf *buf;             // 持有一次引用
+} BroadcastRepairEntry;
+
+static osMutexId_t broadcast_mutex = NULL;  // 保护广播序号和重发缓存，应用线程和路由线程都会广播
+static uint16_t broadcast_seq = 0;
+static BroadcastRepairEntry broadcast_repair[BROADCAST_REPAIR_SIZE];
+static int last_parent_broadcast_seq = -1;  // 最近收到的父节点广播序号，-1 表示还没有收到
+
+static void broadcast_state_init(void) {
+    if (broadcast_mutex == NULL) {
+        broadcast_mutex = osMutexNew(NULL);
+    }
+    for (int i = 0; i < BROADCAST_REPAIR_SIZE; i++) {
+        broadcast_repair[i].seq = -1;
+        broadcast_repair[i].buf = NULL;
+    }
+}
+
+// 清空重发缓存和广播序号，父节点变化后重新开始
+static void broadcast_state_reset(void) {
+    if (broadcast_mutex == NULL) {
+        return;
+    }
+    osMutexAcquire(broadcast_mutex, osWaitForever);
+    for (int i = 0; i < BROADCAST_REPAIR_SIZE; i++) {
+        HAL_PacketBuf_Free(broadcast_repair[i].buf);
+        broadcast_repair[i].seq = -1;
+        broadcast_repair[i].buf = NULL;
+    }
+    last_parent_broadcast_seq = -1;
+    osMutexRelease(broadcast_mutex);
+}
+
+// 向热点子网发送一次广播，返回0表示已发送，-1表示需要逐个子节点单播
+static int subnet_broadcast(PacketBuf *buf) {
+    if (broadcast_mutex == NULL) {
+        return -1;
+    }
+    osMutexAcquire(broadcast_mutex, osWaitForever);
+    uint16_t seq = broadcast_seq;
+    char header[SUBNET_BROADCAST_HEADER_SIZE + 1];
+    snprintf(header, sizeof(header), "2%03d", seq);
+    if (HAL_Wireless_SendSubnetBroadcast(DEFAULT_WIRELESS_TYPE, header, SUBNET_BROADCAST_HEADER_SIZE,
+                                         buf->payload, buf->len, g_mesh_config.tree_level) != 0) {
+        osMutexRelease(broadcast_mutex);
+        return -1;
+    }
+    broadcast_seq = (broadcast_seq + 1) % 1000;
+    // 保留最近的广播包，子节点丢包时按序号重发
+    BroadcastRepairEntry *entry = &broadcast_repair[seq % BROADCAST_REPAIR_SIZE];
+    HAL_PacketBuf_Free(entry->buf);
+    HAL_PacketBuf_Ref(buf);
+    entry->seq = seq;
+    entry->buf = buf;
+    osMutexRelease(broadcast_mutex);
+    return 0;
+}
+
+// 处理父节点发来的子网广播：检查序号是否连续，去掉帧头后按数据包处理
+static void process_subnet_broadcast(const char *mac, PacketBuf *buf) {
+    if (buf->len <= SUBNET_BROADCAST_HEADER_SIZE || broadcast_mutex == NULL) {
+        return;
+    }
+    char seq_str[4] = {0};
+    memcpy(seq_str, buf->payload + 1, 3);
+    int seq = atoi(seq_str);
+
+    osMutexAcquire(broadcast_mutex, osWaitForever);
+    int first_seen = (last_parent_broadcast_seq == -1);
+    int expected = (last_parent_broadcast_seq + 1) % 1000;
+    int missing = (seq - expected + 1000) % 1000;
+    if (first_seen || missing < 500) {
+        last_parent_broadcast_seq = seq;  // 只接受更新的序号，忽略重复或过期的广播
+    }
+    osMutexRelease(broadcast_mutex);
+#if ENABLE_BROADCAST_NACK
+    // 丢失的广播还在父节点的重发缓存中时才请求重发，NACK通过TCP发送
+    if (!first_seen && missing > 0 && missing <= BROADCAST_REPAIR_SIZE) {
+        LOG("Broadcast %d-%d lost, sending NACK.\n", expected, seq - 1);
+        char nack[8];
+        snprintf(nack, sizeof(nack), "3%03d%03d", expected, missing);
+        send_frame_to_parent(nack, 7);
+    }
+#endif
+    HAL_PacketBuf_Header(buf, -SUBNET_BROADCAST_HEADER_SIZE);
+    process_data_packet(mac, buf);
+}
+
+// 处理子节点的重发请求，把缓存中的广播包单播给该子节点
+static void process_broadcast_nack(const char *mac, PacketBuf *buf) {
+    if (buf->len < 7 || mac[0] == '\0' || broadcast_mutex == NULL) {
+        return;
+    }
+    char num[4] = {0};
+    memcpy(num, buf->payload + 1, 3);
+    int first = atoi(num);
+    memcpy(num, buf->payload + 4, 3);
+    int count = atoi(num);
+    if (count > BROADCAST_REPAIR_SIZE) {
+        count = BROADCAST_REPAIR_SIZE;
+    }
+    osMutexAcquire(broadcast_mutex, osWaitForever);
+    for (int i = 0; i < count; i++) {
+        int seq = (first + i) % 1000;
+        BroadcastRepairEntry *entry = &broadcast_repair[seq % BROADCAST_REPAIR_SIZE];
+        if (entry->seq == seq && entry->buf != NULL) {
+            LOG("Repairing broadcast %d for %s\n", seq, mac);
+            send_buf_to_child(mac, entry->buf, NULL, NULL);
+        }
+    }
+    osMutexRelease(broadcast_mutex);
+}
+#endif
+
+typedef struct {
+    char src_mac[MAC_SIZE];
+    char packet_num[3];
+    uint32_t tick;              // 收到的时间，0 表示空位
+} BroadcastSeenEntry;
+
+static BroadcastSeenEntry broadcast_seen[BROADCAST_SEEN_SIZE];
+static int broadcast_seen_next = 0;
+
+// 检查广播包是否已经收到过（子网广播和重发可能各送达一次），没有收到过则记录下来
+static int broadcast_already_seen(const char *frame) {
+    uint32_t now = osKernelGetTickCount();
+    uint32_t timeout = LOOP_CACHE_TIMEOUT_MS * osKernelGetTickFreq() / 1000;
+    for (int i = 0; i < BROADCAST_SEEN_SIZE; i++) {
+        BroadcastSeenEntry *entry = &broadcast_seen[i];
+        if (entry->tick != 0 && now - entry->tick <= timeout &&
+            memcmp(entry->src_mac, frame + PACKET_SRC_MAC_OFFSET, MAC_SIZE) == 0 &&
+            memcmp(entry->packet_num, frame + PACKET_NUM_OFFSET, 3) == 0) {
+            return 1;
+        }
+    }
+    BroadcastSeenEntry *entry = &broadcast_seen[broadcast_seen_next];
+    broadcast_seen_next = (broadcast_seen_next + 1) % BROADCAST_SEEN_SIZE;
+    memcpy(entry->src_mac, frame + PACKET_SRC_MAC_OFFSET, MAC_SIZE);
+    memcpy(entry->packet_num, frame + PACKET_NUM_OFFSET, 3);
+    entry->tick = now | 1;  // 避免与空位混淆
+    return 0;
+}
+
+void broadcast_data_packet(PacketBuf *buf) {
+#if ENABLE_SUBNET_BROADCAST
+    // 所有子节点都在本节点热点的子网中，发送一次子网广播即可
+    if (subnet_broadcast(buf) == 0) {
+        return;
+    }
+#endif
+    // 同一个缓冲区依次发给所有子节点，不再为广播单独生成数据帧
     char** mac_list = NULL;
     int len_mac_list = HAL_Wireless_GetChildMACs(DEFAULT_WIRELESS_TYPE, &mac_list);
     for (int i = 0; i < len_mac_list; i++) {
-        HAL_Wireless_SendData_to_child(DEFAULT_WIRELESS_TYPE, mac_list[i], packet_data);
+        send_buf_to_child(mac_list[i], buf, NULL, NULL);
         free(mac_list[i]);  // 顺便清理内存
     }
-    free(packet_data);
     free(mac_list);
 }
 
-void send_ack_packet(char* my_mac, DataPacket packet) {
-    memcpy(packet.dest_mac, packet.src_mac, MAC_SIZE);
-    memcpy(packet.src_mac, my_mac, MAC_SIZE);
-    packet.status = '1';
-    strcpy(packet.data, "Received");
-    char* ack_data = generate_data_packet(packet);
-    HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, ack_data, g_mesh_config.tree_level - 1);
-    free(ack_data);
+void send_packet_buf(PacketBuf *buf) {
+    send_packet_buf_async(buf, NULL, NULL);
 }
 
-void put_packet_to_queue(DataPacket packet) {
-    osStatus_t status = osMessageQueuePut(dataPacketQueueId, &packet, 0, 0);
+// 按目标地址查找下一跳，ingress_mac为转发来源的子节点，NULL表示本节点自己发出
+static int route_packet_buf(const char *ingress_mac, PacketBuf *buf, TxCompleteCallback cb, void *arg) {
+    const char *dest_mac = buf->payload + PACKET_DEST_MAC_OFFSET;
+    int dest_index = (table == NULL) ? -1 : find(table, (unsigned char*)dest_mac);
+    if (dest_index == -1) {
+        LOG("Sending data packet to parent node.\n");
+        return send_buf_to_parent(ingress_mac, buf, cb, arg);
+    }
+    LOG("Sending data packet to child node.\n");
+    char next_hop_mac[7] = {0};
+    get_next_hop_child(dest_index, next_hop_mac);
+    return send_buf_to_child(next_hop_mac, buf, cb, arg);
+}
+
+int send_packet_buf_async(PacketBuf *buf, TxCompleteCallback cb, void *arg) {
+    return route_packet_buf(NULL, buf, cb, arg);
+}
+
+// 向数据包的源节点回应，status为回应的状态，data为回应内容
+static void send_reply_packet(const char *my_mac, const PacketBuf *buf, char status, const char *data) {
+    PacketBuf *reply = create_data_packet(my_mac, buf->payload + PACKET_SRC_MAC_OFFSET, status, data, strlen(data));
+    if (reply == NULL) {
+        return;
+    }
+    memcpy(reply->payload + PACKET_NUM_OFFSET, buf->payload + PACKET_NUM_OFFSET, 3);  // 回应包沿用原数据包编号
+    reply->payload[PACKET_PORT_OFFSET] = buf->payload[PACKET_PORT_OFFSET];  // 以及端口，回到发送方对应的接收队列
+    send_packet_buf(reply);
+    HAL_PacketBuf_Free(reply);
+}
+
+void send_ack_packet(const char* my_mac, const PacketBuf *buf) {
+    send_reply_packet(my_mac, buf, '1', "Received");
+}
+
+typedef struct {
+    uint8_t port;
+    osMessageQueueId_t queue;   // NULL 表示空位
+} PortQueue;
+
+typedef struct {
+    uint8_t port;
+    PortHandler handler;        // NULL 表示空位
+} PortHandlerEntry;
+
+static osMutexId_t port_mutex = NULL;  // 保护端口绑定表，应用线程绑定、路由线程投递
+static PortQueue port_queues[PACKET_MAX_PORTS];
+static PortHandlerEntry port_handlers[PACKET_MAX_PORT_HANDLERS];  // 只增不减，路由线程读取时不需要加锁
+
+int set_port_handler(uint8_t port, PortHandler handler) {
+    if (port == PACKET_PORT_DEFAULT || handler == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < PACKET_MAX_PORT_HANDLERS; i++) {
+        if (port_handlers[i].handler == NULL || port_handlers[i].port == port) {
+            // 先写端口再写处理函数，路由线程看到处理函数时端口已经有效
+            port_handlers[i].port = port;
+            port_handlers[i].handler = handler;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int bind_port_queue(uint8_t port, osMessageQueueId_t queue) {
+    if (port == PACKET_PORT_DEFAULT) {
+        return -1;
+    }
+    if (port_mutex == NULL) {
+        port_mutex = osMutexNew(NULL);
+        if (port_mutex == NULL) {
+            return -1;
+        }
+    }
+    int ret = -1;
+    osMutexAcquire(port_mutex, osWaitForever);
+    PortQueue *slot = NULL;
+    for (int i = 0; i < PACKET_MAX_PORTS; i++) {
+        if (port_queues[i].queue != NULL && port_queues[i].port == port) {
+            slot = &port_queues[i];
+            break;
+        }
+        if (port_queues[i].queue == NULL && slot == NULL && queue != NULL) {
+            slot = &port_queues[i];
+        }
+    }
+    if (queue == NULL) {
+        // 解除绑定
+        if (slot != NULL) {
+            slot->queue = NULL;
+            ret = 0;
+        }
+    } else if (slot != NULL && slot->queue == NULL) {
+        slot->port = port;
+        slot->queue = queue;
+        ret = 0;
+    }
+    osMutexRelease(port_mutex);
+    return ret;
+}
+
+osMessageQueueId_t get_port_queue(uint8_t port) {
+    if (port == PACKET_PORT_DEFAULT) {
+        return dataPacketQueueId;
+    }
+    if (port_mutex == NULL) {
+        return NULL;
+    }
+    osMessageQueueId_t queue = NULL;
+    osMutexAcquire(port_mutex, osWaitForever);
+    for (int i = 0; i < PACKET_MAX_PORTS; i++) {
+        if (port_queues[i].queue != NULL && port_queues[i].port == port) {
+            queue = port_queues[i].queue;
+            break;
+        }
+    }
+    osMutexRelease(port_mutex);
+    return queue;
+}
+
+// 放入接收队列，队列满时按丢弃策略处理；丢弃最早的数据包时与应用线程的读取并发也不会出错，
+// 最坏情况是应用恰好取走了队首，这次不需要丢弃
+static osStatus_t queue_put(osMessageQueueId_t queue, PacketBuf *buf) {
+    osStatus_t status = osMessageQueuePut(queue, &buf, 0, 0);
+    if (status != osOK && rx_drop_policy == RX_DROP_OLDEST) {
+        PacketBuf *oldest = NULL;
+        if (osMessageQueueGet(queue, &oldest, NULL, 0) == osOK) {
+            HAL_PacketBuf_Free(oldest);
+            rx_dropped++;
+        }
+        status = osMessageQueuePut(queue, &buf, 0, 0);
+    }
+    return status;
+}
+
+void put_packet_to_queue(PacketBuf *buf) {
+    uint8_t port = (uint8_t)buf->payload[PACKET_PORT_OFFSET];
+    for (int i = 0; i < PACKET_MAX_PORT_HANDLERS; i++) {
+        if (port_handlers[i].handler != NULL && port_handlers[i].port == port) {
+            port_handlers[i].handler(buf);
+            return;
+        }
+    }
+    // 队列中只存放缓冲区指针，队列持有一次引用，由接收方释放
+    HAL_PacketBuf_Ref(buf);
+    osStatus_t status = osErrorResource;
+    if (port == PACKET_PORT_DEFAULT) {
+        status = queue_put(dataPacketQueueId, buf);
+    } else if (port_mutex != NULL) {
+        // 持有锁投递，解除绑定的线程等投递完成后才能删除队列
+        osMutexAcquire(port_mutex, osWaitForever);
+        for (int i = 0; i < PACKET_MAX_PORTS; i++) {
+            if (port_queues[i].queue != NULL && port_queues[i].port == port) {
+                status = queue_put(port_queues[i].queue, buf);
+                break;
+            }
+        }
+        osMutexRelease(port_mutex);
+    }
     if (status != osOK) {
-        LOG("Failed to put data packet to queue.\n");
+        LOG("Failed to put data packet to queue of port %d.\n", port);
+        HAL_PacketBuf_Free(buf);
+        rx_dropped++;
     }
 }
 
-void process_data_packet(const char *mac, char *data)
+// 交给应用层：压缩的数据包先解压再入队，转发仍使用压缩后的数据
+static void deliver_packet(PacketBuf *buf) {
+    if ((hex_char_to_int(buf->payload[PACKET_FLAGS_OFFSET]) & PACKET_FLAG_COMPRESSED) == 0) {
+        put_packet_to_queue(buf);
+        return;
+    }
+    PacketBuf *plain = decompress_data_packet(buf);
+    if (plain == NULL) {
+        rx_dropped++;
+        return;
+    }
+    put_packet_to_queue(plain);
+    HAL_PacketBuf_Free(plain);
+}
+
+// 取出发布包的主题在订阅摘要中对应的位，格式错误时返回0
+static uint32_t publish_topic_mask(const PacketBuf *buf) {
+    if (buf->len <= PACKET_DATA_OFFSET) {
+        return 0;
+    }
+    uint8_t len = (uint8_t)buf->payload[PACKET_DATA_OFFSET];
+    if (len == 0 || len > PACKET_TOPIC_MAX_LEN || buf->len < PACKET_DATA_OFFSET + 1 + len) {
+        return 0;
+    }
+    return topic_summary_mask(buf->payload + PACKET_DATA_OFFSET + 1, len);
+}
+
+// 把发布包发给子树中有订阅者的子节点，没有报过订阅摘要的子节点照常发送
+static void forward_publish(PacketBuf *buf, uint32_t mask) {
+    char** mac_list = NULL;
+    int len_mac_list = HAL_Wireless_GetChildMACs(DEFAULT_WIRELESS_TYPE, &mac_list);
+    for (int i = 0; i < len_mac_list; i++) {
+        ChildSubscription *entry = find_child_subscription(mac_list[i]);
+        if (entry == NULL || (entry->summary & mask) != 0) {
+            send_buf_to_child(mac_list[i], buf, NULL, NULL);
+        } else {
+            forward_stats.publish_pruned++;
+        }
+        free(mac_list[i]);
+    }
+    free(mac_list);
+}
+
+void publish_data_packet(PacketBuf *buf) {
+    uint32_t mask = publish_topic_mask(buf);
+    if (mask == 0) {
+        return;
+    }
+    if ((local_subscriptions & mask) != 0) {
+        deliver_packet(buf);
+    }
+    forward_publish(buf, mask);
+}
+
+#if ENABLE_CUT_THROUGH
+// 直通转发：只读取帧头中的目标地址做下一跳判断，直接转发收到的原始数据
+// 返回0表示已转发，-1表示需要走完整的解析流程（广播包、发给自己的包、根节点的不可达应答）
+static int cut_through_forward(const char *mac, PacketBuf *buf) {
+    char *data = buf->payload;
+    const char *dest_mac = data + PACKET_DEST_MAC_OFFSET;
+    if (strncmp(dest_mac, "FFFFFF", MAC_SIZE) == 0) {
+        return -1;
+    }
+    if ((data[PACKET_STATUS_OFFSET] == '3' || data[PACKET_STATUS_OFFSET] == PACKET_STATUS_PUBLISH_REQUEST) &&
+        g_mesh_config.tree_level == 0) {
+        return -1;
+    }
+    char my_mac[MAC_SIZE + 1] = {0};
+    if (HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac) != 0 || strncmp(dest_mac, my_mac, MAC_SIZE) == 0) {
+        return -1;
+    }
+    int dest_index = (table == NULL) ? -1 : find(table, (unsigned char*)dest_mac);
+    if (dest_index == -1) {
+        if (g_mesh_config.tree_level == 0) {
+            return -1;  // 根节点需要解析源地址，回应目标节点不在网络中
+        }
+        if (prepare_forward(data) != 0) {
+            return 0;
+        }
+        LOG("Cut-through forwarding data packet to parent node.\n");
+        send_buf_to_parent(mac, buf, NULL, NULL);
+        return 0;
+    }
+    if (prepare_forward(data) != 0) {
+        return 0;
+    }
+    LOG("Cut-through forwarding data packet to child node.\n");
+    char next_hop_mac[7] = {0};
+    get_next_hop_child(dest_index, next_hop_mac);
+    send_buf_to_child(next_hop_mac, buf, NULL, NULL);
+    return 0;
+}
+#endif
+
+// 处理已放入缓冲区的数据包，mac为上一跳，start为开始处理该数据包时的系统计数
+static void process_data_buf(const char *mac, PacketBuf *buf, uint32_t start)
 {
-    UNUSED(mac);
-    LOG("Received data packet from MAC: %s, data: %s\n", mac, data);
-    // 解析数据包
-    DataPacket packet = parse_data_packet(data);
-    
+    char *frame = buf->payload;
+    // 父节点发来的发布包，只发给有订阅者的子树
+    if (frame[PACKET_STATUS_OFFSET] == PACKET_STATUS_PUBLISH) {
+        uint32_t mask = publish_topic_mask(buf);
+        if (mask == 0) {
+            return;
+        }
+        if ((local_subscriptions & mask) != 0) {
+            deliver_packet(buf);
+        }
+        uint8_t hop_limit = hex_char_to_int(frame[PACKET_HOP_LIMIT_OFFSET]);
+        if (hop_limit <= 1) {
+            forward_stats.hop_expired++;
+            return;
+        }
+        frame[PACKET_HOP_LIMIT_OFFSET] = int_to_hex_char(hop_limit - 1);
+        forward_publish(buf, mask);
+        return;
+    }
     // 如果是广播数据包，直接向下广播
-    if (strncmp(packet.dest_mac, "FFFFFF", MAC_SIZE) == 0) {
+    if (strncmp(frame + PACKET_DEST_MAC_OFFSET, "FFFFFF", MAC_SIZE) == 0) {
+        if (broadcast_already_seen(frame)) {
+            LOG("Duplicate broadcast, dropped.\n");
+            return;
+        }
         LOG("Broadcast data packet.\n");
-        LOG("Broadcast data: %s", packet.data);
-        put_packet_to_queue(packet);  // 将数据包放入队列
-        broadcast_data_packet(packet);
+        LOG("Broadcast data: %s", frame + PACKET_DATA_OFFSET);
+        deliver_packet(buf);  // 将数据包放入队列
+        uint8_t hop_limit = hex_char_to_int(frame[PACKET_HOP_LIMIT_OFFSET]);
+        if (hop_limit <= 1) {
+            forward_stats.hop_expired++;
+            return;
+        }
+        frame[PACKET_HOP_LIMIT_OFFSET] = int_to_hex_char(hop_limit - 1);
+        broadcast_data_packet(buf);
         return;
     }
 
     // 如果是广播请求包，并且自己是根节点，则开始广播
-    if (packet.status == '3' && g_mesh_config.tree_level == 0) {
+    if (frame[PACKET_STATUS_OFFSET] == '3' && g_mesh_config.tree_level == 0) {
         LOG("Received broadcast request.\n");
-        strcpy(packet.dest_mac, "FFFFFF");
-        packet.status = '4';  // 表示广播包
-        put_packet_to_queue(packet);  // 将数据包放入队列
-        broadcast_data_packet(packet);
+        memcpy(frame + PACKET_DEST_MAC_OFFSET, "FFFFFF", MAC_SIZE);
+        frame[PACKET_STATUS_OFFSET] = '4';  // 表示广播包
+        frame[PACKET_HOP_LIMIT_OFFSET] = int_to_hex_char(PACKET_HOP_LIMIT_DEFAULT);  // 从根节点重新开始计算跳数
+        deliver_packet(buf);  // 将数据包放入队列
+        broadcast_data_packet(buf);
+        return;
+    }
+    // 如果是发布请求，并且自己是根节点，则开始向有订阅者的子树分发
+    if (frame[PACKET_STATUS_OFFSET] == PACKET_STATUS_PUBLISH_REQUEST && g_mesh_config.tree_level == 0) {
+        LOG("Received publish request.\n");
+        memcpy(frame + PACKET_DEST_MAC_OFFSET, "FFFFFF", MAC_SIZE);
+        frame[PACKET_STATUS_OFFSET] = PACKET_STATUS_PUBLISH;
+        frame[PACKET_HOP_LIMIT_OFFSET] = int_to_hex_char(PACKET_HOP_LIMIT_DEFAULT);  // 从根节点重新开始计算跳数
+        publish_data_packet(buf);
         return;
     }
     // 获取自己的MAC地址
@@ -500,73 +1375,117 @@ void process_data_packet(const char *mac, char *data)
         LOG("Failed to get MAC address.\n");
     }
     // 如果是目标节点，则处理数据包
-    if (strncmp(packet.dest_mac, my_mac, MAC_SIZE) == 0) {
+    if (strncmp(frame + PACKET_DEST_MAC_OFFSET, my_mac, MAC_SIZE) == 0) {
         LOG("Received data packet for me.\n");
-        LOG("Data: %s\n", packet.data);
-        put_packet_to_queue(packet);  // 将数据包放入队列
-        // 回应收到, status = 1
-        if (packet.status == '0') {
-            send_ack_packet(my_mac, packet);
+        LOG("Data: %s\n", frame + PACKET_DATA_OFFSET);
+        // 收到应答（status = 1）或目标不可达（status = 2）时，先交给等待应答的发送方
+        char status = frame[PACKET_STATUS_OFFSET];
+        if ((status == '1' || status == '2') && reply_handler != NULL && reply_handler(buf) == 0) {
+            return;
+        }
+        deliver_packet(buf);  // 将数据包放入队列
+        // 回应收到, status = 1；PACKET_STATUS_NO_ACK由上层协议自己确认
+        if (frame[PACKET_STATUS_OFFSET] == '0') {
+            send_ack_packet(my_mac, buf);
         }
     } else {
         // 如果不是目标节点，则转发数据包
         LOG("Forwarding data packet...\n");
         // 查找哈希表，分析节点是否在图中
-        int dest_index = find(table, (unsigned char*)packet.dest_mac);
-        if (dest_index == -1) {
-            LOG("Forwarding data packet to parent node.\n");
-            if (g_mesh_config.tree_level == 0) {
-                LOG("target node not in mesh network\n");
-                // 回应status = 2
-                memcpy(packet.dest_mac, packet.src_mac, MAC_SIZE);
-                memcpy(packet.src_mac, my_mac, MAC_SIZE);
-                packet.status = '2';
-                strcpy(packet.data, "Target node not in mesh network");
-                char* ack_data = generate_data_packet(packet);
-                HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, ack_data, g_mesh_config.tree_level - 1);
-                free(ack_data);
-                return;
-            }
-            HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, data, g_mesh_config.tree_level - 1);
+        int dest_index = (table == NULL) ? -1 : find(table, (unsigned char*)(frame + PACKET_DEST_MAC_OFFSET));
+        if (dest_index == -1 && g_mesh_config.tree_level == 0) {
+            LOG("target node not in mesh network\n");
+            // 回应status = 2
+            send_reply_packet(my_mac, buf, '2', "Target node not in mesh network");
+            return;
+        }
+        if (prepare_forward(frame) != 0) {
             return;
-        }else {
-            LOG("Forwarding data packet to child node.\n");
-            while (graph->parentArray[dest_index] != 0) 
-            {
-                dest_index = graph->parentArray[dest_index];
-            }
-            char dest_mac[7] = {0};
-            uc2c(table->indexToMac[dest_index], dest_mac);
-            HAL_Wireless_SendData_to_child(DEFAULT_WIRELESS_TYPE, dest_mac, data);
         }
+        route_packet_buf(mac, buf, NULL, NULL);
+        record_forward_time(start);
+    }
+}
+
+void process_data_packet(const char *mac, PacketBuf *buf)
+{
+    LOG("Received data packet from MAC: %s, data: %s\n", mac, buf->payload);
+    uint32_t start = osKernelGetSysTimerCount();
+    if (buf->len < PACKET_DATA_OFFSET || buf->len > PACKET_MAX_SIZE) {
+        LOG("Invalid data packet length: %d\n", buf->len);
+        return;
+    }
+#if ENABLE_CUT_THROUGH
+    // 中继节点不解析、不拷贝数据位，直接转发
+    if (cut_through_forward(mac, buf) == 0) {
+        record_forward_time(start);
+        return;
     }
+#endif
+    // 接收到的帧已经在缓冲区中，后续入队、广播、应答都只传递缓冲区指针
+    process_data_buf(mac, buf, start);
 }
 
 void send_data_packet(const char *dest_mac, const char *data) {
-    // 创建数据包
-    DataPacket packet;
-    packet.type = '1';
+    send_data_packet_ex(dest_mac, data, 0);
+}
+
+void send_data_packet_ex(const char *dest_mac, const char *data, uint8_t flags) {
+    send_data_packet_len(dest_mac, data, strnlen(data, PACKET_DATA_SIZE), flags);
+}
+
+int send_data_packet_len(const char *dest_mac, const char *data, uint16_t len, uint8_t flags) {
+    // 创建数据包，数据按长度直接写入缓冲区，可以包含'\0'
     char my_mac[MAC_SIZE + 1] = {0};
     if(HAL_Wireless_GetNodeMAC(DEFAULT_WIRELESS_TYPE, my_mac) != 0) {
         LOG("Failed to get MAC address.\n");
     }
-    memcpy(packet.src_mac, my_mac, MAC_SIZE);
-    memcpy(packet.dest_mac, dest_mac, MAC_SIZE);
-    packet.status = '0';
-    memcpy(packet.packet_num, "000", 3);
-    strcpy(packet.data, data);
-    char* packet_data = generate_data_packet(packet);
-    LOG("Sending data packet to MAC: %s, data: %s\n", dest_mac, packet_data);
+    PacketBuf *buf = create_data_packet(my_mac, dest_mac, '0', data, len);
+    if (buf == NULL) {
+        return -1;
+    }
+    LOG("Sending data packet to MAC: %s, len: %d\n", dest_mac, len);
+    if (flags & PACKET_FLAG_COMPRESSED) {
+        buf = compress_data_packet(buf);
+    }
     // 发送数据包
-    if (find(table, (unsigned char*)dest_mac) == -1) {
-        HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, packet_data, g_mesh_config.tree_level - 1);
-        LOG("Forwarding data packet to parent node.\n");
-    }else {
-        HAL_Wireless_SendData_to_child(DEFAULT_WIRELESS_TYPE, dest_mac, packet_data);
-        LOG("Forwarding data packet to child node.\n");
+    int ret = send_packet_buf_async(buf, NULL, NULL);
+    HAL_PacketBuf_Free(buf);
+    return ret;
+}
+
+#if ENABLE_TX_AGGREGATION
+static void release_bundle(void *arg) {
+    HAL_PacketBuf_Free((PacketBuf *)arg);
+}
+
+// 拆开上一跳发来的合并帧，每个数据帧按单独收到的数据包处理；
+// 数据帧直接引用合并帧中的数据，需要转发的在新的下一跳队列中重新合并
+static void process_bundle(const char *mac, PacketBuf *bundle) {
+    uint16_t offset = TX_BUNDLE_HEADER_SIZE;
+    uint16_t frame_len = 0;
+    char *frame = NULL;
+    while ((frame = tx_bundle_next(bundle->payload, bundle->len, &offset, &frame_len)) != NULL) {
+        if (frame[PACKET_TYPE_OFFSET] != '1') {
+            continue;  // 只有数据包会被合并
+        }
+        HAL_PacketBuf_Ref(bundle);
+        PacketBuf *buf = HAL_PacketBuf_Wrap(frame, frame_len, release_bundle, bundle);
+        if (buf == NULL) {
+            // 引用描述符用完时拷贝出来
+            HAL_PacketBuf_Free(bundle);
+            buf = HAL_PacketBuf_Alloc(frame_len);
+            if (buf == NULL) {
+                LOG("Failed to allocate packet buffer for bundled frame.\n");
+                continue;
+            }
+            memcpy(buf->payload, frame, frame_len);
+        }
+        process_data_packet(mac, buf);
+        HAL_PacketBuf_Free(buf);
     }
-    free(packet_data);
 }
+#endif
 
 // 发送自己的路由表给父节点
 void send_route_table_to_parent(void)
@@ -590,9 +1509,7 @@ void send_route_table_to_parent(void)
     // 发送自己的路由表给父节点
     if (len_mac_list == 0 && g_mesh_config.tree_level != 0) {
         LOG("No child nodes.\n");
-        char msg[10];
-        sprintf(msg, "0\n1\n%s -1", my_mac);
-        HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, msg, g_mesh_config.tree_level - 1);
+        send_leaf_route_to_parent(my_mac);
         return;
     }
 
@@ -611,9 +1528,8 @@ void del_overdue_nodes(void) {
         free_graph(graph);
         clean_hash_table(table);
         graph = NULL;
-        char msg[10];
-        sprintf(msg, "0\n1\n%s -1", table->indexToMac[0]);
-        HAL_Wireless_SendData_to_parent(DEFAULT_WIRELESS_TYPE, msg, g_mesh_config.tree_level - 1);
+        clear_child_subscriptions();
+        send_leaf_route_to_parent((const char *)table->indexToMac[0]);
         return;
     }
 
@@ -638,6 +1554,7 @@ void del_overdue_nodes(void) {
         }
         if (found == 0) {
             del_then_gen(&graph, &table, find(table, (unsigned char*)graph_mac_list[i]));
+            remove_child_subscription(graph_mac_list[i]);
         }
     }
 
@@ -654,12 +1571,21 @@ void del_overdue_nodes(void) {
 
 void route_transport_task(void)
 {
-    // 创建数据包队列
-    dataPacketQueueId = osMessageQueueNew(QUEUE_SIZE, sizeof(DataPacket), NULL);
+    if (HAL_PacketBuf_Init() != 0) {
+        LOG("Failed to init packet buffer pool.\n");
+        return;
+    }
+    // 创建数据包队列，队列中存放数据包缓冲区指针
+    dataPacketQueueId = osMessageQueueNew(rx_queue_depth, sizeof(PacketBuf *), NULL);
     if (dataPacketQueueId == NULL) {
         LOG("Failed to create data packet queue.\n");
         return;
     }
+    // 所有发送都交给发送线程，接收循环不会因为某个邻居不可达而阻塞
+    if (tx_engine_init() != 0) {
+        LOG("Failed to init TX engine.\n");
+        return;
+    }
     // 创建监听服务器
     int server_fd = HAL_Wireless_CreateServer(DEFAULT_WIRELESS_TYPE);
     if (server_fd < 0) {
@@ -667,49 +1593,106 @@ void route_transport_task(void)
         return;
     }
     LOG("Server created successfully.\n");
+    // 数据报模式下数据包改走UDP，与TCP连接由同一个接收服务器处理
+    if (data_transport == DATA_TRANSPORT_UDP && HAL_Wireless_OpenDatagram(DEFAULT_WIRELESS_TYPE) != 0) {
+        LOG("Failed to open datagram socket, falling back to TCP.\n");
+        data_transport = DATA_TRANSPORT_TCP;
+    }
+    // 链路层模式下数据包直接封装在以太网帧中，路由包、绑定心跳和子网广播仍走IP
+    if (data_transport == DATA_TRANSPORT_RAW && HAL_Wireless_OpenRawLink(DEFAULT_WIRELESS_TYPE) != 0) {
+        LOG("Failed to open raw link, falling back to TCP.\n");
+        data_transport = DATA_TRANSPORT_TCP;
+    }
+#if ENABLE_SUBNET_BROADCAST
+    // 子网广播同样通过数据报接收，打开失败时广播退回逐个子节点单播
+    broadcast_state_init();
+    if (HAL_Wireless_OpenDatagram(DEFAULT_WIRELESS_TYPE) != 0) {
+        LOG("Failed to open datagram socket for subnet broadcast.\n");
+    }
+#endif
     int status = 1;
+    uint32_t last_maintain = osKernelGetTickCount();
     while (1)
     {
-        uint32_t flags = osEventFlagsWait(route_transport_event_flags, ROUTE_TRANSPORT_START_BIT | ROUTE_TRANSPORT_STOP_BIT, osFlagsWaitAny, 200);
-        del_overdue_nodes();
+        // 所有输入在同一个select中等待：数据帧、数据报、绑定心跳和网络状态机的事件，
+        // 任何一个就绪都立即返回，不再先等待事件标志再接收
+        char mac[7] = {0};
+        PacketBuf *frame = NULL;
+        int ret = HAL_Wireless_ReceiveFrameFromClient(DEFAULT_WIRELESS_TYPE, server_fd, mac, &frame);
+
+        // 事件标志只检查不等待，网络状态机设置标志后会唤醒接收
+        uint32_t flags = osEventFlagsWait(route_transport_event_flags, ROUTE_TRANSPORT_START_BIT | ROUTE_TRANSPORT_STOP_BIT, osFlagsWaitAny, 0);
+        if (flags & osFlagsError) {
+            flags = 0;
+        }
         LOG("flag:0x%08X\n", flags);
-        if (flags & ROUTE_TRANSPORT_STOP_BIT && flags != osFlagsErrorTimeout) {
+        if (flags & ROUTE_TRANSPORT_STOP_BIT) {
             LOG("Stop route transport task.\n");
             // 清空哈希表和图
             free_hash_table(table);
             free_graph(graph);
             table = NULL;
             graph = NULL;
+            clear_child_subscriptions();
+            reported_subscriptions = 0;
+#if ENABLE_SUBNET_BROADCAST
+            broadcast_state_reset();
+#endif
+            tx_engine_reset();
             status = 0;
-        }else if (flags & ROUTE_TRANSPORT_START_BIT && flags != osFlagsErrorTimeout) {
+        }else if (flags & ROUTE_TRANSPORT_START_BIT) {
             LOG("Start route transport task.\n");
             send_route_table_to_parent();
             status = 1;
         }
-        if (status == 0) {
-            continue;
+        // 子节点离开的检查不需要每收到一帧都做，空闲或超过维护周期时执行
+        uint32_t now = osKernelGetTickCount();
+        if (status == 1 && (ret < 0 || now - last_maintain >= ROUTE_MAINTAIN_INTERVAL_MS * osKernelGetTickFreq() / 1000)) {
+            del_overdue_nodes();
+            report_subscription_changes();
+            last_maintain = now;
         }
-        char mac[7] = {0};
-        char buffer[50] = {0};
-        int ret = HAL_Wireless_ReceiveDataFromClient(DEFAULT_WIRELESS_TYPE, server_fd, mac, buffer, sizeof(buffer));
         if (ret < 0) {
             LOG("nothing sent from client.\n");
             continue;
         }
-        switch (buffer[0])
+        if (status == 0) {
+            HAL_PacketBuf_Free(frame);
+            continue;
+        }
+        LOG("Received data from client: %s, MAC: %s\n", frame->payload, mac);
+        switch (frame->payload[0])
         {
         case'0':
-            // 路由包
-            process_route_packet(mac, buffer);
+            // 路由包，按字符串解析；路由包只通过控制面连接发送，不以'\0'结尾的零拷贝数据报直接丢弃
+            if (frame->pool != PACKET_BUF_POOL_REF) {
+                process_route_packet(mac, frame->payload);
+            }
             break;
         case '1':
             // 数据包
-            process_data_packet(mac, buffer);
+            process_data_packet(mac, frame);
             break;
+#if ENABLE_SUBNET_BROADCAST
+        case '2':
+            // 父节点的子网广播
+            process_subnet_broadcast(mac, frame);
+            break;
+        case '3':
+            // 子节点的广播重发请求
+            process_broadcast_nack(mac, frame);
+            break;
+#endif
+#if ENABLE_TX_AGGREGATION
+        case TX_BUNDLE_TYPE:
+            // 上一跳合并发送的多个数据包
+            process_bundle(mac, frame);
+            break;
+#endif
         default:
             break;
         }
-        LOG("Received data from client: %s, MAC: %s\n", buffer, mac);
+        HAL_PacketBuf_Free(frame);
     }
     HAL_Wireless_CloseServer(DEFAULT_WIRELESS_TYPE, server_fd);
     
@@ -0,0 +1,692 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "cmsis_os2.h"
+#include "hal_wireless.h"
+#include "hal_packet_buf.h"
+#include "network_fsm.h"
+#include "tx_engine.h"
+#include "std_def.h"
+
+extern MeshNetworkConfig g_mesh_config;
+
+// 定义宏开关，打开或关闭日志输出
+#define ENABLE_LOG 0  // 1 表示开启日志，0 表示关闭日志
+
+// 定义 LOG 宏，如果 ENABLE_LOG 为 1，则打印日志，并输出文件名、行号、日志内容
+#if ENABLE_LOG
+    #define LOG(fmt, ...) printf("LOG [%s:%d]: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+    #define LOG(fmt, ...) do { UNUSED(fmt); } while (0)
+#endif
+
+#define TX_WAKE_BIT (1 << 0)
+#define TX_PARENT_QUEUE 0   // 0号队列固定给父节点
+
+typedef struct {
+    PacketBuf *buf;
+    const char *data;       // 提交时的数据位置，之后缓冲区帧头变化不影响发送
+    uint16_t len;
+    uint8_t flags;
+    uint32_t tick;          // 入队时间
+    TxCompleteCallback cb;
+    void *arg;
+} TxItem;
+
+typedef struct {
+    TxItem items[TX_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+} TxRing;
+
+typedef struct {
+    char mac[7];            // 子节点MAC地址，父节点队列为空字符串
+    TxRing rings[TX_PLANE_MAX];  // 每个平面一个环形队列
+    bool backoff;           // 发送失败后暂停到retry_tick
+    uint32_t retry_tick;
+} TxQueue;
+
+#if ENABLE_TX_FAIR_QUEUE
+// 父节点数据面按入口分的队列，0号固定给本节点自己
+typedef struct {
+    TxRing ring;
+    int32_t deficit;        // 本轮还可以发送的字节数
+    bool pinned;            // 设置过权重，队列为空时也不让给其他子节点
+    TxFairQueueStats stats;
+} TxFairQueue;
+
+static TxFairQueue tx_fair[TX_FAIR_QUEUES];
+static int drr_current = 0;                 // 轮询到的队列
+static bool drr_credited = false;           // 本次轮到时是否已经加上配额
+#endif
+
+static TxQueue tx_queues[TX_MAX_NEXT_HOPS];
+static TxEngineStats tx_stats;
+static bool tx_flush = false;               // 由发送线程清空队列，避免释放正在发送的数据包
+static osMutexId_t tx_mutex = NULL;         // 保护发送队列和统计信息
+static osEventFlagsId_t tx_event_flags = NULL;
+static osThreadId_t tx_thread_id = NULL;
+static TxAggregationConfig tx_aggregation = {TX_AGGREGATE_DELAY_MS, TX_AGGREGATE_THRESHOLD};
+
+static uint32_t ms_to_ticks(uint32_t ms) {
+    return ms * osKernelGetTickFreq() / 1000;
+}
+
+static int queue_count(const TxQueue *q) {
+    int count = q->rings[TX_PLANE_DATA].count + q->rings[TX_PLANE_CONTROL].count;
+#if ENABLE_TX_FAIR_QUEUE
+    if (q == &tx_queues[TX_PARENT_QUEUE]) {
+        for (int i = 0; i < TX_FAIR_QUEUES; i++) {
+            count += tx_fair[i].ring.count;
+        }
+    }
+#endif
+    return count;
+}
+
+static TxPlane item_plane(const TxItem *item) {
+    return (item->flags & TX_FLAG_CONTROL) ? TX_PLANE_CONTROL : TX_PLANE_DATA;
+}
+
+// 按下一跳查找发送队列，子节点没有队列时占用一个空队列，需要持有tx_mutex
+static TxQueue *find_queue(const char *next_hop_mac) {
+    if (next_hop_mac == NULL) {
+        return &tx_queues[TX_PARENT_QUEUE];
+    }
+    TxQueue *empty = NULL;
+    for (int i = TX_PARENT_QUEUE + 1; i < TX_MAX_NEXT_HOPS; i++) {
+        TxQueue *q = &tx_queues[i];
+        if (strncmp(q->mac, next_hop_mac, 6) == 0) {
+            return q;
+        }
+        if (empty == NULL && queue_count(q) == 0) {
+            empty = q;
+        }
+    }
+    if (empty != NULL) {
+        strncpy(empty->mac, next_hop_mac, 6);
+        empty->mac[6] = '\0';
+        empty->backoff = false;
+    }
+    return empty;
+}
+
+// 取出队首数据包，需要持有tx_mutex
+static TxItem pop_item(TxRing *ring) {
+    TxItem item = ring->items[ring->head];
+    ring->head = (ring->head + 1) % TX_QUEUE_DEPTH;
+    ring->count--;
+    tx_stats.plane[item_plane(&item)].backlog--;
+    return item;
+}
+
+static void complete_item(TxItem *item, int result) {
+    osMutexAcquire(tx_mutex, osWaitForever);
+    TxPlaneStats *stats = &tx_stats.plane[item_plane(item)];
+    switch (result) {
+        case TX_RESULT_OK:      stats->sent++;    break;
+        case TX_RESULT_FAILED:  stats->failed++;  break;
+        case TX_RESULT_TIMEOUT: stats->timeout++; break;
+        default:                stats->dropped++; break;
+    }
+    osMutexRelease(tx_mutex);
+    if (item->cb != NULL) {
+        item->cb(item->buf, result, item->arg);
+    }
+    HAL_PacketBuf_Free(item->buf);
+}
+
+static int send_item(const TxQueue *q, const TxItem *item) {
+    bool to_parent = (q == &tx_queues[TX_PARENT_QUEUE]);
+    int parent_level = g_mesh_config.tree_level - 1;
+    if (item->flags & TX_FLAG_CONTROL) {
+        return to_parent ? HAL_Wireless_TrySendControl_to_parent(DEFAULT_WIRELESS_TYPE, item->data, item->len, parent_level)
+                         : HAL_Wireless_TrySendControl_to_child(DEFAULT_WIRELESS_TYPE, q->mac, item->data, item->len);
+    }
+    if (item->flags & TX_FLAG_RAW) {
+        int ret = to_parent ? HAL_Wireless_SendRaw_to_parent(DEFAULT_WIRELESS_TYPE, item->data, item->len)
+                            : HAL_Wireless_SendRaw_to_child(DEFAULT_WIRELESS_TYPE, q->mac, item->data, item->len);
+        return ret == 0 ? 0 : -1;
+    }
+    if (item->flags & TX_FLAG_DATAGRAM) {
+        // 数据报不需要建立连接，直接发送
+        int ret = to_parent ? HAL_Wireless_SendDatagram_to_parent(DEFAULT_WIRELESS_TYPE, item->data, item->len, parent_level)
+                            : HAL_Wireless_SendDatagram_to_child(DEFAULT_WIRELESS_TYPE, q->mac, item->data, item->len);
+        return ret == 0 ? 0 : -1;
+    }
+    return to_parent ? HAL_Wireless_TrySendFrame_to_parent(DEFAULT_WIRELESS_TYPE, item->data, item->len, parent_level)
+                     : HAL_Wireless_TrySendFrame_to_child(DEFAULT_WIRELESS_TYPE, q->mac, item->data, item->len);
+}
+
+#if ENABLE_TX_AGGREGATION
+// 决定数据面这次发送几个数据帧，需要持有tx_mutex
+// 从队首开始收集传输方式相同、合并后不超过最大长度的数据帧；还有可能攒到更多时等待，
+// 返回0表示继续等待，*hold_ticks更新为最早需要再次检查的时间
+static int plan_bundle(const TxRing *ring, uint32_t now, uint32_t *hold_ticks) {
+    const TxItem *head = &ring->items[ring->head];
+    uint16_t bundle_len = TX_BUNDLE_HEADER_SIZE;
+    int n = 0;
+    while (n < ring->count) {
+        const TxItem *item = &ring->items[(ring->head + n) % TX_QUEUE_DEPTH];
+        if (item->flags != head->flags || bundle_len + TX_BUNDLE_LEN_SIZE + item->len > TX_BUNDLE_MAX_LEN) {
+            break;
+        }
+        bundle_len += TX_BUNDLE_LEN_SIZE + item->len;
+        n++;
+    }
+    // 队首自己就放不进合并帧时直接发送
+    if (n == 0) {
+        return 1;
+    }
+    // 后面还有放不下的数据帧、队列已满或已经达到阈值时不再等待
+    bool may_grow = (n == ring->count) && (ring->count < TX_QUEUE_DEPTH) && (bundle_len < tx_aggregation.threshold);
+    uint32_t delay = ms_to_ticks(tx_aggregation.delay_ms);
+    uint32_t waited = now - head->tick;
+    if (may_grow && waited < delay) {
+        if (delay - waited < *hold_ticks) {
+            *hold_ticks = delay - waited;
+        }
+        return 0;
+    }
+    return n;
+}
+
+// 把多个数据帧拷贝到一个合并帧中，每个数据帧前加上三位十进制的长度
+static PacketBuf *build_bundle(const TxItem *items, int n) {
+    uint16_t len = TX_BUNDLE_HEADER_SIZE;
+    for (int i = 0; i < n; i++) {
+        len += TX_BUNDLE_LEN_SIZE + items[i].len;
+    }
+    PacketBuf *bundle = HAL_PacketBuf_Alloc(len);
+    if (bundle == NULL) {
+        return NULL;
+    }
+    char *p = bundle->payload;
+    *p++ = TX_BUNDLE_TYPE;
+    for (int i = 0; i < n; i++) {
+        char len_field[TX_BUNDLE_LEN_SIZE + 1];
+        snprintf(len_field, sizeof(len_field), "%03u", items[i].len);
+        memcpy(p, len_field, TX_BUNDLE_LEN_SIZE);
+        memcpy(p + TX_BUNDLE_LEN_SIZE, items[i].data, items[i].len);
+        p += TX_BUNDLE_LEN_SIZE + items[i].len;
+    }
+    return bundle;
+}
+#endif
+
+#if ENABLE_TX_FAIR_QUEUE
+// 按入口查找上行公平队列，子节点没有队列时占用一个空闲的队列，需要持有tx_mutex
+static TxFairQueue *find_fair(const char *ingress_mac) {
+    if (ingress_mac == NULL) {
+        return &tx_fair[0];
+    }
+    TxFairQueue *empty = NULL;
+    for (int i = 1; i < TX_FAIR_QUEUES; i++) {
+        TxFairQueue *f = &tx_fair[i];
+        if (f->stats.mac[0] != '\0' && strncmp(f->stats.mac, ingress_mac, 6) == 0) {
+            return f;
+        }
+        if (empty == NULL && f->ring.count == 0 && !f->pinned) {
+            empty = f;
+        }
+    }
+    if (empty != NULL) {
+        // 换成另一个子节点，统计重新开始
+        memset(&empty->stats, 0, sizeof(TxFairQueueStats));
+        strncpy(empty->stats.mac, ingress_mac, 6);
+        empty->stats.weight = TX_FAIR_WEIGHT_DEFAULT;
+        empty->deficit = 0;
+    }
+    return empty;
+}
+
+// 差额轮询选出下一个发送的队列，ready为可以发送的队列（非空且不在等待合并），需要持有tx_mutex
+// 每个队列轮到时加上权重对应的配额，队首数据包不超过剩余配额就发送，否则轮到下一个队列
+static TxFairQueue *drr_select(uint32_t ready) {
+    // 合并帧可能让配额变成负数，欠得多时需要多轮才能补回，超过轮数时直接选第一个可以发送的队列
+    for (int tries = 0; tries < 4 * TX_FAIR_QUEUES; tries++) {
+        TxFairQueue *f = &tx_fair[drr_current];
+        if (ready & (1u << drr_current)) {
+            if (!drr_credited) {
+                f->deficit += TX_FAIR_QUANTUM * f->stats.weight;
+                drr_credited = true;
+            }
+            if (f->ring.items[f->ring.head].len <= f->deficit) {
+                return f;
+            }
+        } else if (f->ring.count == 0) {
+            f->deficit = 0;  // 空队列不积累配额，等待合并的队列保留配额
+        }
+        drr_current = (drr_current + 1) % TX_FAIR_QUEUES;
+        drr_credited = false;
+    }
+    for (int i = 0; i < TX_FAIR_QUEUES; i++) {
+        if (ready & (1u << i)) {
+            return &tx_fair[i];
+        }
+    }
+    return NULL;
+}
+
+// 找出可以发送的公平队列，等待合并的队列这次不参与轮询，需要持有tx_mutex
+static uint32_t fair_ready_mask(uint32_t now, uint32_t *hold_ticks) {
+    uint32_t ready = 0;
+    for (int i = 0; i < TX_FAIR_QUEUES; i++) {
+        if (tx_fair[i].ring.count == 0) {
+            continue;
+        }
+#if ENABLE_TX_AGGREGATION
+        if (plan_bundle(&tx_fair[i].ring, now, hold_ticks) == 0) {
+            continue;
+        }
+#else
+        UNUSED(now);
+        UNUSED(hold_ticks);
+#endif
+        ready |= 1u << i;
+    }
+    return ready;
+}
+
+// 扣除已发送的字节数，队列发空时配额清零并轮到下一个队列，需要持有tx_mutex
+static void drr_charge(TxFairQueue *f, uint32_t bytes) {
+    f->deficit -= (int32_t)bytes;
+    f->stats.sent_bytes += bytes;
+    if (f->ring.count == 0 || f->deficit <= 0) {
+        if (f->ring.count == 0) {
+            f->deficit = 0;
+        }
+        drr_current = (drr_current + 1) % TX_FAIR_QUEUES;
+        drr_credited = false;
+    }
+}
+#endif
+
+// 完成队首已经超时的数据包，队首是最早入队的数据包，需要持有tx_mutex，返回时仍持有
+static void expire_ring(TxQueue *q, TxRing *ring, uint32_t now) {
+    UNUSED(q);
+    while (ring->count > 0 && now - ring->items[ring->head].tick > ms_to_ticks(TX_ITEM_TIMEOUT_MS)) {
+        TxItem expired = pop_item(ring);
+        osMutexRelease(tx_mutex);
+        LOG("TX item to %s timed out.\n", q->mac);
+        complete_item(&expired, TX_RESULT_TIMEOUT);
+        osMutexAcquire(tx_mutex, osWaitForever);
+    }
+}
+
+// 处理一个队列的队首数据包，控制面非空时先发送控制面，数据面可能把多个数据帧合并发送
+// 返回1表示发送了数据包，0表示队列为空，2表示需要稍后再试（连接正在建立、发送缓冲区已满或处于退避期），
+// 3表示数据面在等待更多数据帧合并，*hold_ticks为需要再次检查的时间
+static int service_queue(TxQueue *q, uint32_t *hold_ticks) {
+    uint32_t now = osKernelGetTickCount();
+    osMutexAcquire(tx_mutex, osWaitForever);
+    expire_ring(q, &q->rings[TX_PLANE_CONTROL], now);
+    expire_ring(q, &q->rings[TX_PLANE_DATA], now);
+#if ENABLE_TX_FAIR_QUEUE
+    if (q == &tx_queues[TX_PARENT_QUEUE]) {
+        for (int i = 0; i < TX_FAIR_QUEUES; i++) {
+            expire_ring(q, &tx_fair[i].ring, now);
+        }
+    }
+#endif
+    if (queue_count(q) == 0) {
+        osMutexRelease(tx_mutex);
+        return 0;
+    }
+    if (q->backoff && (int32_t)(now - q->retry_tick) < 0) {
+        osMutexRelease(tx_mutex);
+        return 2;
+    }
+    q->backoff = false;
+    // 控制面严格优先，控制面连接尚未建立时数据面也等待，保证路由包不会被数据包超过
+    TxRing *ring = (q->rings[TX_PLANE_CONTROL].count > 0) ? &q->rings[TX_PLANE_CONTROL] : &q->rings[TX_PLANE_DATA];
+#if ENABLE_TX_FAIR_QUEUE
+    // 上行数据面按入口轮询，合并帧也只在同一个入口的队列内合并
+    TxFairQueue *fair = NULL;
+    if (q == &tx_queues[TX_PARENT_QUEUE] && ring != &q->rings[TX_PLANE_CONTROL]) {
+        fair = drr_select(fair_ready_mask(now, hold_ticks));
+        if (fair == NULL) {
+            osMutexRelease(tx_mutex);
+            return 3;
+        }
+        ring = &fair->ring;
+    }
+#endif
+    int n = 1;
+#if ENABLE_TX_AGGREGATION
+    if (ring != &q->rings[TX_PLANE_CONTROL]) {
+        n = plan_bundle(ring, now, hold_ticks);
+        if (n == 0) {
+            osMutexRelease(tx_mutex);
+            return 3;
+        }
+    }
+#else
+    UNUSED(hold_ticks);
+#endif
+    // 只有发送线程会取出数据包，发送期间不持有锁，应用线程和接收线程可以继续入队
+    TxItem items[TX_QUEUE_DEPTH];
+    for (int i = 0; i < n; i++) {
+        items[i] = ring->items[(ring->head + i) % TX_QUEUE_DEPTH];
+    }
+    osMutexRelease(tx_mutex);
+
+    TxItem send = items[0];
+    PacketBuf *bundle = NULL;
+#if ENABLE_TX_AGGREGATION
+    if (n > 1) {
+        // 内存池耗尽时退回只发送队首
+        bundle = build_bundle(items, n);
+        if (bundle == NULL) {
+            n = 1;
+        } else {
+            send.data = bundle->payload;
+            send.len = bundle->len;
+        }
+    }
+#endif
+    int ret = send_item(q, &send);
+    HAL_PacketBuf_Free(bundle);
+    if (ret == 1) {
+        return 2;
+    }
+    osMutexAcquire(tx_mutex, osWaitForever);
+    uint32_t bytes = 0;
+    for (int i = 0; i < n; i++) {
+        bytes += pop_item(ring).len;
+    }
+#if ENABLE_TX_FAIR_QUEUE
+    if (fair != NULL) {
+        drr_charge(fair, bytes);
+    }
+#else
+    UNUSED(bytes);
+#endif
+    if (bundle != NULL) {
+        tx_stats.plane[TX_PLANE_DATA].bundles++;
+        tx_stats.plane[TX_PLANE_DATA].bundled += n;
+    }
+    if (ret < 0) {
+        q->backoff = true;
+        q->retry_tick = now + ms_to_ticks(TX_RETRY_BACKOFF_MS);
+    }
+    osMutexRelease(tx_mutex);
+    for (int i = 0; i < n; i++) {
+        complete_item(&items[i], ret == 0 ? TX_RESULT_OK : TX_RESULT_FAILED);
+    }
+    return 1;
+}
+
+// 清空一个环形队列，需要持有tx_mutex，返回时仍持有
+static void flush_ring(TxRing *ring) {
+    while (ring->count > 0) {
+        TxItem item = pop_item(ring);
+        osMutexRelease(tx_mutex);
+        complete_item(&item, TX_RESULT_DROPPED);
+        osMutexAcquire(tx_mutex, osWaitForever);
+    }
+}
+
+// 清空所有队列，只在发送线程中调用
+static void flush_queues(void) {
+    for (int i = 0; i < TX_MAX_NEXT_HOPS; i++) {
+        TxQueue *q = &tx_queues[i];
+        osMutexAcquire(tx_mutex, osWaitForever);
+        for (int plane = 0; plane < TX_PLANE_MAX; plane++) {
+            flush_ring(&q->rings[plane]);
+        }
+#if ENABLE_TX_FAIR_QUEUE
+        if (i == TX_PARENT_QUEUE) {
+            for (int j = 0; j < TX_FAIR_QUEUES; j++) {
+                flush_ring(&tx_fair[j].ring);
+                tx_fair[j].deficit = 0;
+            }
+        }
+#endif
+        q->backoff = false;
+        if (i != TX_PARENT_QUEUE) {
+            q->mac[0] = '\0';
+        }
+        osMutexRelease(tx_mutex);
+    }
+}
+
+static void tx_engine_task(void) {
+    uint32_t wait = osWaitForever;
+    while (1) {
+        osEventFlagsWait(tx_event_flags, TX_WAKE_BIT, osFlagsWaitAny, wait);
+        if (tx_flush) {
+            tx_flush = false;
+            flush_queues();
+        }
+        // 每轮每个队列最多发送一个数据包，不让某个下一跳独占发送线程
+        bool progress = true;
+        bool pending = false;
+        uint32_t hold = osWaitForever;
+        while (progress) {
+            progress = false;
+            pending = false;
+            hold = osWaitForever;
+            for (int i = 0; i < TX_MAX_NEXT_HOPS; i++) {
+                int ret = service_queue(&tx_queues[i], &hold);
+                progress |= (ret == 1);
+                pending |= (ret == 2);
+            }
+        }
+        // 还有数据包在等待连接建立或退避结束时定时检查，否则一直等待新的数据包；
+        // 有数据帧在等待合并时最晚在它的等待时间到期时醒来
+        wait = pending ? ms_to_ticks(TX_POLL_INTERVAL_MS) : osWaitForever;
+        if (hold < wait) {
+            wait = (hold > 0) ? hold : 1;
+        }
+    }
+}
+
+int tx_engine_init(void) {
+    if (tx_thread_id != NULL) {
+        return 0;
+    }
+    tx_mutex = osMutexNew(NULL);
+    tx_event_flags = osEventFlagsNew(NULL);
+    if (tx_mutex == NULL || tx_event_flags == NULL) {
+        LOG("Failed to create TX engine mutex or event flags.\n");
+        return -1;
+    }
+    memset(tx_queues, 0, sizeof(tx_queues));
+    memset(&tx_stats, 0, sizeof(tx_stats));
+#if ENABLE_TX_FAIR_QUEUE
+    memset(tx_fair, 0, sizeof(tx_fair));
+    for (int i = 0; i < TX_FAIR_QUEUES; i++) {
+        tx_fair[i].stats.weight = TX_FAIR_WEIGHT_DEFAULT;
+    }
+#endif
+
+    osThreadAttr_t attr;
+    attr.name       = "tx_engine_task";
+    attr.attr_bits  = 0U;
+    attr.cb_mem     = NULL;
+    attr.cb_size    = 0U;
+    attr.stack_mem  = NULL;
+    attr.stack_size = 0x1000;
+    attr.priority   = osPriorityLow4;
+
+    tx_thread_id = osThreadNew((osThreadFunc_t)tx_engine_task, NULL, &attr);
+    if (tx_thread_id == NULL) {
+        LOG("Failed to create TX engine task.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int tx_engine_submit(const char *next_hop_mac, PacketBuf *buf, uint8_t flags, TxCompleteCallback cb, void *arg) {
+    return tx_engine_submit_from(next_hop_mac, NULL, buf, flags, cb, arg);
+}
+
+int tx_engine_submit_from(const char *next_hop_mac, const char *ingress_mac, PacketBuf *buf, uint8_t flags,
+                          TxCompleteCallback cb, void *arg) {
+    if (buf == NULL || tx_thread_id == NULL) {
+        return -1;
+    }
+    TxPlane plane = (flags & TX_FLAG_CONTROL) ? TX_PLANE_CONTROL : TX_PLANE_DATA;
+    osMutexAcquire(tx_mutex, osWaitForever);
+    TxPlaneStats *stats = &tx_stats.plane[plane];
+    stats->submitted++;
+    TxQueue *q = find_queue(next_hop_mac);
+    TxRing *ring = (q == NULL) ? NULL : &q->rings[plane];
+#if ENABLE_TX_FAIR_QUEUE
+    TxFairQueue *fair = NULL;
+    if (q == &tx_queues[TX_PARENT_QUEUE] && plane == TX_PLANE_DATA) {
+        fair = find_fair(ingress_mac);
+        ring = (fair == NULL) ? NULL : &fair->ring;
+    }
+#else
+    UNUSED(ingress_mac);
+#endif
+    if (ring == NULL || ring->count >= TX_QUEUE_DEPTH) {
+        // 只拒绝发往这个下一跳、这个平面、这个入口的数据包，其他队列不受影响
+        stats->dropped++;
+#if ENABLE_TX_FAIR_QUEUE
+        if (fair != NULL) {
+            fair->stats.dropped++;
+        }
+#endif
+        osMutexRelease(tx_mutex);
+        LOG("TX queue to %s full, dropping.\n", next_hop_mac == NULL ? "parent" : next_hop_mac);
+        return -1;
+    }
+    HAL_PacketBuf_Ref(buf);
+    TxItem *item = &ring->items[(ring->head + ring->count) % TX_QUEUE_DEPTH];
+    item->buf = buf;
+    item->data = buf->payload;
+    item->len = buf->len;
+    item->flags = flags;
+    item->tick = osKernelGetTickCount();
+    item->cb = cb;
+    item->arg = arg;
+    ring->count++;
+    if (ring->count > stats->max_depth) {
+        stats->max_depth = ring->count;
+    }
+    stats->backlog++;
+    if (stats->backlog > stats->max_backlog) {
+        stats->max_backlog = stats->backlog;
+    }
+#if ENABLE_TX_FAIR_QUEUE
+    if (fair != NULL) {
+        fair->stats.enqueued++;
+        if (ring->count > fair->stats.max_backlog) {
+            fair->stats.max_backlog = ring->count;
+        }
+    }
+#endif
+    osMutexRelease(tx_mutex);
+    osEventFlagsSet(tx_event_flags, TX_WAKE_BIT);
+    return 0;
+}
+
+void tx_engine_reset(void) {
+    if (tx_thread_id == NULL) {
+        return;
+    }
+    tx_flush = true;
+    osEventFlagsSet(tx_event_flags, TX_WAKE_BIT);
+}
+
+#if ENABLE_TX_FAIR_QUEUE
+int tx_engine_set_fair_weight(const char *ingress_mac, uint8_t weight) {
+    if (tx_mutex == NULL) {
+        return -1;
+    }
+    osMutexAcquire(tx_mutex, osWaitForever);
+    TxFairQueue *f = find_fair(ingress_mac);
+    if (f == NULL) {
+        osMutexRelease(tx_mutex);
+        LOG("No fair queue for %s.\n", ingress_mac);
+        return -1;
+    }
+    f->stats.weight = (weight == 0) ? TX_FAIR_WEIGHT_DEFAULT : weight;
+    f->pinned = (weight != 0);
+    osMutexRelease(tx_mutex);
+    return 0;
+}
+
+int tx_engine_get_fair_stats(TxFairQueueStats *stats, int max_count) {
+    if (stats == NULL || tx_mutex == NULL) {
+        return 0;
+    }
+    int count = 0;
+    osMutexAcquire(tx_mutex, osWaitForever);
+    for (int i = 0; i < TX_FAIR_QUEUES && count < max_count; i++) {
+        const TxFairQueue *f = &tx_fair[i];
+        if (i != 0 && f->stats.mac[0] == '\0') {
+            continue;
+        }
+        stats[count] = f->stats;
+        stats[count].backlog = f->ring.count;
+        count++;
+    }
+    osMutexRelease(tx_mutex);
+    return count;
+}
+#else
+int tx_engine_set_fair_weight(const char *ingress_mac, uint8_t weight) {
+    UNUSED(ingress_mac);
+    UNUSED(weight);
+    return -1;
+}
+
+int tx_engine_get_fair_stats(TxFairQueueStats *stats, int max_count) {
+    UNUSED(stats);
+    UNUSED(max_count);
+    return 0;
+}
+#endif
+
+void tx_engine_set_aggregation(const TxAggregationConfig *config) {
+    TxAggregationConfig value = {TX_AGGREGATE_DELAY_MS, TX_AGGREGATE_THRESHOLD};
+    if (config != NULL) {
+        value = *config;
+    }
+    if (value.threshold > TX_BUNDLE_MAX_LEN) {
+        value.threshold = TX_BUNDLE_MAX_LEN;
+    }
+    if (tx_mutex == NULL) {
+        tx_aggregation = value;
+        return;
+    }
+    osMutexAcquire(tx_mutex, osWaitForever);
+    tx_aggregation = value;
+    osMutexRelease(tx_mutex);
+    // 等待中的数据帧按新的参数重新判断
+    osEventFlagsSet(tx_event_flags, TX_WAKE_BIT);
+}
+
+char *tx_bundle_next(char *bundle, uint16_t len, uint16_t *offset, uint16_t *frame_len) {
+    if (bundle == NULL || offset == NULL || frame_len == NULL || *offset + TX_BUNDLE_LEN_SIZE > len) {
+        return NULL;
+    }
+    uint16_t value = 0;
+    for (int i = 0; i < TX_BUNDLE_LEN_SIZE; i++) {
+        char c = bundle[*offset + i];
+        if (c < '0' || c > '9') {
+            return NULL;
+        }
+        value = value * 10 + (c - '0');
+    }
+    uint16_t start = *offset + TX_BUNDLE_LEN_SIZE;
+    if (value == 0 || value > len - start) {
+        return NULL;
+    }
+    *offset = start + value;
+    *frame_len = value;
+    return bundle + start;
+}
+
+void tx_engine_get_stats(TxEngineStats *stats) {
+    if (stats == NULL || tx_mutex == NULL) {
+        return;
+    }
+    osMutexAcquire(tx_mutex, osWaitForever);
+    memcpy(stats, &tx_stats, sizeof(TxEngineStats));
+    osMutexRelease(tx_mutex);
+}
@@ -0,0 +1,95 @@
+/*
+ * lz_codec 主机端基准测试：统计典型负载的压缩率和压缩/解压速度，并校验解压结果
+ * 不参与固件编译，在PC上编译运行：
+ *   gcc -O2 -I../inc ../src/lz_codec.c bench_lz_codec.c -o bench_lz_codec && ./bench_lz_codec
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "lz_codec.h"
+
+#define PAYLOAD_MAX 493     // 与数据包的数据位长度一致
+#define ITERATIONS  20000
+
+typedef struct {
+    const char *name;
+    char data[PAYLOAD_MAX + 1];
+} Payload;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void build_payloads(Payload *p) {
+    p[0].name = "short json";
+    snprintf(p[0].data, sizeof(p[0].data), "{\"temp\":23.5,\"hum\":41}");
+
+    p[1].name = "sensor json";
+    snprintf(p[1].data, sizeof(p[1].data),
+             "{\"node\":\"A1B2C3\",\"temp\":23.51,\"humidity\":41.20,\"pressure\":1013.25,"
+             "\"light\":312,\"battery\":3.71,\"rssi\":-61,\"uptime\":123456}");
+
+    p[2].name = "sensor batch";
+    int off = 0;
+    for (int i = 0; i < 8 && off < PAYLOAD_MAX - 60; i++) {
+        off += snprintf(p[2].data + off, sizeof(p[2].data) - off,
+                        "{\"ts\":%d,\"temp\":%d.%d,\"hum\":%d.%d},", 1700000000 + i * 10,
+                        22 + i % 3, i, 40 + i % 5, (i * 7) % 10);
+    }
+
+    p[3].name = "log text";
+    snprintf(p[3].data, sizeof(p[3].data),
+             "INFO route update from A1B2C3 level 2; INFO route update from B2C3D4 level 2; "
+             "INFO route update from C3D4E5 level 3; WARN parent rssi low -78; INFO route update from A1B2C3 level 2;");
+
+    p[4].name = "random";
+    unsigned int seed = 12345;
+    for (int i = 0; i < PAYLOAD_MAX; i++) {
+        seed = seed * 1103515245 + 12345;
+        p[4].data[i] = (char)(33 + (seed >> 16) % 94);
+    }
+    p[4].data[PAYLOAD_MAX] = '\0';
+}
+
+int main(void) {
+    Payload payloads[5];
+    build_payloads(payloads);
+
+    printf("%-14s %6s %6s %7s %10s %10s\n", "payload", "in", "out", "ratio", "comp MB/s", "dec MB/s");
+    for (int i = 0; i < 5; i++) {
+        const uint8_t *in = (const uint8_t *)payloads[i].data;
+        uint16_t in_len = (uint16_t)strlen(payloads[i].data);
+        uint8_t comp[PAYLOAD_MAX];
+        uint8_t dec[PAYLOAD_MAX];
+
+        // 与固件一致：压缩后没有变小则不压缩
+        int comp_len = lz_compress(in, in_len, comp, in_len - 1);
+        if (comp_len < 0) {
+            printf("%-14s %6d %6s %7s %10s %10s\n", payloads[i].name, in_len, "-", "skip", "-", "-");
+            continue;
+        }
+        int dec_len = lz_decompress(comp, (uint16_t)comp_len, dec, sizeof(dec));
+        if (dec_len != in_len || memcmp(dec, in, in_len) != 0) {
+            printf("%-14s round trip FAILED\n", payloads[i].name);
+            return 1;
+        }
+
+        double start = now_us();
+        for (int n = 0; n < ITERATIONS; n++) {
+            lz_compress(in, in_len, comp, in_len - 1);
+        }
+        double comp_us = now_us() - start;
+        start = now_us();
+        for (int n = 0; n < ITERATIONS; n++) {
+            lz_decompress(comp, (uint16_t)comp_len, dec, sizeof(dec));
+        }
+        double dec_us = now_us() - start;
+
+        double bytes = (double)in_len * ITERATIONS;
+        printf("%-14s %6d %6d %6.1f%% %10.1f %10.1f\n", payloads[i].name, in_len, comp_len,
+               100.0 * comp_len / in_len, bytes / comp_us, bytes / dec_us);
+    }
+    return 0;
+}